@@ -0,0 +1,21 @@
+#ifndef ANDROIDLOG_H
+#define ANDROIDLOG_H
+
+// Android logcat on the device. The host build (tools/) has no logcat, there the
+// std::cerr / std::clog line printed next to every log call is enough.
+#ifdef __ANDROID__
+#include <android/log.h>
+#else
+enum {
+    ANDROID_LOG_DEBUG = 3,
+    ANDROID_LOG_INFO = 4,
+    ANDROID_LOG_WARN = 5,
+    ANDROID_LOG_ERROR = 6
+};
+
+inline int __android_log_print(int /*prio*/, const char* /*tag*/, const char* /*fmt*/, ...) {
+    return 0;
+}
+#endif
+
+#endif //ANDROIDLOG_H
@@ -1,14 +1,24 @@
 #include "CardDetection.h"
+#include "Trace.h"
+#include "ScratchPool.h"
+#include "DebugCapture.h"
+#include "CardMatcher.h"
+
+// ORB distances are coarser than SIFT ones, the SIFT ratio would reject nearly all matches
+static const float ORB_RATIO_THRESH = 0.75f;
 
 
 /**
  * Constructor. Localize card and compute confidence score
- * @param sourceImg original input image with tree and card
- * @param cardImg image of card
+ * @param sourceImg original input image with tree and card, any PixelFormat
+ * @param card card features, must outlive this object
+ * @param config detection parameters
  */
-CardDetection::CardDetection(cv::Mat sourceImg, cv::Mat cardImg ){
-    this->sourceImg = sourceImg.clone();
-    this->cardImg = cardImg.clone();
+CardDetection::CardDetection(const SourceImage& sourceImg, const CardModel& card, const DetectorConfig& config)
+        : card(card) {
+    this->config = config;
+    // only the header is kept, the image is read and never modified
+    this->sourceImg = sourceImg;
 
     this->points = findCard();
     this->card_confidence = confidence();
@@ -18,7 +28,7 @@ CardDetection::CardDetection(cv::Mat sourceImg, cv::Mat cardImg ){
  * Getter. 
  * @return vector of card points (upper left, upper right, bottom right, bottom left)
  */
-std::vector<cv::Point2f> CardDetection::getPoints() {
+const std::vector<cv::Point2f>& CardDetection::getPoints() {
     return this->points;
 }
 
@@ -72,66 +82,57 @@ float angleBetween3Points(cv::Point2f pointA, cv::Point2f pointB, cv::Point2f po
  */
 std::vector<cv::Point2f> CardDetection::findCard()
 {
-
-    cv::Mat image, card;
-
-    // convert to grey
-    cvtColor(this->sourceImg, image, cv::COLOR_BGR2GRAY);
-    cvtColor(this->cardImg, card, cv::COLOR_BGR2GRAY);
-
-    // resize image
-    int resizeToWidth = 1000;
-    float ratio = float(resizeToWidth) / float(image.cols);
-    int newHeight = int(round(ratio * image.rows));
-    cv::resize(image, image, cv::Size(resizeToWidth, newHeight), cv::INTER_LINEAR);
-
-    // blur tree image and card
-    cv::GaussianBlur(image, image, cv::Size(5, 5), 0);
-    cv::GaussianBlur(card, card, cv::Size(3, 3), 0);
-
-    // initialize SIFT detector 
-    cv::Ptr<cv::SiftFeatureDetector> detectorS = cv::SiftFeatureDetector::create();
-    std::vector<cv::KeyPoint> keypoints_image, keypoints_card;
-    Mat descriptors_image, descriptors_card;
-
-    // detect keypoints and compute descriptors
+    TRACE_SPAN(span, "findCard");
+
+    // grey, resized and blurred in one pass over the input, the card template is blurred when the card model is built
+    ScratchPool& pool = ScratchPool::local();
+    int resizeToWidth = config.card_resize_width;
+    float ratio = float(resizeToWidth) / float(this->sourceImg.cols());
+    int newHeight = int(round(ratio * this->sourceImg.rows()));
+    cv::Mat image = pool.get(ScratchPool::CARD_IMAGE, newHeight, resizeToWidth, CV_8U);
+    this->sourceImg.grayResized(image, cv::Size(resizeToWidth, newHeight), config.card_image_blur);
+
+    // initialize SIFT detector, or ORB when a fast descriptor is requested
+    cv::Ptr<cv::Feature2D> detectorS;
+    if (config.fast_descriptor) detectorS = cv::ORB::create(1500);
+    else detectorS = cv::SiftFeatureDetector::create();
+    std::vector<cv::KeyPoint> keypoints_image;
+    Mat descriptors_image;
+
+    // detect keypoints and compute descriptors, card ones are precomputed
     detectorS->detectAndCompute(image, noArray(), keypoints_image, descriptors_image);
-    detectorS->detectAndCompute(card, noArray(), keypoints_card, descriptors_card);
-
-    //show keypoints in tree image 
-    /*Mat outimg;
-    drawKeypoints(image, keypoints_image, outimg, Scalar::all(-1), DrawMatchesFlags::DEFAULT);
-    imshow("SIFT", outimg);
-    Mat outimg22;
-    drawKeypoints(card, keypoints_card, outimg22, Scalar::all(-1), DrawMatchesFlags::DEFAULT);
-    imshow("SIFT_card", outimg22);*/
-
-    //Matching descriptor vectors with a FLANN based matcher
-    //Since SURF is a floating-point descriptor NORM_L2 must be used
-    Ptr<DescriptorMatcher> matcher = DescriptorMatcher::create(DescriptorMatcher::FLANNBASED);
-    std::vector< std::vector<DMatch> > knn_matches;
-    matcher->knnMatch(descriptors_card, descriptors_image, knn_matches, 2);
+    const CardFeatures& card_features = card.features(config.fast_descriptor ? CardModel::ORB_FEATURES : CardModel::SIFT_FEATURES,
+                                                      CardModel::usesMatchingData(config));
+    const cv::KeyPoint* keypoints_card = card_features.keypoints;
+    TRACE_COUNTER(span, "keypoints_image", keypoints_image.size());
+    TRACE_COUNTER(span, "keypoints_card", card_features.count);
+    if (card_features.count < 2 || descriptors_image.rows < 2) {
+        return std::vector<Point2f>();
+    }
 
+    //Matching descriptor vectors with the matcher of the config, SIFT by FLANN, card index or brute force
+    //ORB is a binary descriptor, it is matched by brute force with NORM_HAMMING
     //-- Filter matches using the Lowe's ratio test
     // higher ratio -> more points
-    const float ratio_thresh = 0.5f;
+    const float ratio_thresh = config.fast_descriptor ? ORB_RATIO_THRESH : config.ratio_thresh;
     std::vector<DMatch> good_matches;
-    for (size_t i = 0; i < knn_matches.size(); i++)
-    {
-        if (knn_matches[i][0].distance < ratio_thresh * knn_matches[i][1].distance)
-        {
-            good_matches.push_back(knn_matches[i][0]);
-        }
-    }
+    matchCard(card_features, descriptors_image, config.card_matcher, config.descriptor_format, ratio_thresh, good_matches);
 
     //-- Draw good matches
-    /*Mat img_matches;
-    drawMatches(card, keypoints_card, image, keypoints_image,  good_matches, img_matches, Scalar::all(-1),
-        Scalar::all(-1), std::vector<char>(), DrawMatchesFlags::NOT_DRAW_SINGLE_POINTS);
-    imshow("Matches", img_matches);*/
-
-    //at least 5 good matches to find a card
-    if (good_matches.size()<5) {
+    // a card model loaded from file has no template image, matches are drawn on a blank one
+    DEBUG_CAPTURE("card_matches", [template_image = card.image().empty() ? Mat(card.size(), CV_8U, Scalar(255)) : card.image(),
+                                   card_features = std::vector<cv::KeyPoint>(keypoints_card, keypoints_card + card_features.count),
+                                   image = image.clone(), keypoints_image, good_matches]() {
+        Mat img_matches;
+        drawMatches(template_image, card_features, image, keypoints_image, good_matches, img_matches, Scalar::all(-1),
+            Scalar::all(-1), std::vector<char>(), DrawMatchesFlags::NOT_DRAW_SINGLE_POINTS);
+        return img_matches;
+    });
+
+    TRACE_COUNTER(span, "good_matches", good_matches.size());
+
+    //at least min_good_matches good matches to find a card
+    if (good_matches.size() < size_t(config.min_good_matches)) {
         std::vector<Point2f> empty_corners;
         return empty_corners;
     }
@@ -146,35 +147,32 @@ std::vector<cv::Point2f> CardDetection::findCard()
         scene.push_back(keypoints_image[good_matches[i].trainIdx].pt);
     }
 
-    Mat H = findHomography(obj, scene, RANSAC);
+    Mat inliers;
+    Mat H = findHomography(obj, scene, RANSAC, 3, inliers);
+    TRACE_COUNTER(span, "ransac_inliers", inliers.empty() ? 0 : countNonZero(inliers));
 
     //-- Get the corners from the image
     std::vector<Point2f> obj_corners(4);
     obj_corners[0] = Point2f(0, 0);
-    obj_corners[1] = Point2f((float)card.cols, 0);
-    obj_corners[2] = Point2f((float)card.cols, (float)card.rows);
-    obj_corners[3] = Point2f(0, (float)card.rows);
+    obj_corners[1] = Point2f((float)card.size().width, 0);
+    obj_corners[2] = Point2f((float)card.size().width, (float)card.size().height);
+    obj_corners[3] = Point2f(0, (float)card.size().height);
 
     // transform objects corners to the scene
     std::vector<Point2f> scene_corners(4);
     perspectiveTransform(obj_corners, scene_corners, H);
 
-    /*
     //-- Draw lines between the corners (the mapped object in the scene)
-    line(img_matches, scene_corners[0] + Point2f((float)card.cols, 0),
-        scene_corners[1] + Point2f((float)card.cols, 0), Scalar(0, 255, 0), 2);
-    line(img_matches, scene_corners[1] + Point2f((float)card.cols, 0),
-        scene_corners[2] + Point2f((float)card.cols, 0), Scalar(0, 255, 0), 2);
-    line(img_matches, scene_corners[2] + Point2f((float)card.cols, 0),
-        scene_corners[3] + Point2f((float)card.cols, 0), Scalar(0, 255, 0), 2);
-    line(img_matches, scene_corners[3] + Point2f((float)card.cols, 0),
-        scene_corners[0] + Point2f((float)card.cols, 0), Scalar(0, 255, 0), 2);
- 
-    imshow("Good Matches & Object detection", img_matches);
-    */
+    DEBUG_CAPTURE("card_detection", [image = image.clone(), scene_corners]() {
+        Mat out;
+        cvtColor(image, out, cv::COLOR_GRAY2BGR);
+        for (int i = 0; i < 4; i++)
+            line(out, scene_corners[i], scene_corners[(i + 1) % 4], Scalar(0, 255, 0), 2);
+        return out;
+    });
 
     // adapt points to original size
-    for (int i = 0; i < scene_corners.size(); i++)
+    for (size_t i = 0; i < scene_corners.size(); i++)
         scene_corners[i] /= ratio;
 
     return scene_corners;
@@ -188,17 +186,17 @@ std::vector<cv::Point2f> CardDetection::findCard()
  */
 cv::Mat CardDetection::getMarkedImage()
 {
-    Mat image = sourceImg.clone();
+    Mat image;
 
     // resize image
     int resizeToWidth = 600;
-    float ratio = float(resizeToWidth) / float(image.cols);
-    int newHeight = int(round(ratio * image.rows));
-    cv::resize(sourceImg, image, cv::Size(resizeToWidth, newHeight), cv::INTER_LINEAR);
+    float ratio = float(resizeToWidth) / float(sourceImg.cols());
+    int newHeight = int(round(ratio * sourceImg.rows()));
+    sourceImg.colorResized(image, cv::Size(resizeToWidth, newHeight));
 
     // adapt points to new size
     std::vector<cv::Point2f> pts = points;
-    for (int i = 0; i < pts.size(); i++)
+    for (size_t i = 0; i < pts.size(); i++)
         pts[i] *= ratio;
 
     //-- Draw lines between the corners (the mapped object in the scene)
@@ -13,25 +13,30 @@
 #include <opencv2/features2d/features2d.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "DetectorConfig.h"
+#include "CardModel.h"
+#include "SourceImage.h"
+
 using namespace cv;
 using namespace std;
 
 class CardDetection {
 private:
     std::string TAG = "CardDetection";
-    cv::Mat sourceImg;                  //image of tree and card
-    cv::Mat cardImg;                    //image of card which should be found in sourceImg
+    SourceImage sourceImg;              //image of tree and card in its native layout (shared with the caller, not copied)
+    const CardModel& card;              //features of the card which should be found in sourceImg
     std::vector<cv::Point2f> points;    //vector of card points (upper left, upper right, bottom right, bottom left)
     float card_confidence;              //confidence that card was found
+    DetectorConfig config;              //resize width, blur kernels, match filtering
 
     std::vector<cv::Point2f> findCard();
     float confidence();
 
 
 public:
-    CardDetection(cv::Mat sourceImg, cv::Mat cardImage);
+    CardDetection(const SourceImage& sourceImg, const CardModel& card, const DetectorConfig& config = DetectorConfig());
     cv::Mat getMarkedImage();
-    std::vector<cv::Point2f> getPoints();
+    const std::vector<cv::Point2f>& getPoints();
     float getConfidenceScore();
 
 };
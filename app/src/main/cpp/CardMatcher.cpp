@@ -0,0 +1,241 @@
+#include "CardMatcher.h"
+#include "Trace.h"
+
+#include <float.h>
+#include <math.h>
+#include <opencv2/features2d.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+static const int QUERY_BLOCK = 4;           // query rows compared with one train row while it is in registers
+static const int INDEX_CHECKS = 32;         // leaves visited per search of the card index, FLANN default
+
+
+/**
+ * Squared L2 distances of QUERY_BLOCK query rows to one train row, float descriptors.
+ */
+static inline void blockDistances(const float* const* query, const float* train, int cols, float* distances) {
+    int d = 0;
+#if CV_SIMD
+    cv::v_float32 acc0 = cv::vx_setzero_f32(), acc1 = cv::vx_setzero_f32();
+    cv::v_float32 acc2 = cv::vx_setzero_f32(), acc3 = cv::vx_setzero_f32();
+    for (; d <= cols - cv::v_float32::nlanes; d += cv::v_float32::nlanes) {
+        cv::v_float32 t = cv::vx_load(train + d);
+        cv::v_float32 diff0 = cv::vx_load(query[0] + d) - t;
+        cv::v_float32 diff1 = cv::vx_load(query[1] + d) - t;
+        cv::v_float32 diff2 = cv::vx_load(query[2] + d) - t;
+        cv::v_float32 diff3 = cv::vx_load(query[3] + d) - t;
+        acc0 = cv::v_muladd(diff0, diff0, acc0);
+        acc1 = cv::v_muladd(diff1, diff1, acc1);
+        acc2 = cv::v_muladd(diff2, diff2, acc2);
+        acc3 = cv::v_muladd(diff3, diff3, acc3);
+    }
+    distances[0] = cv::v_reduce_sum(acc0);
+    distances[1] = cv::v_reduce_sum(acc1);
+    distances[2] = cv::v_reduce_sum(acc2);
+    distances[3] = cv::v_reduce_sum(acc3);
+#else
+    distances[0] = distances[1] = distances[2] = distances[3] = 0;
+#endif
+    for (; d < cols; d++) {
+        for (int q = 0; q < QUERY_BLOCK; q++) {
+            float diff = query[q][d] - train[d];
+            distances[q] += diff * diff;
+        }
+    }
+}
+
+
+#if CV_SIMD
+static inline cv::v_uint8 absDiff(const uchar* a, const cv::v_uint8& b) { return cv::v_absdiff(cv::vx_load(a), b); }
+static inline cv::v_uint8 absDiff(const schar* a, const cv::v_int8& b) { return cv::v_absdiff(cv::vx_load(a), b); }
+#endif
+
+
+/**
+ * Squared L2 distances of QUERY_BLOCK query rows to one train row, 8-bit descriptors (uchar or schar).
+ * |a - b| always fits 8 bits unsigned, its square is summed by the 8-bit dot product of the CPU
+ * (SDOT/UDOT on ARMv8.2 builds with dotprod, pmaddubsw/VNNI on x86) into 32-bit lanes.
+ * The sums are exact, 128 * 255^2 fits a float mantissa.
+ */
+template <typename T>
+static inline void blockDistances(const T* const* query, const T* train, int cols, float* distances) {
+    int d = 0;
+    unsigned sums[QUERY_BLOCK] = {0, 0, 0, 0};
+#if CV_SIMD
+    cv::v_uint32 acc0 = cv::vx_setzero_u32(), acc1 = cv::vx_setzero_u32();
+    cv::v_uint32 acc2 = cv::vx_setzero_u32(), acc3 = cv::vx_setzero_u32();
+    for (; d <= cols - cv::v_uint8::nlanes; d += cv::v_uint8::nlanes) {
+        auto t = cv::vx_load(train + d);
+        cv::v_uint8 diff0 = absDiff(query[0] + d, t);
+        cv::v_uint8 diff1 = absDiff(query[1] + d, t);
+        cv::v_uint8 diff2 = absDiff(query[2] + d, t);
+        cv::v_uint8 diff3 = absDiff(query[3] + d, t);
+        acc0 = acc0 + cv::v_dotprod_expand(diff0, diff0);
+        acc1 = acc1 + cv::v_dotprod_expand(diff1, diff1);
+        acc2 = acc2 + cv::v_dotprod_expand(diff2, diff2);
+        acc3 = acc3 + cv::v_dotprod_expand(diff3, diff3);
+    }
+    sums[0] = cv::v_reduce_sum(acc0);
+    sums[1] = cv::v_reduce_sum(acc1);
+    sums[2] = cv::v_reduce_sum(acc2);
+    sums[3] = cv::v_reduce_sum(acc3);
+#endif
+    for (; d < cols; d++) {
+        for (int q = 0; q < QUERY_BLOCK; q++) {
+            int diff = int(query[q][d]) - int(train[d]);
+            sums[q] += unsigned(diff * diff);
+        }
+    }
+    for (int q = 0; q < QUERY_BLOCK; q++) distances[q] = float(sums[q]);
+}
+
+
+/**
+ * knnMatchL2 for one descriptor element type.
+ */
+template <typename T>
+static void knnMatchBlocks(const cv::Mat& query, const cv::Mat& train, std::vector<std::vector<cv::DMatch>>& matches) {
+    int blocks = (query.rows + QUERY_BLOCK - 1) / QUERY_BLOCK;
+    cv::parallel_for_(cv::Range(0, blocks), [&](const cv::Range& range) {
+        for (int block = range.start; block < range.end; block++) {
+            int first = block * QUERY_BLOCK;
+            int rows = std::min(QUERY_BLOCK, query.rows - first);
+            // a partial block repeats its last row, the extra distances are not used
+            const T* rows_ptr[QUERY_BLOCK];
+            for (int q = 0; q < QUERY_BLOCK; q++) rows_ptr[q] = query.ptr<T>(first + std::min(q, rows - 1));
+
+            float best[QUERY_BLOCK], second[QUERY_BLOCK];
+            int best_idx[QUERY_BLOCK], second_idx[QUERY_BLOCK];
+            for (int q = 0; q < QUERY_BLOCK; q++) {
+                best[q] = second[q] = FLT_MAX;
+                best_idx[q] = second_idx[q] = -1;
+            }
+
+            float distances[QUERY_BLOCK];
+            for (int t = 0; t < train.rows; t++) {
+                blockDistances(rows_ptr, train.ptr<T>(t), train.cols, distances);
+                for (int q = 0; q < QUERY_BLOCK; q++) {
+                    if (distances[q] < best[q]) {
+                        second[q] = best[q];
+                        second_idx[q] = best_idx[q];
+                        best[q] = distances[q];
+                        best_idx[q] = t;
+                    } else if (distances[q] < second[q]) {
+                        second[q] = distances[q];
+                        second_idx[q] = t;
+                    }
+                }
+            }
+
+            for (int q = 0; q < rows; q++) {
+                std::vector<cv::DMatch>& match = matches[first + q];
+                match.push_back(cv::DMatch(first + q, best_idx[q], sqrtf(best[q])));
+                if (second_idx[q] >= 0) match.push_back(cv::DMatch(first + q, second_idx[q], sqrtf(second[q])));
+            }
+        }
+    });
+}
+
+
+/**
+ * Exact two nearest train rows of every query row, like cv::BFMatcher(NORM_L2)::knnMatch with k = 2.
+ * Each train row is loaded once per block of query rows and compared with all of them,
+ * blocks run in parallel. Of equally distant rows the first one wins.
+ * @param query CV_32F, CV_8U or CV_8S descriptors, e.g. the card ones
+ * @param train descriptors of the same type and number of columns
+ * @param matches output, per query row the nearest and second nearest train row, fewer if train has fewer rows
+ */
+void knnMatchL2(const cv::Mat& query, const cv::Mat& train, std::vector<std::vector<cv::DMatch>>& matches) {
+    CV_Assert(query.type() == train.type() && query.cols == train.cols);
+    CV_Assert(query.type() == CV_32F || query.type() == CV_8U || query.type() == CV_8S);
+    matches.assign(query.rows, std::vector<cv::DMatch>());
+    if (query.empty() || train.empty()) return;
+
+    if (query.type() == CV_32F) knnMatchBlocks<float>(query, train, matches);
+    else if (query.type() == CV_8U) knnMatchBlocks<uchar>(query, train, matches);
+    else knnMatchBlocks<schar>(query, train, matches);
+}
+
+
+/**
+ * Convert float SIFT descriptors to a compact DescriptorFormat.
+ * SIFT descriptor elements are integers 0-255 stored as floats, DESCRIPTOR_UINT8 is lossless.
+ * DESCRIPTOR_PCA_INT8 projects them on the principal components of the card descriptors and rounds to 8 bits.
+ * @param card card features with the projection, see CardModel
+ * @param descriptors CV_32F descriptors
+ * @param format DescriptorFormat
+ * @param compact output, CV_8U 128 columns or CV_8S CARD_PCA_COMPONENTS columns
+ */
+void compactDescriptors(const CardFeatures& card, const cv::Mat& descriptors, int format, cv::Mat& compact) {
+    if (format == DESCRIPTOR_PCA_INT8) {
+        cv::Mat projected = card.pca.project(descriptors);
+        projected.convertTo(compact, CV_8S, card.pca_scale);
+    } else {
+        descriptors.convertTo(compact, CV_8U);
+    }
+}
+
+
+/**
+ * Match the card descriptors to the image descriptors and keep the distinctive matches.
+ * @param card card features of the descriptor type of image_descriptors
+ * @param image_descriptors descriptors of the image keypoints
+ * @param matcher CardMatcher for float descriptors, binary ones are always matched by brute force with NORM_HAMMING
+ * @param format DescriptorFormat the float descriptors are matched in, compact formats always by brute force
+ * @param ratio_thresh Lowe's ratio test, higher ratio -> more matches
+ * @param good_matches output, queryIdx is the card keypoint, trainIdx the image keypoint
+ */
+void matchCard(const CardFeatures& card, const cv::Mat& image_descriptors, int matcher, int format, float ratio_thresh,
+               std::vector<cv::DMatch>& good_matches) {
+    TRACE_SPAN(span, "matchCard");
+    TRACE_COUNTER(span, "matcher", matcher);
+    TRACE_COUNTER(span, "format", format);
+    good_matches.clear();
+    const cv::Mat& card_descriptors = card.descriptors;
+    std::vector< std::vector<cv::DMatch> > knn_matches;
+
+    if (card_descriptors.type() != CV_32F) {
+        cv::BFMatcher::create(cv::NORM_HAMMING)->knnMatch(card_descriptors, image_descriptors, knn_matches, 2);
+    } else if (format != DESCRIPTOR_FLOAT && card.compact[format].rows == card_descriptors.rows) {
+        // compact descriptors are matched by brute force, whatever the matcher
+        cv::Mat image_compact;
+        compactDescriptors(card, image_descriptors, format, image_compact);
+        knnMatchL2(card.compact[format], image_compact, knn_matches);
+    } else if (matcher == CARD_MATCH_INDEX && card.index) {
+        // every image descriptor looks for its two nearest card descriptors; the index is shared by all
+        // detectors of the model, concurrent measurements take turns searching it
+        cv::Mat indices, distances;
+        {
+            std::lock_guard<std::mutex> lock(*card.index_mutex);
+            card.index->knnSearch(image_descriptors, indices, distances, 2, cv::flann::SearchParams(INDEX_CHECKS));
+        }
+        // several image keypoints may pick the same card keypoint, keep the nearest one so that, like the
+        // matchers searching the other way, every card keypoint has at most one match
+        std::vector<cv::DMatch> card_matches(card_descriptors.rows, cv::DMatch(-1, -1, FLT_MAX));
+        for (int i = 0; i < indices.rows; i++) {
+            // FLANN L2 distances are squared
+            float best = sqrtf(distances.at<float>(i, 0));
+            float second = sqrtf(distances.at<float>(i, 1));
+            int card_idx = indices.at<int>(i, 0);
+            if (card_idx >= 0 && indices.at<int>(i, 1) >= 0 && best < ratio_thresh * second
+                && best < card_matches[card_idx].distance) {
+                card_matches[card_idx] = cv::DMatch(card_idx, i, best);
+            }
+        }
+        for (const cv::DMatch& match : card_matches) {
+            if (match.queryIdx >= 0) good_matches.push_back(match);
+        }
+        return;
+    } else if (matcher == CARD_MATCH_BRUTE_FORCE) {
+        knnMatchL2(card_descriptors, image_descriptors, knn_matches);
+    } else {
+        cv::DescriptorMatcher::create(cv::DescriptorMatcher::FLANNBASED)->knnMatch(card_descriptors, image_descriptors, knn_matches, 2);
+    }
+
+    //-- Filter matches using the Lowe's ratio test
+    for (size_t i = 0; i < knn_matches.size(); i++) {
+        if (knn_matches[i].size() > 1 && knn_matches[i][0].distance < ratio_thresh * knn_matches[i][1].distance) {
+            good_matches.push_back(knn_matches[i][0]);
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef CARDMATCHER_H
+#define CARDMATCHER_H
+
+#include <stdio.h>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "CardModel.h"
+#include "DetectorConfig.h"
+
+
+/**
+ * Matching of card template descriptors to the descriptors of an image, followed by Lowe's ratio test.
+ * Good matches always have the card keypoint as queryIdx and the image keypoint as trainIdx,
+ * whichever side the matcher searches, and at most one match per card keypoint.
+ */
+
+void knnMatchL2(const cv::Mat& query, const cv::Mat& train, std::vector<std::vector<cv::DMatch>>& matches);
+
+void compactDescriptors(const CardFeatures& card, const cv::Mat& descriptors, int format, cv::Mat& compact);
+
+void matchCard(const CardFeatures& card, const cv::Mat& image_descriptors, int matcher, int format, float ratio_thresh,
+               std::vector<cv::DMatch>& good_matches);
+
+
+#endif //CARDMATCHER_H
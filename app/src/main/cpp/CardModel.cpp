@@ -0,0 +1,284 @@
+#include "CardModel.h"
+#include "Hash.h"
+
+#include <string.h>
+#include <math.h>
+#include <fstream>
+#include <iostream>
+#include <opencv2/imgproc.hpp>
+
+// bump when the feature extraction below changes, old files are then rebuilt
+static const uint32_t CARD_FEATURE_VERSION = 1;
+static const uint32_t CARD_FILE_FORMAT = 1;
+static const char CARD_FILE_MAGIC[8] = {'C', 'A', 'R', 'D', 'F', 'E', 'A', 'T'};
+static const size_t SECTION_ALIGNMENT = 64;
+static const int ORB_CARD_FEATURES = 500;
+static const int CARD_INDEX_TREES = 4;      // randomized KD-trees of the card descriptor index, FLANN default
+static const int CARD_PCA_COMPONENTS = 64;  // dimensions of DESCRIPTOR_PCA_INT8
+static const double SIFT_DESCRIPTOR_NORM = 512; // L2 norm OpenCV scales every SIFT descriptor to before rounding
+
+// keypoints are stored exactly as cv::KeyPoint and used in place
+static_assert(sizeof(cv::KeyPoint) == 28, "unexpected cv::KeyPoint layout");
+
+// file layout, little-endian, offsets from the start of the file
+#pragma pack(push, 1)
+struct CardFileSection {
+    uint32_t algorithm;
+    uint32_t count;
+    uint32_t descriptor_cols;
+    int32_t descriptor_type;
+    uint64_t keypoints_offset;
+    uint64_t descriptors_offset;
+};
+
+struct CardFileHeader {
+    char magic[8];
+    uint32_t format;
+    uint32_t header_size;
+    char opencv_version[16];        /**< CV_VERSION the features were computed with */
+    uint32_t feature_version;       /**< CARD_FEATURE_VERSION */
+    uint32_t template_blur;
+    uint32_t card_cols;
+    uint32_t card_rows;
+    CardFileSection sections[CardModel::ALGORITHM_COUNT];
+    uint64_t file_size;
+    uint64_t checksum;              /**< XXH64 of everything after the header */
+};
+#pragma pack(pop)
+
+
+static size_t alignUp(size_t value) {
+    return (value + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+
+/**
+ * Compute card features from the card image.
+ * @param card_image BGR card image
+ * @param template_blur Gaussian kernel size applied to the grey template (DetectorConfig::card_template_blur)
+ * @return model, null if the image is empty
+ */
+std::shared_ptr<CardModel> CardModel::build(const cv::Mat& card_image, int template_blur) {
+    if (card_image.empty()) return nullptr;
+
+    std::shared_ptr<CardModel> model = std::make_shared<CardModel>();
+    model->template_blur = template_blur;
+    model->card_size = card_image.size();
+
+    if (card_image.channels() == 1) {
+        model->template_image = card_image.clone();
+    } else {
+        cv::cvtColor(card_image, model->template_image, card_image.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+    }
+    cv::GaussianBlur(model->template_image, model->template_image, cv::Size(template_blur, template_blur), 0);
+
+    // the default descriptor now, so the first detection does not pay for it
+    model->features(SIFT_FEATURES);
+    return model;
+}
+
+
+/**
+ * Features of one algorithm. Extracted from the template on the first call if the model was built
+ * from the image. Thread-safe.
+ * @param algorithm feature algorithm
+ * @param matching_data also derive the index and compact descriptors if not done yet, see usesMatchingData
+ * @return keypoints and descriptors, with matching data if requested now or before
+ */
+const CardFeatures& CardModel::features(Algorithm algorithm, bool matching_data) const {
+    std::call_once(extracted[algorithm], &CardModel::extract, this, algorithm);
+    if (matching_data) std::call_once(matching_built[algorithm], &CardModel::buildMatchingData, this, algorithm);
+    return feature_sets[algorithm];
+}
+
+
+/**
+ * Whether card matching with a config needs the matching data of the card features.
+ * The default FLANN matcher on float descriptors does not, it indexes the image descriptors.
+ * @param config detector config
+ * @return true for CARD_MATCH_INDEX or a compact DescriptorFormat
+ */
+bool CardModel::usesMatchingData(const DetectorConfig& config) {
+    return config.card_matcher == CARD_MATCH_INDEX || config.descriptor_format != DESCRIPTOR_FLOAT;
+}
+
+
+/**
+ * Detect and describe the template keypoints of one algorithm, nothing to do for a mapped file.
+ * @param algorithm feature algorithm
+ */
+void CardModel::extract(Algorithm algorithm) const {
+    if (template_image.empty()) return;
+
+    cv::Ptr<cv::Feature2D> detector = algorithm == SIFT_FEATURES ? cv::Ptr<cv::Feature2D>(cv::SIFT::create())
+                                                                 : cv::Ptr<cv::Feature2D>(cv::ORB::create(ORB_CARD_FEATURES));
+    CardFeatures& features = feature_sets[algorithm];
+    detector->detectAndCompute(template_image, cv::noArray(), features.owned_keypoints, features.descriptors);
+    features.keypoints = features.owned_keypoints.data();
+    features.count = int(features.owned_keypoints.size());
+}
+
+
+/**
+ * Use a card-feature file in place. Keypoints and descriptors point into 'data', nothing is copied
+ * unless the buffer is not 4-byte aligned.
+ * @param data file content, e.g. a mapped asset
+ * @param size file size
+ * @param template_blur blur the caller expects
+ * @param owner keeps 'data' alive as long as the model
+ * @param error reason of the rejection
+ * @return model, null if the file is invalid or stale
+ */
+std::shared_ptr<CardModel> CardModel::fromBuffer(const void* data, size_t size, int template_blur,
+                                                 std::shared_ptr<const void> owner, std::string& error) {
+    const uint8_t* bytes = (const uint8_t*) data;
+    CardFileHeader header;
+    if (!data || size < sizeof(header)) {
+        error = "file too small";
+        return nullptr;
+    }
+    memcpy(&header, bytes, sizeof(header));
+
+    if (memcmp(header.magic, CARD_FILE_MAGIC, sizeof(CARD_FILE_MAGIC)) != 0 || header.format != CARD_FILE_FORMAT
+        || header.header_size != sizeof(header) || header.file_size != size) {
+        error = "not a card-feature file";
+        return nullptr;
+    }
+    if (strncmp(header.opencv_version, CV_VERSION, sizeof(header.opencv_version)) != 0
+        || header.feature_version != CARD_FEATURE_VERSION) {
+        error = "built with another OpenCV or feature version";
+        return nullptr;
+    }
+    if (int(header.template_blur) != template_blur) {
+        error = "built with another template blur";
+        return nullptr;
+    }
+    if (xxh64(bytes + sizeof(header), size - sizeof(header)) != header.checksum) {
+        error = "checksum mismatch";
+        return nullptr;
+    }
+
+    // in place needs float/int alignment, a misaligned buffer is copied once
+    std::shared_ptr<CardModel> model = std::make_shared<CardModel>();
+    if (uintptr_t(bytes) % 4 != 0) {
+        std::shared_ptr<std::vector<uint8_t>> copy = std::make_shared<std::vector<uint8_t>>(bytes, bytes + size);
+        bytes = copy->data();
+        owner = copy;
+    }
+    model->owner = owner;
+    model->template_blur = template_blur;
+    model->card_size = cv::Size(int(header.card_cols), int(header.card_rows));
+
+    for (int a = 0; a < ALGORITHM_COUNT; a++) {
+        const CardFileSection& section = header.sections[a];
+        size_t descriptor_bytes = size_t(section.count) * section.descriptor_cols * CV_ELEM_SIZE(section.descriptor_type);
+        if (section.algorithm != uint32_t(a)
+            || section.keypoints_offset + size_t(section.count) * sizeof(cv::KeyPoint) > size
+            || section.descriptors_offset + descriptor_bytes > size) {
+            error = "corrupt section";
+            return nullptr;
+        }
+        CardFeatures& features = model->feature_sets[a];
+        features.keypoints = (const cv::KeyPoint*) (bytes + section.keypoints_offset);
+        features.count = int(section.count);
+        // matching only reads the descriptors, the const_cast never leads to a write
+        if (section.count > 0) {
+            features.descriptors = cv::Mat(int(section.count), int(section.descriptor_cols), section.descriptor_type,
+                                           const_cast<uint8_t*>(bytes + section.descriptors_offset));
+        }
+    }
+    return model;
+}
+
+
+/**
+ * Derive what matching needs from a float descriptor set: the search index (CARD_MATCH_INDEX)
+ * and the compact descriptors (DescriptorFormat). The index refers to the descriptors, which live as
+ * long as the model. Only the index search modifies it, under index_mutex.
+ * @param algorithm feature algorithm, binary descriptors are left alone
+ */
+void CardModel::buildMatchingData(Algorithm algorithm) const {
+    CardFeatures& features = feature_sets[algorithm];
+    if (features.count < 2 || features.descriptors.type() != CV_32F) return;
+    features.index = std::make_shared<cv::flann::Index>(features.descriptors, cv::flann::KDTreeIndexParams(CARD_INDEX_TREES));
+    features.index_mutex = std::make_shared<std::mutex>();
+
+    features.descriptors.convertTo(features.compact[DESCRIPTOR_UINT8], CV_8U);
+
+    // the card descriptors span the space the image descriptors are compared in
+    features.pca = cv::PCA(features.descriptors, cv::noArray(), cv::PCA::DATA_AS_ROW,
+                           std::min(CARD_PCA_COMPONENTS, features.count));
+
+    // the scale has to hold for any image descriptor, not only the card ones: a projection on a unit
+    // component is at most |d - mean|, and with non-negative elements |d - mean|^2 <= |d|^2 + |mean|^2,
+    // |d| is the SIFT norm plus at most 0.5 rounding per element
+    double descriptor_norm = SIFT_DESCRIPTOR_NORM + 0.5 * sqrt(double(features.descriptors.cols));
+    double mean_norm = cv::norm(features.pca.mean);
+    features.pca_scale = 127 / sqrt(descriptor_norm * descriptor_norm + mean_norm * mean_norm);
+    features.pca.project(features.descriptors).convertTo(features.compact[DESCRIPTOR_PCA_INT8], CV_8S, features.pca_scale);
+}
+
+
+/**
+ * Serialize into the card-feature file format, with the features of all algorithms.
+ * @return file content
+ */
+std::vector<uint8_t> CardModel::serialize() const {
+    for (int a = 0; a < ALGORITHM_COUNT; a++) features(Algorithm(a));
+
+    CardFileHeader header = {};
+    memcpy(header.magic, CARD_FILE_MAGIC, sizeof(CARD_FILE_MAGIC));
+    header.format = CARD_FILE_FORMAT;
+    header.header_size = sizeof(header);
+    strncpy(header.opencv_version, CV_VERSION, sizeof(header.opencv_version) - 1);
+    header.feature_version = CARD_FEATURE_VERSION;
+    header.template_blur = uint32_t(template_blur);
+    header.card_cols = uint32_t(card_size.width);
+    header.card_rows = uint32_t(card_size.height);
+
+    // layout: header, then per algorithm keypoints and descriptors, each section aligned
+    size_t offset = alignUp(sizeof(header));
+    for (int a = 0; a < ALGORITHM_COUNT; a++) {
+        const CardFeatures& features = feature_sets[a];
+        CardFileSection& section = header.sections[a];
+        section.algorithm = uint32_t(a);
+        section.count = uint32_t(features.count);
+        section.descriptor_cols = uint32_t(features.descriptors.cols);
+        section.descriptor_type = features.descriptors.empty() ? CV_32F : features.descriptors.type();
+        section.keypoints_offset = offset;
+        offset = alignUp(offset + features.count * sizeof(cv::KeyPoint));
+        section.descriptors_offset = offset;
+        offset = alignUp(offset + features.descriptors.total() * features.descriptors.elemSize());
+    }
+    header.file_size = offset;
+
+    std::vector<uint8_t> file(offset, 0);
+    for (int a = 0; a < ALGORITHM_COUNT; a++) {
+        const CardFeatures& features = feature_sets[a];
+        const CardFileSection& section = header.sections[a];
+        if (features.count > 0) {
+            memcpy(&file[section.keypoints_offset], features.keypoints, features.count * sizeof(cv::KeyPoint));
+        }
+        size_t row_bytes = features.descriptors.cols * features.descriptors.elemSize();
+        for (int r = 0; r < features.descriptors.rows; r++) {
+            memcpy(&file[section.descriptors_offset + r * row_bytes], features.descriptors.ptr(r), row_bytes);
+        }
+    }
+    header.checksum = xxh64(file.data() + sizeof(header), file.size() - sizeof(header));
+    memcpy(file.data(), &header, sizeof(header));
+    return file;
+}
+
+
+/**
+ * Write the card-feature file.
+ * @param path output file
+ * @return true on success
+ */
+bool CardModel::save(const std::string& path) const {
+    std::vector<uint8_t> file = serialize();
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out.write((const char*) file.data(), std::streamsize(file.size()));
+    return bool(out);
+}
@@ -0,0 +1,79 @@
+#ifndef CARDMODEL_H
+#define CARDMODEL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#include <opencv2/flann.hpp>
+
+#include "DetectorConfig.h"
+
+
+/**
+ * Keypoints and descriptors of the card template for one feature algorithm.
+ * The data is either owned or points into a mapped card-feature file.
+ */
+struct CardFeatures {
+    const cv::KeyPoint* keypoints = nullptr;    /**< 'count' keypoints, in place or in owned_keypoints */
+    int count = 0;
+    cv::Mat descriptors;                        /**< count x descriptor size, header over mapped memory or owned */
+    std::vector<cv::KeyPoint> owned_keypoints;
+    std::shared_ptr<cv::flann::Index> index;    /**< KD-tree over float descriptors, built on first use with matching data. Null for binary ones */
+    std::shared_ptr<std::mutex> index_mutex;    /**< Held during searches, cv::flann::Index::knnSearch is not const and not documented thread-safe */
+    cv::Mat compact[DESCRIPTOR_FORMAT_COUNT];   /**< Float descriptors in the compact DescriptorFormats, empty for binary ones */
+    cv::PCA pca;                                /**< Principal components of the float descriptors, for DESCRIPTOR_PCA_INT8 */
+    double pca_scale = 1;                       /**< Maps the projection of any SIFT descriptor into -127..127 */
+};
+
+
+/**
+ * Everything card detection needs from the card template, computed once per process.
+ * Built from the card image, or used in place from a card-feature file created by tools/CardFeatures.
+ * A model built from the image computes the SIFT features up front and the ORB ones on first use,
+ * most configs never use ORB (DetectorConfig::fast_descriptor). The search index and compact descriptors
+ * of the non-default matchers and formats are likewise derived on first use, see usesMatchingData.
+ * The file is versioned: a file from another OpenCV version, feature code version, template blur or
+ * with a bad checksum is rejected, the caller then builds the model from the image.
+ */
+class CardModel {
+public:
+    enum Algorithm {
+        SIFT_FEATURES = 0,      /**< Default descriptor */
+        ORB_FEATURES = 1,       /**< DetectorConfig::fast_descriptor */
+        ALGORITHM_COUNT
+    };
+
+    static std::shared_ptr<CardModel> build(const cv::Mat& card_image, int template_blur);
+    static std::shared_ptr<CardModel> fromBuffer(const void* data, size_t size, int template_blur,
+                                                 std::shared_ptr<const void> owner, std::string& error);
+
+    std::vector<uint8_t> serialize() const;
+    bool save(const std::string& path) const;
+
+    const CardFeatures& features(Algorithm algorithm, bool matching_data = false) const;
+    static bool usesMatchingData(const DetectorConfig& config);
+    cv::Size size() const { return card_size; }
+    int templateBlur() const { return template_blur; }
+    const cv::Mat& image() const { return template_image; }
+    bool isMapped() const { return bool(owner); }
+
+private:
+    mutable CardFeatures feature_sets[ALGORITHM_COUNT];     /**< Filled on first use of the algorithm when built from the image */
+    mutable std::once_flag extracted[ALGORITHM_COUNT];
+    mutable std::once_flag matching_built[ALGORITHM_COUNT];
+    cv::Size card_size;                 /**< Size of the card template, corners of the card in its coordinates */
+    int template_blur = 0;
+    cv::Mat template_image;             /**< Grey blurred template, empty when loaded from a file */
+    std::shared_ptr<const void> owner;  /**< Keeps the mapped file alive */
+
+    void extract(Algorithm algorithm) const;
+    void buildMatchingData(Algorithm algorithm) const;
+};
+
+
+#endif //CARDMODEL_H
@@ -0,0 +1,100 @@
+#include "DebugCapture.h"
+
+#include <deque>
+#include <mutex>
+#include <iostream>
+#include <opencv2/imgcodecs.hpp>
+
+namespace capture {
+
+std::atomic<bool> enabled(false);
+
+namespace {
+
+    /**
+     * Registered artifact, rendered on dump.
+     */
+    struct Artifact {
+        const char* name;
+        uint64_t frame;
+        uint64_t sequence;
+        std::function<cv::Mat()> render;
+    };
+
+    // capture is a debugging aid, a mutex keeps it simple
+    std::mutex mutex;
+    std::deque<Artifact> artifacts;
+    uint64_t frame_count = 0;
+    uint64_t sequence_count = 0;
+}
+
+
+/**
+ * Turn capture on or off. Turning it off drops the captured artifacts.
+ * @param on true to capture
+ */
+void setEnabled(bool on) {
+    enabled.store(on, std::memory_order_relaxed);
+    if (!on) clear();
+}
+
+
+/**
+ * Start a new frame, artifacts registered from now on carry its number.
+ */
+void beginFrame() {
+    std::lock_guard<std::mutex> lock(mutex);
+    frame_count++;
+}
+
+
+/**
+ * Register an artifact. Use DEBUG_CAPTURE, it skips the snapshot code while capture is disabled.
+ * @param name artifact name, string literal used in the file name
+ * @param render draws the artifact
+ */
+void add(const char* name, std::function<cv::Mat()> render) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (artifacts.size() >= RING_SIZE) artifacts.pop_front();
+    artifacts.push_back({name, frame_count, sequence_count++, std::move(render)});
+}
+
+
+/**
+ * Render all captured artifacts and write them as PNGs named <frame>_<sequence>_<name>.png.
+ * @param directory existing output directory
+ * @return number of written files
+ */
+int dump(const std::string& directory) {
+    std::deque<Artifact> copy;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        copy = artifacts;
+    }
+
+    int written = 0;
+    for (const Artifact& artifact : copy) {
+        cv::Mat image = artifact.render();
+        if (image.empty()) continue;
+
+        std::string path = directory + "/" + std::to_string(artifact.frame) + "_"
+                           + std::to_string(artifact.sequence) + "_" + artifact.name + ".png";
+        if (cv::imwrite(path, image)) {
+            written++;
+        } else {
+            std::cerr << "Error: Unable to write " << path << std::endl;
+        }
+    }
+    return written;
+}
+
+
+/**
+ * Drop all captured artifacts.
+ */
+void clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    artifacts.clear();
+}
+
+} // namespace capture
@@ -0,0 +1,43 @@
+#ifndef DEBUGCAPTURE_H
+#define DEBUGCAPTURE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <opencv2/core.hpp>
+
+
+/**
+ * Runtime capture of intermediate images for diagnosing bad measurements.
+ * Stages register artifacts with DEBUG_CAPTURE. The macro evaluates nothing while capture is disabled,
+ * enabled it runs the snapshot code (copies of the buffers the artifact needs) and keeps a render
+ * function which draws the image only when the buffer is dumped. The last RING_SIZE artifacts are kept.
+ */
+namespace capture {
+
+const int RING_SIZE = 32;           /**< Artifacts kept, older ones are dropped */
+
+extern std::atomic<bool> enabled;
+
+inline bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+void setEnabled(bool on);
+
+void beginFrame();
+void add(const char* name, std::function<cv::Mat()> render);
+int dump(const std::string& directory);
+void clear();
+
+} // namespace capture
+
+
+/**
+ * Register an artifact. The second argument is a lambda returning cv::Mat, it should capture copies
+ * (e.g. [mask = mask.clone()]) because pooled buffers are overwritten by the next frame.
+ * Variadic so the commas of the capture list need no parentheses.
+ */
+#define DEBUG_CAPTURE(name, ...) do { if (capture::isEnabled()) capture::add(name, __VA_ARGS__); } while (0)
+
+
+#endif //DEBUGCAPTURE_H
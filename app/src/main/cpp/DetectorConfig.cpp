@@ -0,0 +1,254 @@
+#include "DetectorConfig.h"
+
+#include <sstream>
+#include <algorithm>
+
+
+/**
+ * Named parameter set.
+ * "fast" works on smaller images with fewer grabcut iterations, "accurate" on larger images with more.
+ * Hough threshold is a number of edge pixels on a line, so it is scaled with the tree image width.
+ * @param name "fast", "balanced" or "accurate", anything else gives "balanced"
+ * @return configuration
+ */
+DetectorConfig DetectorConfig::preset(const std::string& name) {
+    DetectorConfig config;
+
+    if (name == "fast") {
+        config.name = "fast";
+        config.card_resize_width = 800;
+        config.tree_resize_width = 400;
+        config.grabcut_iterations = 3;
+        config.hough_threshold = 34;
+    } else if (name == "accurate") {
+        config.name = "accurate";
+        config.card_resize_width = 1400;
+        config.tree_resize_width = 800;
+        config.grabcut_iterations = 8;
+        config.hough_threshold = 66;
+    } else if (name != "balanced") {
+        std::cerr << "DetectorConfig: unknown preset " << name << ", using balanced" << std::endl;
+    }
+    return config;
+}
+
+
+static void readInt(const cv::FileNode& node, const char* key, int& value) {
+    if (!node[key].empty()) value = (int) node[key];
+}
+
+static void readFloat(const cv::FileNode& node, const char* key, float& value) {
+    if (!node[key].empty()) value = (float) node[key];
+}
+
+static void readDouble(const cv::FileNode& node, const char* key, double& value) {
+    if (!node[key].empty()) value = (double) node[key];
+}
+
+static void readBool(const cv::FileNode& node, const char* key, bool& value) {
+    if (!node[key].empty()) value = (int) node[key] != 0;
+}
+
+static void readScalar(const cv::FileNode& node, const char* key, cv::Scalar& value) {
+    cv::FileNode seq = node[key];
+    if (seq.empty() || !seq.isSeq()) return;
+    for (int i = 0; i < int(seq.size()) && i < 4; i++) {
+        value[i] = (double) seq[i];
+    }
+}
+
+static int oddKernel(int size) {
+    size = std::max(size, 1);
+    return size % 2 ? size : size + 1;
+}
+
+
+/**
+ * Read configuration from a FileStorage map. If the map has a "preset" key, the preset is applied first
+ * and the other keys override it. Missing keys keep their values.
+ * @param node map node
+ * @param config output configuration
+ * @return false if the node is not a map
+ */
+bool DetectorConfig::read(const cv::FileNode& node, DetectorConfig& config) {
+    if (!node.isMap()) return false;
+
+    if (!node["preset"].empty()) {
+        config = preset((std::string) node["preset"]);
+    }
+
+    DetectorConfig before = config;
+    readInt(node, "card_resize_width", config.card_resize_width);
+    readInt(node, "card_image_blur", config.card_image_blur);
+    readInt(node, "card_template_blur", config.card_template_blur);
+    readFloat(node, "ratio_thresh", config.ratio_thresh);
+    readInt(node, "min_good_matches", config.min_good_matches);
+    readBool(node, "fast_descriptor", config.fast_descriptor);
+    readInt(node, "card_matcher", config.card_matcher);
+    readInt(node, "descriptor_format", config.descriptor_format);
+    readInt(node, "tree_resize_width", config.tree_resize_width);
+    readInt(node, "tree_blur", config.tree_blur);
+    readInt(node, "grabcut_iterations", config.grabcut_iterations);
+    readScalar(node, "green_lower", config.green_lower);
+    readScalar(node, "green_upper", config.green_upper);
+    readFloat(node, "seed_line_width", config.seed_line_width);
+    readDouble(node, "canny_low", config.canny_low);
+    readDouble(node, "canny_high", config.canny_high);
+    readInt(node, "hough_threshold", config.hough_threshold);
+    readBool(node, "adaptive_resolution", config.adaptive_resolution);
+    readFloat(node, "target_latency_ms", config.target_latency_ms);
+    readFloat(node, "card_target_pixels", config.card_target_pixels);
+    readFloat(node, "tree_card_pixels", config.tree_card_pixels);
+
+    // sanitize values the OpenCV calls would reject
+    config.card_resize_width = std::max(config.card_resize_width, 100);
+    config.tree_resize_width = std::max(config.tree_resize_width, 100);
+    config.card_image_blur = oddKernel(config.card_image_blur);
+    config.card_template_blur = oddKernel(config.card_template_blur);
+    config.tree_blur = oddKernel(config.tree_blur);
+    config.grabcut_iterations = std::max(config.grabcut_iterations, 1);
+    config.min_good_matches = std::max(config.min_good_matches, 4);
+    if (config.card_matcher < CARD_MATCH_FLANN || config.card_matcher > CARD_MATCH_BRUTE_FORCE) {
+        config.card_matcher = CARD_MATCH_FLANN;
+    }
+    if (config.descriptor_format < DESCRIPTOR_FLOAT || config.descriptor_format >= DESCRIPTOR_FORMAT_COUNT) {
+        config.descriptor_format = DESCRIPTOR_FLOAT;
+    }
+
+    if (config.version() != before.version()) {
+        config.name = "custom";
+    }
+    if (!node["name"].empty()) {
+        config.name = (std::string) node["name"];
+    }
+    return true;
+}
+
+
+/**
+ * Load configuration from a JSON (or YAML/XML) file.
+ * @param path file path
+ * @param config output configuration, unchanged on failure
+ * @return true on success
+ */
+bool DetectorConfig::load(const std::string& path, DetectorConfig& config) {
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    if (!fs.isOpened()) {
+        std::cerr << "DetectorConfig: unable to read " << path << std::endl;
+        return false;
+    }
+    DetectorConfig loaded = config;
+    if (!read(fs.root(), loaded)) return false;
+    config = loaded;
+    return true;
+}
+
+
+/**
+ * Load configuration from JSON in memory, e.g. from an Android asset.
+ * @param json document
+ * @param config output configuration, unchanged on failure
+ * @return true on success
+ */
+bool DetectorConfig::loadFromString(const std::string& json, DetectorConfig& config) {
+    try {
+        cv::FileStorage fs(json, cv::FileStorage::READ | cv::FileStorage::MEMORY | cv::FileStorage::FORMAT_JSON);
+        if (!fs.isOpened()) return false;
+        DetectorConfig loaded = config;
+        if (!read(fs.root(), loaded)) return false;
+        config = loaded;
+        return true;
+    } catch (const cv::Exception& e) {
+        std::cerr << "DetectorConfig: invalid JSON: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+
+/**
+ * Write all parameters into an open FileStorage.
+ * @param fs storage opened for writing
+ */
+void DetectorConfig::write(cv::FileStorage& fs) const {
+    fs << "name" << name;
+    fs << "card_resize_width" << card_resize_width;
+    fs << "card_image_blur" << card_image_blur;
+    fs << "card_template_blur" << card_template_blur;
+    fs << "ratio_thresh" << ratio_thresh;
+    fs << "min_good_matches" << min_good_matches;
+    fs << "fast_descriptor" << int(fast_descriptor);
+    fs << "card_matcher" << card_matcher;
+    fs << "descriptor_format" << descriptor_format;
+    fs << "tree_resize_width" << tree_resize_width;
+    fs << "tree_blur" << tree_blur;
+    fs << "grabcut_iterations" << grabcut_iterations;
+    fs << "green_lower" << std::vector<double>{green_lower[0], green_lower[1], green_lower[2]};
+    fs << "green_upper" << std::vector<double>{green_upper[0], green_upper[1], green_upper[2]};
+    fs << "seed_line_width" << seed_line_width;
+    fs << "canny_low" << canny_low;
+    fs << "canny_high" << canny_high;
+    fs << "hough_threshold" << hough_threshold;
+    fs << "adaptive_resolution" << int(adaptive_resolution);
+    fs << "target_latency_ms" << target_latency_ms;
+    fs << "card_target_pixels" << card_target_pixels;
+    fs << "tree_card_pixels" << tree_card_pixels;
+}
+
+
+/**
+ * Save configuration as JSON.
+ * @param path output file (.json)
+ * @return true on success
+ */
+bool DetectorConfig::save(const std::string& path) const {
+    cv::FileStorage fs(path, cv::FileStorage::WRITE | cv::FileStorage::FORMAT_JSON);
+    if (!fs.isOpened()) return false;
+    write(fs);
+    return true;
+}
+
+
+/**
+ * Hash of all parameters which influence the result (FNV-1a over their text form). The name is not included.
+ * @return configuration version
+ */
+uint64_t DetectorConfig::version() const {
+    DetectorConfig unnamed = *this;
+    unnamed.name.clear();
+    std::ostringstream text;
+    text << unnamed;
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : text.str()) {
+        hash ^= uint64_t(uchar(c));
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+std::ostream& operator<<(std::ostream& out, const DetectorConfig& config) {
+    out << config.name
+        << " card_resize_width=" << config.card_resize_width
+        << " card_image_blur=" << config.card_image_blur
+        << " card_template_blur=" << config.card_template_blur
+        << " ratio_thresh=" << config.ratio_thresh
+        << " min_good_matches=" << config.min_good_matches
+        << " fast_descriptor=" << config.fast_descriptor
+        << " card_matcher=" << config.card_matcher
+        << " descriptor_format=" << config.descriptor_format
+        << " tree_resize_width=" << config.tree_resize_width
+        << " tree_blur=" << config.tree_blur
+        << " grabcut_iterations=" << config.grabcut_iterations
+        << " green_lower=" << config.green_lower[0] << "," << config.green_lower[1] << "," << config.green_lower[2]
+        << " green_upper=" << config.green_upper[0] << "," << config.green_upper[1] << "," << config.green_upper[2]
+        << " seed_line_width=" << config.seed_line_width
+        << " canny_low=" << config.canny_low
+        << " canny_high=" << config.canny_high
+        << " hough_threshold=" << config.hough_threshold
+        << " adaptive_resolution=" << config.adaptive_resolution
+        << " target_latency_ms=" << config.target_latency_ms
+        << " card_target_pixels=" << config.card_target_pixels
+        << " tree_card_pixels=" << config.tree_card_pixels;
+    return out;
+}
@@ -0,0 +1,84 @@
+#ifndef DETECTORCONFIG_H
+#define DETECTORCONFIG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <iostream>
+#include <opencv2/core.hpp>
+
+
+/**
+ * How SIFT card descriptors are matched to the image descriptors (DetectorConfig::card_matcher).
+ */
+enum CardMatcher {
+    CARD_MATCH_FLANN = 0,           /**< KD-tree over the image descriptors, rebuilt for every image */
+    CARD_MATCH_INDEX = 1,           /**< Image descriptors searched in the KD-tree of the card model, built once; the ratio test is per image keypoint */
+    CARD_MATCH_BRUTE_FORCE = 2      /**< Exact SIMD search of the image descriptors for every card descriptor */
+};
+
+
+/**
+ * Element format SIFT descriptors are matched in (DetectorConfig::descriptor_format).
+ * Compact formats cut the memory read per compared pair from 512 to 128 or 64 bytes.
+ * Measured on tree.jpeg with its card, 48 variants of rotation, exposure, scale and noise, single-threaded x86 AVX2:
+ * UINT8 gave the same good matches and card corners as FLOAT on all of them and its brute force was 1.3-1.8x faster.
+ * PCA_INT8 moved the card corners by more than 2 px on 14 of 48 (one wrong card), and projecting the image
+ * descriptors took as long as its 1.9-2.4x faster brute force saved, so it stays experimental.
+ */
+enum DescriptorFormat {
+    DESCRIPTOR_FLOAT = 0,           /**< 128 floats as SIFT computes them */
+    DESCRIPTOR_UINT8 = 1,           /**< 128 bytes, lossless as SIFT elements are integers 0-255 */
+    DESCRIPTOR_PCA_INT8 = 2,        /**< Experimental, lossy: 64 signed bytes, projection on the principal components of the card descriptors */
+    DESCRIPTOR_FORMAT_COUNT
+};
+
+
+/**
+ * Tunable parameters of the whole pipeline. Defaults are the "balanced" preset,
+ * which matches the values the pipeline was developed with.
+ */
+struct DetectorConfig {
+    std::string name = "balanced";      /**< Preset name or "custom" */
+
+    // card detection (CardDetection::findCard)
+    int card_resize_width = 1000;       /**< Width of the image SIFT runs on */
+    int card_image_blur = 5;            /**< Gaussian kernel size for the resized image */
+    int card_template_blur = 3;         /**< Gaussian kernel size for the card image */
+    float ratio_thresh = 0.5f;          /**< Lowe's ratio test, higher ratio -> more matches */
+    int min_good_matches = 5;           /**< Fewer good matches means the card was not found */
+    bool fast_descriptor = false;       /**< ORB instead of SIFT, much faster but less reliable */
+    int card_matcher = CARD_MATCH_FLANN;        /**< CardMatcher of the SIFT descriptors, ORB ones are always matched by brute force */
+    int descriptor_format = DESCRIPTOR_FLOAT;   /**< DescriptorFormat of the SIFT matching, compact ones are matched by brute force */
+
+    // tree detection (TreeDetection)
+    int tree_resize_width = 600;        /**< Width of the image tree detection runs on */
+    int tree_blur = 3;                  /**< Gaussian kernel size for the resized image */
+    int grabcut_iterations = 5;
+    cv::Scalar green_lower = cv::Scalar(38, 55, 55);    /**< HSV range of the green background */
+    cv::Scalar green_upper = cv::Scalar(95, 255, 255);
+    float seed_line_width = 0.11f;      /**< Half width of the foreground seed behind the card, relative to ROI width */
+    double canny_low = 50;
+    double canny_high = 200;
+    int hough_threshold = 50;           /**< Votes at tree_resize_width, scaled with the working width */
+
+    // adaptive resolution (ResolutionScheduler)
+    bool adaptive_resolution = false;   /**< Choose working widths per frame instead of the fixed ones */
+    float target_latency_ms = 0;        /**< Card + tree detection time to fit in, 0 for no target */
+    float card_target_pixels = 160;     /**< Card width in the SIFT image */
+    float tree_card_pixels = 100;       /**< Card width in the tree detection image */
+
+    static DetectorConfig preset(const std::string& name);
+    static bool load(const std::string& path, DetectorConfig& config);
+    static bool loadFromString(const std::string& json, DetectorConfig& config);
+    static bool read(const cv::FileNode& node, DetectorConfig& config);
+
+    bool save(const std::string& path) const;
+    void write(cv::FileStorage& fs) const;
+    uint64_t version() const;
+};
+
+std::ostream& operator<<(std::ostream& out, const DetectorConfig& config);
+
+
+#endif //DETECTORCONFIG_H
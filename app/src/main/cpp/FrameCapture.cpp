@@ -0,0 +1,643 @@
+#include "FrameCapture.h"
+#include "Hash.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+
+static const char CAPTURE_MAGIC[8] = {'T', 'R', 'E', 'E', 'C', 'A', 'P', '1'};
+static const char CAPTURE_END_MAGIC[8] = {'T', 'R', 'E', 'E', 'C', 'A', 'P', 'E'};
+static const uint32_t CAPTURE_FORMAT = 1;
+static const size_t CHUNK_ALIGNMENT = 64;       // frame planes start on a cache line of the mapped file
+static const size_t CAPTURE_QUEUE_FRAMES = 4;   // frames waiting for the writer before new ones are dropped
+static const int PACK_BLOCK = 16;               // residuals sharing one bit width
+
+// chunk types, four characters read as a little-endian uint32
+static const uint32_t CHUNK_INFO = 0x4f464e49;  // "INFO"
+static const uint32_t CHUNK_FRAME = 0x4d415246; // "FRAM"
+static const uint32_t CHUNK_INDEX = 0x58444e49; // "INDX"
+
+// file layout, little-endian, offsets from the start of the file
+#pragma pack(push, 1)
+struct CaptureFileHeader {
+    char magic[8];
+    uint32_t format;
+    uint32_t header_size;
+};
+
+struct CaptureChunkHeader {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t payload_size;
+    uint64_t checksum;              /**< XXH64 of the payload */
+    uint64_t reserved2;
+};
+
+struct CaptureFrameHeader {
+    int64_t id;
+    int64_t timestamp_ns;
+    uint32_t pixel_format;
+    uint32_t cols;
+    uint32_t rows;
+    int16_t rotation;
+    uint16_t codec;
+};
+
+struct CaptureFileFooter {
+    uint64_t index_offset;          /**< Chunk with the frame chunk offsets */
+    char magic[8];
+};
+#pragma pack(pop)
+
+static_assert(sizeof(CaptureChunkHeader) + sizeof(CaptureFrameHeader) == CHUNK_ALIGNMENT, "frame planes must stay aligned");
+
+
+static size_t alignUp(size_t value) {
+    return (value + CHUNK_ALIGNMENT - 1) / CHUNK_ALIGNMENT * CHUNK_ALIGNMENT;
+}
+
+
+/**
+ * Plane of a frame buffer, samples of one channel are 'channels' bytes apart.
+ */
+struct Plane {
+    size_t offset;
+    int rows;
+    int row_bytes;
+    int channels;
+};
+
+
+/**
+ * Planes of a continuous frame buffer in the layout of its PixelFormat.
+ * @param planes output, up to 3
+ * @return number of planes
+ */
+static int framePlanes(int format, cv::Size size, Plane planes[3]) {
+    int w = size.width, h = size.height;
+    switch (format) {
+        case PIXEL_RGBA:
+            planes[0] = {0, h, w * 4, 4};
+            return 1;
+        case PIXEL_GRAY:
+            planes[0] = {0, h, w, 1};
+            return 1;
+        case PIXEL_NV21:
+            planes[0] = {0, h, w, 1};
+            planes[1] = {size_t(w) * h, h / 2, w, 2};
+            return 2;
+        case PIXEL_I420:
+            planes[0] = {0, h, w, 1};
+            planes[1] = {size_t(w) * h, h / 2, w / 2, 1};
+            planes[2] = {size_t(w) * h + size_t(w / 2) * (h / 2), h / 2, w / 2, 1};
+            return 3;
+        default:
+            planes[0] = {0, h, w * 3, 3};
+            return 1;
+    }
+}
+
+
+/**
+ * Header of a frame buffer over 'data', the shape SourceImage::wrap expects for the format.
+ */
+static cv::Mat frameMat(int format, cv::Size size, void* data) {
+    switch (format) {
+        case PIXEL_RGBA: return cv::Mat(size, CV_8UC4, data);
+        case PIXEL_GRAY: return cv::Mat(size, CV_8UC1, data);
+        case PIXEL_NV21:
+        case PIXEL_I420: return cv::Mat(size.height * 3 / 2, size.width, CV_8UC1, data);
+        default: return cv::Mat(size, CV_8UC3, data);
+    }
+}
+
+
+/**
+ * Prediction of a sample from its decoded neighbours: mean of left and above, one of them at the edges.
+ */
+static inline int predict(const uint8_t* row, const uint8_t* above, int x, int channels) {
+    if (x >= channels) return above ? (row[x - channels] + above[x] + 1) >> 1 : row[x - channels];
+    return above ? above[x] : 0;
+}
+
+
+/**
+ * Lossless CAPTURE_PACKED encoding: per sample the prediction residual, zigzag coded, then blocks of
+ * PACK_BLOCK residuals as one byte of bit width followed by the residuals packed in that width.
+ * Camera noise keeps most residuals within a few bits, so frames shrink to roughly half.
+ * @param pixels continuous frame buffer
+ * @param out encoded bytes, appended
+ */
+static void encodePlanes(const uint8_t* pixels, int format, cv::Size size, std::vector<uint8_t>& out) {
+    Plane planes[3];
+    int count = framePlanes(format, size, planes);
+    size_t samples = planes[count - 1].offset + size_t(planes[count - 1].rows) * planes[count - 1].row_bytes;
+    // worst case a width byte and 16 bytes per block
+    size_t start = out.size();
+    out.resize(start + (samples / PACK_BLOCK + 1) * (PACK_BLOCK + 1));
+    uint8_t* dst = out.data() + start;
+
+    uint8_t block[PACK_BLOCK];
+    int filled = 0;
+    auto flush = [&dst, &block, &filled]() {
+        uint8_t all = 0;
+        for (int i = filled; i < PACK_BLOCK; i++) block[i] = 0;
+        for (int i = 0; i < PACK_BLOCK; i++) all |= block[i];
+        int width = 0;
+        while (width < 8 && (all >> width)) width++;
+        *dst++ = uint8_t(width);
+        // two halves of 8 residuals, each packed into 'width' bytes
+        for (int half = 0; half < 2 && width > 0; half++) {
+            uint64_t bits = 0;
+            for (int i = 0; i < 8; i++) bits |= uint64_t(block[half * 8 + i]) << (i * width);
+            memcpy(dst, &bits, size_t(width));
+            dst += width;
+        }
+        filled = 0;
+    };
+
+    for (int p = 0; p < count; p++) {
+        const Plane& plane = planes[p];
+        for (int r = 0; r < plane.rows; r++) {
+            const uint8_t* row = pixels + plane.offset + size_t(r) * plane.row_bytes;
+            const uint8_t* above = r > 0 ? row - plane.row_bytes : nullptr;
+            for (int x = 0; x < plane.row_bytes; x++) {
+                int8_t residual = int8_t(uint8_t(row[x] - predict(row, above, x, plane.channels)));
+                block[filled++] = uint8_t((residual << 1) ^ (residual >> 7));
+                if (filled == PACK_BLOCK) flush();
+            }
+        }
+    }
+    if (filled > 0) flush();
+    out.resize(size_t(dst - out.data()));
+}
+
+
+/**
+ * Decode a CAPTURE_PACKED frame.
+ * @param data encoded bytes
+ * @param length number of encoded bytes
+ * @param pixels continuous output buffer of the frame size
+ * @return false if the data does not match the frame size
+ */
+static bool decodePlanes(const uint8_t* data, size_t length, int format, cv::Size size, uint8_t* pixels) {
+    Plane planes[3];
+    int count = framePlanes(format, size, planes);
+    const uint8_t* end = data + length;
+    uint8_t block[PACK_BLOCK];
+    int used = PACK_BLOCK;
+    auto refill = [&data, end, &block, &used]() {
+        if (data >= end || *data > 8 || size_t(end - data) < 1 + 2 * size_t(*data)) return false;
+        int width = *data++;
+        uint8_t mask = uint8_t((1 << width) - 1);
+        for (int half = 0; half < 2; half++) {
+            uint64_t bits = 0;
+            memcpy(&bits, data, size_t(width));
+            data += width;
+            for (int i = 0; i < 8; i++) block[half * 8 + i] = uint8_t((bits >> (i * width)) & mask);
+        }
+        used = 0;
+        return true;
+    };
+
+    for (int p = 0; p < count; p++) {
+        const Plane& plane = planes[p];
+        for (int r = 0; r < plane.rows; r++) {
+            uint8_t* row = pixels + plane.offset + size_t(r) * plane.row_bytes;
+            const uint8_t* above = r > 0 ? row - plane.row_bytes : nullptr;
+            for (int x = 0; x < plane.row_bytes; x++) {
+                if (used == PACK_BLOCK && !refill()) return false;
+                uint8_t zigzag = block[used++];
+                int residual = (zigzag >> 1) ^ -(zigzag & 1);
+                row[x] = uint8_t(predict(row, above, x, plane.channels) + residual);
+            }
+        }
+    }
+    return data == end;
+}
+
+
+/**
+ * Info chunk content.
+ */
+static std::string infoJson(const CaptureInfo& info) {
+    cv::FileStorage fs(".json", cv::FileStorage::WRITE | cv::FileStorage::MEMORY | cv::FileStorage::FORMAT_JSON);
+    fs << "device" << info.device;
+    fs << "opencv_version" << info.opencv_version;
+    // FileStorage has no 64-bit integers, a double holds ms timestamps exactly
+    fs << "start_time_ms" << double(info.start_time_ms);
+    fs << "deadline_ms" << info.deadline_ms;
+    fs << "config" << "{";
+    info.config.write(fs);
+    fs << "}";
+    return fs.releaseAndGetString();
+}
+
+
+/**
+ * Parse the info chunk content.
+ * @return false if it is not valid JSON
+ */
+static bool parseInfoJson(const std::string& json, CaptureInfo& info) {
+    try {
+        cv::FileStorage fs(json, cv::FileStorage::READ | cv::FileStorage::MEMORY | cv::FileStorage::FORMAT_JSON);
+        if (!fs.isOpened()) return false;
+        info.device = (std::string) fs["device"];
+        info.opencv_version = (std::string) fs["opencv_version"];
+        info.start_time_ms = int64_t((double) fs["start_time_ms"]);
+        info.deadline_ms = (double) fs["deadline_ms"];
+        return DetectorConfig::read(fs["config"], info.config);
+    } catch (const cv::Exception& e) {
+        std::cerr << "CaptureReader: invalid info: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+
+FrameRecorder::~FrameRecorder() {
+    close();
+}
+
+
+/**
+ * Create the capture file, write its header and info chunk and start the writer thread.
+ * @param path capture file, overwritten
+ * @param info session description
+ * @param codec CaptureCodec of the frames, CAPTURE_PACKED frames which would not shrink are stored raw
+ * @param max_bytes file size after which new frames are no longer recorded, the index comes on top; 0 for no limit
+ * @return false if the file cannot be written or the recorder is open
+ */
+bool FrameRecorder::open(const std::string& path, const CaptureInfo& info, int codec, uint64_t max_bytes) {
+    if (file) return false;
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "FrameRecorder: unable to create " << path << std::endl;
+        return false;
+    }
+    this->codec = codec;
+    this->max_bytes = max_bytes;
+
+    // nothing of a previous capture carries over; its writer thread was joined by close()
+    frame_offsets.clear();
+    queue.clear();
+    spare.clear();
+    first_timestamp_ns = -1;
+    written = 0;
+    dropped = 0;
+    raw_bytes = 0;
+    file_bytes = 0;
+    full = false;
+
+    CaptureFileHeader header = {};
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    header.format = CAPTURE_FORMAT;
+    header.header_size = sizeof(header);
+    std::vector<uint8_t> padded(alignUp(sizeof(header)), 0);
+    memcpy(padded.data(), &header, sizeof(header));
+    write_failed = fwrite(padded.data(), 1, padded.size(), file) != padded.size();
+    offset = padded.size();
+
+    std::string json = infoJson(info);
+    if (write_failed || !writeChunk(CHUNK_INFO, json.data(), json.size())) {
+        std::cerr << "FrameRecorder: unable to write " << path << std::endl;
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+    fflush(file);
+    file_bytes = offset;
+
+    closing = false;
+    writer = std::thread(&FrameRecorder::run, this);
+    return true;
+}
+
+
+/**
+ * Queue a copy of a frame for writing. Never waits for the disk.
+ * @param image frame in the layout the pipeline gets it
+ * @param rotation clockwise rotation to upright
+ * @param id frame number of the source
+ * @param timestamp_ns arrival time, any monotonic clock
+ * @return false if the frame was dropped or the recorder is not open
+ */
+bool FrameRecorder::add(const SourceImage& image, int rotation, int64_t id, int64_t timestamp_ns) {
+    Pending frame;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!file || closing || full) return false;
+        if (queue.size() >= CAPTURE_QUEUE_FRAMES) {
+            dropped++;
+            return false;
+        }
+        if (first_timestamp_ns < 0) first_timestamp_ns = timestamp_ns;
+        frame.timestamp_ns = timestamp_ns - first_timestamp_ns;
+        if (!spare.empty()) {
+            frame.pixels = spare.back();
+            spare.pop_back();
+        }
+    }
+
+    // the copy is continuous, also of a non-continuous source
+    image.pixels().copyTo(frame.pixels);
+    frame.format = image.format();
+    frame.size = image.size();
+    frame.rotation = rotation;
+    frame.id = id;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(frame));
+    }
+    changed.notify_one();
+    return true;
+}
+
+
+/**
+ * Write one chunk at the end of the file, padded to CHUNK_ALIGNMENT.
+ * @return false on a write error
+ */
+bool FrameRecorder::writeChunk(uint32_t type, const void* payload, size_t payload_size) {
+    CaptureChunkHeader chunk = {};
+    chunk.type = type;
+    chunk.payload_size = payload_size;
+    chunk.checksum = xxh64(payload, payload_size);
+    static const uint8_t zeros[CHUNK_ALIGNMENT] = {};
+    size_t padding = alignUp(sizeof(chunk) + payload_size) - sizeof(chunk) - payload_size;
+    bool ok = fwrite(&chunk, 1, sizeof(chunk), file) == sizeof(chunk)
+              && fwrite(payload, 1, payload_size, file) == payload_size
+              && fwrite(zeros, 1, padding, file) == padding;
+    offset += sizeof(chunk) + payload_size + padding;
+    return ok;
+}
+
+
+/**
+ * Encode and write one frame chunk. Flushed, so a crash loses at most the frames still queued.
+ */
+void FrameRecorder::writeFrame(const Pending& frame) {
+    CaptureFrameHeader header = {};
+    header.id = frame.id;
+    header.timestamp_ns = frame.timestamp_ns;
+    header.pixel_format = uint32_t(frame.format);
+    header.cols = uint32_t(frame.size.width);
+    header.rows = uint32_t(frame.size.height);
+    header.rotation = int16_t(frame.rotation);
+
+    size_t raw_size = frame.pixels.total() * frame.pixels.elemSize();
+    encoded.resize(sizeof(header));
+    if (codec == CAPTURE_PACKED) {
+        encodePlanes(frame.pixels.data, frame.format, frame.size, encoded);
+    }
+    if (codec != CAPTURE_PACKED || encoded.size() - sizeof(header) >= raw_size) {
+        encoded.resize(sizeof(header));
+        encoded.insert(encoded.end(), frame.pixels.data, frame.pixels.data + raw_size);
+        header.codec = CAPTURE_RAW;
+    } else {
+        header.codec = CAPTURE_PACKED;
+    }
+    memcpy(encoded.data(), &header, sizeof(header));
+
+    if (max_bytes > 0 && offset + alignUp(sizeof(CaptureChunkHeader) + encoded.size()) > max_bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!full) std::cerr << "FrameRecorder: size limit of " << max_bytes << " bytes reached" << std::endl;
+        full = true;
+        return;
+    }
+    uint64_t chunk_offset = offset;
+    if (write_failed || !writeChunk(CHUNK_FRAME, encoded.data(), encoded.size()) || fflush(file) != 0) {
+        write_failed = true;
+        return;
+    }
+    frame_offsets.push_back(chunk_offset);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    written++;
+    raw_bytes += raw_size;
+    file_bytes = offset;
+}
+
+
+/**
+ * Writer loop, runs until close() and the queue is empty.
+ */
+void FrameRecorder::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        changed.wait(lock, [this] { return closing || !queue.empty(); });
+        if (queue.empty()) break;
+        Pending frame = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+        writeFrame(frame);
+        lock.lock();
+        spare.push_back(frame.pixels);
+    }
+}
+
+
+/**
+ * Write the queued frames and the index, close the file.
+ * @return false if anything could not be written
+ */
+bool FrameRecorder::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!file || closing) return false;
+        closing = true;
+    }
+    changed.notify_one();
+    if (writer.joinable()) writer.join();
+
+    uint64_t index_offset = offset;
+    bool ok = !write_failed && writeChunk(CHUNK_INDEX, frame_offsets.data(), frame_offsets.size() * sizeof(uint64_t));
+    CaptureFileFooter footer = {};
+    footer.index_offset = index_offset;
+    memcpy(footer.magic, CAPTURE_END_MAGIC, sizeof(CAPTURE_END_MAGIC));
+    ok = ok && fwrite(&footer, 1, sizeof(footer), file) == sizeof(footer);
+    offset += sizeof(footer);
+    ok = fclose(file) == 0 && ok;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    file = nullptr;
+    file_bytes = offset;
+    spare.clear();
+    return ok;
+}
+
+
+int64_t FrameRecorder::framesWritten() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return written;
+}
+
+int64_t FrameRecorder::framesDropped() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dropped;
+}
+
+uint64_t FrameRecorder::bytesWritten() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return file_bytes;
+}
+
+uint64_t FrameRecorder::rawBytes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return raw_bytes;
+}
+
+bool FrameRecorder::isFull() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return full;
+}
+
+
+/**
+ * Map a capture file and find its frames, from the index or, if the capture was not closed, by
+ * walking the chunks up to the first incomplete one.
+ * @param path capture file
+ * @param error reason of the failure
+ * @return false if the file is not a capture
+ */
+bool CaptureReader::open(const std::string& path, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "unable to open " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < alignUp(sizeof(CaptureFileHeader)) + sizeof(CaptureChunkHeader)) {
+        ::close(fd);
+        error = "file too small";
+        return false;
+    }
+    size_t length = size_t(st.st_size);
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        error = "unable to map " + path;
+        return false;
+    }
+    mapping = std::shared_ptr<const void>(mapped, [length](const void* p) { munmap(const_cast<void*>(p), length); });
+    bytes = (const uint8_t*) mapped;
+    size = length;
+    frame_offsets.clear();
+    indexed = false;
+
+    CaptureFileHeader header;
+    memcpy(&header, bytes, sizeof(header));
+    if (memcmp(header.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 || header.format != CAPTURE_FORMAT
+        || header.header_size != sizeof(header)) {
+        error = "not a capture file";
+        return false;
+    }
+
+    // the info chunk comes first
+    size_t info_offset = alignUp(sizeof(header));
+    CaptureChunkHeader chunk;
+    memcpy(&chunk, bytes + info_offset, sizeof(chunk));
+    const uint8_t* info_payload = bytes + info_offset + sizeof(chunk);
+    if (chunk.type != CHUNK_INFO || chunk.payload_size > size - info_offset - sizeof(chunk)
+        || xxh64(info_payload, chunk.payload_size) != chunk.checksum
+        || !parseInfoJson(std::string((const char*) info_payload, chunk.payload_size), capture_info)) {
+        error = "invalid info chunk";
+        return false;
+    }
+
+    // closed cleanly: the footer points to the index
+    CaptureFileFooter footer;
+    memcpy(&footer, bytes + size - sizeof(footer), sizeof(footer));
+    if (memcmp(footer.magic, CAPTURE_END_MAGIC, sizeof(CAPTURE_END_MAGIC)) == 0
+        && footer.index_offset <= size - sizeof(footer) - sizeof(chunk)) {
+        memcpy(&chunk, bytes + footer.index_offset, sizeof(chunk));
+        const uint8_t* payload = bytes + footer.index_offset + sizeof(chunk);
+        if (chunk.type == CHUNK_INDEX && chunk.payload_size % sizeof(uint64_t) == 0
+            && chunk.payload_size <= size - footer.index_offset - sizeof(chunk)
+            && xxh64(payload, chunk.payload_size) == chunk.checksum) {
+            frame_offsets.resize(chunk.payload_size / sizeof(uint64_t));
+            memcpy(frame_offsets.data(), payload, chunk.payload_size);
+            indexed = true;
+            return true;
+        }
+    }
+
+    // cut short: every complete frame chunk counts
+    size_t at = alignUp(info_offset + sizeof(chunk) + chunk.payload_size);
+    while (at + sizeof(chunk) <= size) {
+        memcpy(&chunk, bytes + at, sizeof(chunk));
+        if (chunk.payload_size > size - at - sizeof(chunk)) break;
+        if (chunk.type == CHUNK_FRAME) frame_offsets.push_back(at);
+        at = alignUp(at + sizeof(chunk) + chunk.payload_size);
+    }
+    return true;
+}
+
+
+/**
+ * Get a frame. Raw frames point into the mapped file, packed ones into a buffer of the reader.
+ * @param index frame number in the capture, 0 to frameCount() - 1
+ * @param frame output, valid until the next call
+ * @param error reason of the failure
+ * @return false if the frame is corrupt
+ */
+bool CaptureReader::frame(size_t index, CapturedFrame& frame, std::string& error) {
+    if (index >= frame_offsets.size()) {
+        error = "no such frame";
+        return false;
+    }
+    uint64_t at = frame_offsets[index];
+    CaptureChunkHeader chunk;
+    CaptureFrameHeader header;
+    if (at > size || size - at < sizeof(chunk) + sizeof(header)) {
+        error = "frame outside the file";
+        return false;
+    }
+    memcpy(&chunk, bytes + at, sizeof(chunk));
+    const uint8_t* payload = bytes + at + sizeof(chunk);
+    if (chunk.type != CHUNK_FRAME || chunk.payload_size < sizeof(header) || chunk.payload_size > size - at - sizeof(chunk)
+        || xxh64(payload, chunk.payload_size) != chunk.checksum) {
+        error = "corrupt frame chunk";
+        return false;
+    }
+    memcpy(&header, payload, sizeof(header));
+
+    cv::Size frame_size(int(header.cols), int(header.rows));
+    int format = int(header.pixel_format);
+    bool yuv = format == PIXEL_NV21 || format == PIXEL_I420;
+    if (format < 0 || format >= PIXEL_FORMAT_COUNT || frame_size.width <= 0 || frame_size.height <= 0
+        || (yuv && (frame_size.width % 2 != 0 || frame_size.height % 2 != 0))) {
+        error = "invalid frame size or format";
+        return false;
+    }
+    Plane planes[3];
+    int count = framePlanes(format, frame_size, planes);
+    size_t raw_size = planes[count - 1].offset + size_t(planes[count - 1].rows) * planes[count - 1].row_bytes;
+    const uint8_t* data = payload + sizeof(header);
+    size_t data_size = chunk.payload_size - sizeof(header);
+
+    cv::Mat pixels;
+    if (header.codec == CAPTURE_RAW && data_size == raw_size) {
+        // the pipeline only reads the frame, the const_cast never leads to a write
+        pixels = frameMat(format, frame_size, const_cast<uint8_t*>(data));
+    } else if (header.codec == CAPTURE_PACKED) {
+        decoded.create(int(raw_size), 1, CV_8U);
+        if (!decodePlanes(data, data_size, format, frame_size, decoded.data)) {
+            error = "corrupt packed frame";
+            return false;
+        }
+        pixels = frameMat(format, frame_size, decoded.data);
+    } else {
+        error = "unknown codec";
+        return false;
+    }
+
+    frame.id = header.id;
+    frame.timestamp_ns = header.timestamp_ns;
+    frame.rotation = header.rotation;
+    frame.image = SourceImage::wrap(pixels, format);
+    return true;
+}
@@ -0,0 +1,140 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "DetectorConfig.h"
+#include "SourceImage.h"
+
+
+/**
+ * How the pixels of a captured frame are stored.
+ */
+enum CaptureCodec {
+    CAPTURE_RAW = 0,        /**< Planes as they are, the frame is used in place from the mapped file */
+    CAPTURE_PACKED = 1      /**< Lossless: residuals of a neighbour prediction, bit-packed in blocks of 16 */
+};
+
+
+/**
+ * Recording session description, stored at the start of a capture.
+ */
+struct CaptureInfo {
+    std::string device;             /**< Free text, e.g. manufacturer, model, Android version, ABI */
+    DetectorConfig config;          /**< Config the frames were measured with */
+    double deadline_ms = 0;         /**< Frame deadline of the live measurement, 0 for none */
+    int64_t start_time_ms = 0;      /**< Wall clock at the start, ms since the epoch */
+    std::string opencv_version;     /**< CV_VERSION of the recording build */
+};
+
+
+/**
+ * Frame as fed to the native pipeline.
+ */
+struct CapturedFrame {
+    int64_t id = 0;                 /**< Frame number of the source, gaps are frames the recorder dropped */
+    int64_t timestamp_ns = 0;       /**< Arrival time, relative to the first frame of the capture */
+    int rotation = 0;               /**< Clockwise rotation to upright, applied by the pipeline */
+    SourceImage image;
+};
+
+
+/**
+ * Records frames into a capture file on its own thread. The caller only copies the frame;
+ * when the writer falls behind by more than a few frames, new frames are dropped and counted.
+ *
+ * Capture file: a header, then chunks aligned to 64 bytes, each with its type, size and XXH64.
+ * An info chunk (JSON) comes first, then one chunk per frame with the planes in the layout of the
+ * frame's PixelFormat, and on close an index of the frame chunks. A file cut short by a crash has
+ * no index but is still readable up to the last complete chunk.
+ *
+ * A recorder can be opened again after close(), each capture starts with fresh counters.
+ */
+class FrameRecorder {
+private:
+    struct Pending {
+        cv::Mat pixels;             /**< Continuous copy of the frame */
+        int format = PIXEL_BGR;
+        cv::Size size;
+        int rotation = 0;
+        int64_t id = 0;
+        int64_t timestamp_ns = 0;
+    };
+
+    FILE* file = nullptr;
+    int codec = CAPTURE_PACKED;
+    uint64_t max_bytes = 0;                 /**< Size limit of the frame chunks, 0 for none */
+    uint64_t offset = 0;                    /**< End of the file */
+    std::vector<uint64_t> frame_offsets;    /**< Chunk of every written frame */
+    std::vector<uint8_t> encoded;           /**< Buffer of the frame being written */
+    bool write_failed = false;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Pending> queue;
+    std::vector<cv::Mat> spare;             /**< Buffers of written frames, reused for new ones */
+    bool closing = false;
+    int64_t first_timestamp_ns = -1;
+    int64_t written = 0;
+    int64_t dropped = 0;
+    uint64_t raw_bytes = 0;                 /**< Size of the written frames uncompressed */
+    uint64_t file_bytes = 0;
+    bool full = false;                      /**< max_bytes reached, no more frames are recorded */
+    std::thread writer;
+
+    bool writeChunk(uint32_t type, const void* payload, size_t payload_size);
+    void writeFrame(const Pending& frame);
+    void run();
+
+public:
+    FrameRecorder() {}
+    ~FrameRecorder();
+
+    bool open(const std::string& path, const CaptureInfo& info, int codec = CAPTURE_PACKED, uint64_t max_bytes = 0);
+    bool add(const SourceImage& image, int rotation, int64_t id, int64_t timestamp_ns);
+    bool close();
+
+    int64_t framesWritten();
+    int64_t framesDropped();
+    uint64_t bytesWritten();
+    uint64_t rawBytes();
+    bool isFull();
+};
+
+
+/**
+ * Reads a capture file in place. The file is mapped; raw frames are wrapped without copying,
+ * packed ones are decoded into a buffer of the reader. A frame is valid until the next call of frame().
+ */
+class CaptureReader {
+private:
+    std::shared_ptr<const void> mapping;    /**< Keeps the mapped file alive */
+    const uint8_t* bytes = nullptr;
+    size_t size = 0;
+    CaptureInfo capture_info;
+    std::vector<uint64_t> frame_offsets;
+    bool indexed = false;                   /**< Index chunk present, the capture was closed cleanly */
+    cv::Mat decoded;
+
+public:
+    bool open(const std::string& path, std::string& error);
+
+    const CaptureInfo& info() const { return capture_info; }
+    size_t frameCount() const { return frame_offsets.size(); }
+    size_t fileSize() const { return size; }
+    bool isComplete() const { return indexed; }
+
+    bool frame(size_t index, CapturedFrame& frame, std::string& error);
+};
+
+
+#endif //FRAMECAPTURE_H
@@ -0,0 +1,273 @@
+#include "GrayResizeBlur.h"
+#include "Trace.h"
+
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include <opencv2/imgproc.hpp>
+
+// fixed-point constants of OpenCV's 8-bit cvtColor, resize and GaussianBlur
+static const int GRAY_SHIFT = 14;
+static const int GRAY_B = 1868, GRAY_G = 9617, GRAY_R = 4899;
+static const int RESIZE_COEF_BITS = 11;
+static const int RESIZE_COEF_SCALE = 1 << RESIZE_COEF_BITS;
+static const int BLUR_COEF_BITS = 8;            // kernel sums to 256
+static const int STRIPE_ROWS = 64;              // output rows per parallel task
+static const int MAX_BLUR_SIZE = 15;
+
+
+/**
+ * Source pixel positions and weights of bilinear resizing along one axis, as computed by cv::resize.
+ */
+struct LinearTable {
+    std::vector<int> ofs0, ofs1;        /**< First and second source index */
+    std::vector<int> coef0, coef1;      /**< Weights, sum RESIZE_COEF_SCALE */
+
+    LinearTable(int src_len, int dst_len) : ofs0(dst_len), ofs1(dst_len), coef0(dst_len), coef1(dst_len) {
+        double scale = 1. / (double(dst_len) / src_len);
+        for (int d = 0; d < dst_len; d++) {
+            float f = float((d + 0.5) * scale - 0.5);
+            int s = int(floorf(f));
+            f -= s;
+            if (s < 0) {
+                f = 0;
+                s = 0;
+            }
+            if (s >= src_len - 1) {
+                f = 0;
+                s = src_len - 1;
+            }
+            ofs0[d] = s;
+            ofs1[d] = std::min(s + 1, src_len - 1);
+            coef0[d] = cv::saturate_cast<short>((1.f - f) * RESIZE_COEF_SCALE);
+            coef1[d] = cv::saturate_cast<short>(f * RESIZE_COEF_SCALE);
+        }
+    }
+};
+
+
+/**
+ * Gaussian kernel in BLUR_COEF_BITS fixed point, OpenCV's exact small kernels for 3, 5 and 7.
+ */
+static std::vector<uint16_t> blurKernel(int size) {
+    if (size == 3) return {64, 128, 64};
+    if (size == 5) return {16, 64, 96, 64, 16};
+    if (size == 7) return {8, 28, 56, 72, 56, 28, 8};
+
+    // same sigma as GaussianBlur with sigma 0, the rounding error goes to the centre
+    double sigma = 0.3 * ((size - 1) * 0.5 - 1) + 0.8;
+    std::vector<double> weights(size);
+    double sum = 0;
+    for (int i = 0; i < size; i++) {
+        double x = i - (size - 1) * 0.5;
+        weights[i] = exp(-x * x / (2 * sigma * sigma));
+        sum += weights[i];
+    }
+    std::vector<uint16_t> kernel(size);
+    int total = 0;
+    for (int i = 0; i < size; i++) {
+        kernel[i] = uint16_t(lround(weights[i] / sum * (1 << BLUR_COEF_BITS)));
+        total += kernel[i];
+    }
+    kernel[size / 2] += (1 << BLUR_COEF_BITS) - total;
+    return kernel;
+}
+
+
+static inline int reflect101(int i, int len) {
+    if (i < 0) return -i;
+    if (i >= len) return 2 * len - 2 - i;
+    return i;
+}
+
+
+/**
+ * Horizontal bilinear pass over one source row. The row is converted to grey in a contiguous
+ * loop first, only the rows the interpolation reads are converted.
+ */
+template <int CN, int B, int R>
+static void resizeRow(const uint8_t* src, int src_cols, const LinearTable& xt, uint8_t* gray, int* out) {
+    if (CN == 1) {
+        gray = const_cast<uint8_t*>(src);
+    } else {
+        for (int x = 0; x < src_cols; x++) {
+            const uint8_t* p = src + x * CN;
+            gray[x] = uint8_t((p[B] * GRAY_B + p[1] * GRAY_G + p[R] * GRAY_R + (1 << (GRAY_SHIFT - 1))) >> GRAY_SHIFT);
+        }
+    }
+    const int width = int(xt.ofs0.size());
+    for (int x = 0; x < width; x++) {
+        out[x] = gray[xt.ofs0[x]] * xt.coef0[x] + gray[xt.ofs1[x]] * xt.coef1[x];
+    }
+}
+
+typedef void (*ResizeRowFunc)(const uint8_t*, int, const LinearTable&, uint8_t*, int*);
+
+
+/**
+ * Horizontal blur of a row padded by ksize / 2 on both sides, one contiguous pass per kernel tap.
+ * The sum fits 16 bits because the kernel sums to 256.
+ */
+template <int K>
+static void blurRow(const uint8_t* padded, const uint16_t* kernel, int ksize, uint16_t* out, int width) {
+    const int n = K > 0 ? K : ksize;
+    const uint16_t w0 = kernel[0];
+    for (int x = 0; x < width; x++) out[x] = uint16_t(w0 * padded[x]);
+    for (int k = 1; k < n; k++) {
+        const uint16_t w = kernel[k];
+        const uint8_t* p = padded + k;
+        for (int x = 0; x < width; x++) out[x] = uint16_t(out[x] + w * p[x]);
+    }
+}
+
+
+/**
+ * Vertical blur of ksize horizontally blurred rows, rounded like GaussianBlur's fixed-point path.
+ */
+template <int K>
+static void blurColumns(const uint16_t* const* rows, const uint16_t* kernel, int ksize, uint32_t* sum, uint8_t* out, int width) {
+    const int n = K > 0 ? K : ksize;
+    const uint32_t w0 = kernel[0];
+    const uint16_t* r0 = rows[0];
+    for (int x = 0; x < width; x++) sum[x] = (1u << (2 * BLUR_COEF_BITS - 1)) + w0 * r0[x];
+    for (int k = 1; k < n; k++) {
+        const uint32_t w = kernel[k];
+        const uint16_t* r = rows[k];
+        for (int x = 0; x < width; x++) sum[x] += w * r[x];
+    }
+    for (int x = 0; x < width; x++) out[x] = uint8_t(sum[x] >> (2 * BLUR_COEF_BITS));
+}
+
+typedef void (*BlurRowFunc)(const uint8_t*, const uint16_t*, int, uint16_t*, int);
+typedef void (*BlurColumnsFunc)(const uint16_t* const*, const uint16_t*, int, uint32_t*, uint8_t*, int);
+
+
+/**
+ * Kernels of one call, specialized for the source layout and the usual blur sizes so the inner loops unroll.
+ */
+struct FrontEnd {
+    LinearTable xt, yt;
+    std::vector<uint16_t> kernel;
+    ResizeRowFunc resize_row;
+    BlurRowFunc blur_row;
+    BlurColumnsFunc blur_columns;
+
+    FrontEnd(const cv::Mat& src, cv::Size dsize, int ksize, bool rgb_order)
+            : xt(src.cols, dsize.width), yt(src.rows, dsize.height),
+              kernel(ksize > 1 ? blurKernel(ksize) : std::vector<uint16_t>(1, 1 << BLUR_COEF_BITS)) {
+        if (src.channels() == 1) resize_row = resizeRow<1, 0, 0>;
+        else if (src.channels() == 3) resize_row = rgb_order ? resizeRow<3, 2, 0> : resizeRow<3, 0, 2>;
+        else resize_row = rgb_order ? resizeRow<4, 2, 0> : resizeRow<4, 0, 2>;
+
+        if (ksize == 3) blur_row = blurRow<3>, blur_columns = blurColumns<3>;
+        else if (ksize == 5) blur_row = blurRow<5>, blur_columns = blurColumns<5>;
+        else if (ksize == 7) blur_row = blurRow<7>, blur_columns = blurColumns<7>;
+        else blur_row = blurRow<0>, blur_columns = blurColumns<0>;
+    }
+};
+
+
+/**
+ * Produces output rows y0..y1 of one stripe. Resized rows flow through a ring of ksize
+ * horizontally blurred rows, so the stripe needs ksize / 2 rows of its neighbours and
+ * nothing at full resolution.
+ */
+static void processStripe(const cv::Mat& src, cv::Mat& dst, const FrontEnd& fe, int y0, int y1) {
+    const int width = dst.cols;
+    const int height = dst.rows;
+    const int ksize = int(fe.kernel.size());
+    const int radius = ksize / 2;
+    const LinearTable& yt = fe.yt;
+
+    // horizontally resized source rows, reused when two output rows interpolate from the same one
+    std::vector<int> hrows[2] = {std::vector<int>(width), std::vector<int>(width)};
+    int hrow_index[2] = {-1, -1};
+    std::vector<uint8_t> gray(src.cols);
+    std::vector<uint8_t> padded(width + 2 * radius);
+    std::vector<uint16_t> ring(size_t(ksize) * width);
+    std::vector<uint32_t> sum(width);
+    int produced = std::max(0, y0 - radius);
+
+    auto sourceRow = [&](int sy) -> const int* {
+        for (int i = 0; i < 2; i++) {
+            if (hrow_index[i] == sy) return hrows[i].data();
+        }
+        int slot = hrow_index[0] < hrow_index[1] ? 0 : 1;
+        fe.resize_row(src.ptr<uint8_t>(sy), src.cols, fe.xt, gray.data(), hrows[slot].data());
+        hrow_index[slot] = sy;
+        return hrows[slot].data();
+    };
+
+    for (int y = y0; y < y1; y++) {
+        int last = std::min(height - 1, y + radius);
+        for (; produced <= last; produced++) {
+            // vertical bilinear pass, rounded like OpenCV's SIMD path
+            const int* s0 = sourceRow(yt.ofs0[produced]);
+            const int* s1 = sourceRow(yt.ofs1[produced]);
+            const int b0 = yt.coef0[produced], b1 = yt.coef1[produced];
+            uint8_t* row = ksize > 1 ? padded.data() + radius : dst.ptr<uint8_t>(produced);
+            for (int x = 0; x < width; x++) {
+                int v = (((s0[x] >> 4) * b0) >> 16) + (((s1[x] >> 4) * b1) >> 16);
+                row[x] = cv::saturate_cast<uint8_t>((v + 2) >> 2);
+            }
+            if (ksize <= 1) continue;
+
+            // horizontal blur into the ring, borders reflected like BORDER_REFLECT_101
+            for (int i = 1; i <= radius; i++) {
+                row[-i] = row[i];
+                row[width - 1 + i] = row[width - 1 - i];
+            }
+            fe.blur_row(padded.data(), fe.kernel.data(), ksize, &ring[size_t(produced % ksize) * width], width);
+        }
+        if (ksize <= 1) continue;
+
+        // vertical blur
+        const uint16_t* rows[MAX_BLUR_SIZE];
+        for (int k = 0; k < ksize; k++) {
+            rows[k] = &ring[size_t(reflect101(y - radius + k, height) % ksize) * width];
+        }
+        fe.blur_columns(rows, fe.kernel.data(), ksize, sum.data(), dst.ptr<uint8_t>(y), width);
+    }
+}
+
+
+/**
+ * Card detection front end in one pass: grey conversion, bilinear resize and Gaussian blur.
+ * Equals cvtColor(BGR2GRAY) + resize(INTER_LINEAR) + GaussianBlur up to +-1, the fixed-point
+ * arithmetic is OpenCV's, but only the source rows the interpolation reads are converted and
+ * no full-resolution intermediate is written. The inner loops are plain, contiguous and unrolled
+ * for the usual kernel sizes, so the compiler vectorizes them for NEON, SSE or AVX2.
+ * @param src 8-bit BGR, BGRA or grey image, RGB or RGBA with rgb_order
+ * @param dst output CV_8U image, e.g. a ScratchPool view of dsize
+ * @param dsize working size
+ * @param blur_size odd Gaussian kernel size, 1 or less for none
+ * @param rgb_order true if the colour channels of src are in RGB order
+ */
+void grayResizeBlur(const cv::Mat& src, cv::Mat& dst, cv::Size dsize, int blur_size, bool rgb_order) {
+    TRACE_SPAN(span, "grayResizeBlur");
+    CV_Assert(src.depth() == CV_8U && (src.channels() == 1 || src.channels() == 3 || src.channels() == 4));
+    int ksize = blur_size > 1 ? blur_size : 1;
+
+    // the ring needs a few rows and columns to reflect into, and resize switches to INTER_AREA at exactly 1/2
+    bool half = src.cols == 2 * dsize.width && src.rows == 2 * dsize.height;
+    if (dsize.width <= ksize || dsize.height <= ksize || ksize > MAX_BLUR_SIZE || half) {
+        cv::Mat gray;
+        if (src.channels() == 1) gray = src;
+        else if (src.channels() == 3) cv::cvtColor(src, gray, rgb_order ? cv::COLOR_RGB2GRAY : cv::COLOR_BGR2GRAY);
+        else cv::cvtColor(src, gray, rgb_order ? cv::COLOR_RGBA2GRAY : cv::COLOR_BGRA2GRAY);
+        cv::resize(gray, dst, dsize, 0, 0, cv::INTER_LINEAR);
+        if (ksize > 1) cv::GaussianBlur(dst, dst, cv::Size(ksize, ksize), 0);
+        return;
+    }
+
+    dst.create(dsize, CV_8U);
+    FrontEnd fe(src, dsize, ksize, rgb_order);
+
+    int stripes = (dsize.height + STRIPE_ROWS - 1) / STRIPE_ROWS;
+    cv::parallel_for_(cv::Range(0, stripes), [&](const cv::Range& range) {
+        int y0 = range.start * STRIPE_ROWS;
+        int y1 = std::min(dsize.height, range.end * STRIPE_ROWS);
+        processStripe(src, dst, fe, y0, y1);
+    });
+}
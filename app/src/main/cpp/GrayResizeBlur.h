@@ -0,0 +1,15 @@
+#ifndef GRAYRESIZEBLUR_H
+#define GRAYRESIZEBLUR_H
+
+#include <stdio.h>
+#include <opencv2/core.hpp>
+
+
+/**
+ * Card detection front end: grey conversion, bilinear resize and Gaussian blur fused into one pass,
+ * matching cvtColor + resize + GaussianBlur up to +-1.
+ */
+void grayResizeBlur(const cv::Mat& src, cv::Mat& dst, cv::Size dsize, int blur_size, bool rgb_order = false);
+
+
+#endif //GRAYRESIZEBLUR_H
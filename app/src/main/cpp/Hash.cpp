@@ -0,0 +1,122 @@
+#include "Hash.h"
+
+#include <string.h>
+
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// unaligned little-endian reads, memcpy compiles to a single load
+static inline uint64_t read64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    acc = rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+static inline uint64_t mergeRound(uint64_t acc, uint64_t val) {
+    acc ^= round64(0, val);
+    return acc * PRIME1 + PRIME4;
+}
+
+
+/**
+ * XXH64 hash.
+ * @param data buffer
+ * @param length buffer length in bytes
+ * @param seed seed, different seeds give independent hashes
+ * @return hash
+ */
+uint64_t xxh64(const void* data, size_t length, uint64_t seed) {
+    const uint8_t* p = (const uint8_t*) data;
+    const uint8_t* end = p + length;
+    uint64_t h;
+
+    if (length >= 32) {
+        // four independent lanes of 8 bytes
+        const uint8_t* limit = end - 32;
+        uint64_t v1 = seed + PRIME1 + PRIME2;
+        uint64_t v2 = seed + PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME1;
+        do {
+            v1 = round64(v1, read64(p));
+            v2 = round64(v2, read64(p + 8));
+            v3 = round64(v3, read64(p + 16));
+            v4 = round64(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + PRIME5;
+    }
+
+    h += uint64_t(length);
+
+    while (p + 8 <= end) {
+        h ^= round64(0, read64(p));
+        h = rotl(h, 27) * PRIME1 + PRIME4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= uint64_t(read32(p)) * PRIME1;
+        h = rotl(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * PRIME5;
+        h = rotl(h, 11) * PRIME1;
+        p++;
+    }
+
+    // avalanche
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+
+/**
+ * Hash of image content, size and type. Row padding of non-continuous images is not hashed.
+ * @param image image
+ * @return hash
+ */
+uint64_t hashImage(const cv::Mat& image) {
+    uint64_t h = xxh64(nullptr, 0, (uint64_t(image.rows) << 40) ^ (uint64_t(image.cols) << 16) ^ uint64_t(image.type()));
+    if (image.empty()) return h;
+
+    if (image.isContinuous()) {
+        return xxh64(image.data, image.total() * image.elemSize(), h);
+    }
+    size_t row_bytes = image.cols * image.elemSize();
+    for (int r = 0; r < image.rows; r++) {
+        h = xxh64(image.ptr(r), row_bytes, h);
+    }
+    return h;
+}
@@ -0,0 +1,19 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <opencv2/core.hpp>
+
+
+/**
+ * XXH64 of a buffer, compatible with the reference xxHash implementation.
+ * Several GB/s, so hashing an image costs a small fraction of measuring it.
+ */
+uint64_t xxh64(const void* data, size_t length, uint64_t seed = 0);
+
+uint64_t hashImage(const cv::Mat& image);
+
+
+#endif //HASH_H
@@ -0,0 +1,184 @@
+#include "ImageDecode.h"
+#include "Trace.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <vector>
+#include <opencv2/imgcodecs.hpp>
+
+static const int DECODE_FACTORS[] = {8, 4, 2};   // scale denominators libjpeg decodes in the DCT domain
+static const size_t STREAM_READ_CHUNK = 256 * 1024;     // read size of descriptors without a file size, e.g. pipes
+
+
+static inline int readBigEndian16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+
+/**
+ * Read the image size from the JPEG frame header without decoding.
+ * @param data file content
+ * @param size file size
+ * @param image_size output
+ * @return false if the data is not a JPEG or the frame header is missing
+ */
+bool jpegSize(const uint8_t* data, size_t size, cv::Size& image_size) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) return false;
+
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) return false;
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {           // fill byte
+            pos++;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {     // no length field
+            pos += 2;
+            continue;
+        }
+        if (marker == 0xD9 || marker == 0xDA) return false;     // end of image or scan before a frame header
+
+        int length = readBigEndian16(data + pos + 2);
+        // SOF0-SOF15 except DHT, JPG and DAC: length, precision, height, width
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            if (pos + 9 > size) return false;
+            image_size = cv::Size(readBigEndian16(data + pos + 7), readBigEndian16(data + pos + 5));
+            return image_size.width > 0 && image_size.height > 0;
+        }
+        pos += 2 + length;
+    }
+    return false;
+}
+
+
+/**
+ * Largest DCT scale denominator that keeps the image at least as wide as required.
+ * @param image_size full size of the JPEG
+ * @param required_width width the pipeline works at, e.g. ResolutionScheduler::maxWorkingWidth
+ * @return 8, 4, 2 or 1
+ */
+int reducedDecodeFactor(cv::Size image_size, int required_width) {
+    for (int factor : DECODE_FACTORS) {
+        // libjpeg rounds the scaled size up
+        if ((image_size.width + factor - 1) / factor >= required_width) return factor;
+    }
+    return 1;
+}
+
+
+/**
+ * Size of a JPEG decoded to BGR at a DCT scale.
+ * @param image_size full size of the JPEG
+ * @param factor scale denominator
+ * @return bytes
+ */
+size_t reducedBytes(cv::Size image_size, int factor) {
+    // libjpeg rounds the scaled size up
+    return size_t((image_size.width + factor - 1) / factor) * size_t((image_size.height + factor - 1) / factor) * 3;
+}
+
+
+/**
+ * Decode an encoded image, JPEGs at the smallest scale that is still at least required_width wide.
+ * Other formats are decoded at full size.
+ * @param data encoded image
+ * @param size encoded size
+ * @param required_width minimal width of the result, 0 for full size
+ * @param factor output, scale denominator used
+ * @param max_bytes limit of the decoded BGR image, a smaller scale than required_width asks for is used to meet it. 0 for no limit
+ * @return BGR image, empty if decoding failed
+ */
+cv::Mat decodeReduced(const uint8_t* data, size_t size, int required_width, int& factor, size_t max_bytes) {
+    TRACE_SPAN(span, "decodeReduced");
+    factor = 1;
+    cv::Size image_size;
+    if ((required_width > 0 || max_bytes > 0) && jpegSize(data, size, image_size)) {
+        factor = required_width > 0 ? reducedDecodeFactor(image_size, required_width) : 1;
+        // libjpeg decodes band by band, only the scaled image is ever allocated in full
+        while (max_bytes > 0 && factor < 8 && reducedBytes(image_size, factor) > max_bytes) factor *= 2;
+    }
+
+    int flags = cv::IMREAD_COLOR;
+    if (factor == 2) flags = cv::IMREAD_REDUCED_COLOR_2;
+    else if (factor == 4) flags = cv::IMREAD_REDUCED_COLOR_4;
+    else if (factor == 8) flags = cv::IMREAD_REDUCED_COLOR_8;
+    TRACE_COUNTER(span, "factor", factor);
+
+    cv::Mat buffer(1, int(size), CV_8U, const_cast<uint8_t*>(data));
+    return cv::imdecode(buffer, flags | cv::IMREAD_IGNORE_ORIENTATION);
+}
+
+
+/**
+ * Read a descriptor without a known size (pipe, socket, or a provider streaming the content) to its end.
+ * @param fd descriptor, read from its current position
+ * @param data output
+ * @return false on a read error
+ */
+static bool readStream(int fd, std::vector<uint8_t>& data) {
+    size_t done = 0;
+    while (true) {
+        data.resize(done + STREAM_READ_CHUNK);
+        ssize_t n = read(fd, data.data() + done, STREAM_READ_CHUNK);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        if (n == 0) break;
+        done += size_t(n);
+    }
+    data.resize(done);
+    return true;
+}
+
+
+/**
+ * Decode an image file from a descriptor, see decodeReduced. A regular file is mapped, not copied,
+ * anything else (e.g. a pipe from a content provider) is read into memory first.
+ * The descriptor stays open and owned by the caller.
+ * @param fd descriptor, a regular file is read from its start, a stream from its current position
+ * @param required_width minimal width of the result, 0 for full size
+ * @param factor output, scale denominator used
+ * @param max_bytes limit of the decoded BGR image, 0 for no limit
+ * @return BGR image, empty if reading or decoding failed
+ */
+cv::Mat decodeFileDescriptor(int fd, int required_width, int& factor, size_t max_bytes) {
+    factor = 1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        std::cerr << "Error: Unable to stat image file descriptor" << std::endl;
+        return cv::Mat();
+    }
+    if (!S_ISREG(st.st_mode) || st.st_size <= 0) {
+        std::vector<uint8_t> data;
+        if (!readStream(fd, data) || data.empty()) {
+            std::cerr << "Error: Unable to read image stream" << std::endl;
+            return cv::Mat();
+        }
+        return decodeReduced(data.data(), data.size(), required_width, factor, max_bytes);
+    }
+    size_t size = size_t(st.st_size);
+
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED) {
+        cv::Mat image = decodeReduced((const uint8_t*) mapped, size, required_width, factor, max_bytes);
+        munmap(mapped, size);
+        return image;
+    }
+
+    // not mappable, read it; the encoded file is small next to the decoded image
+    std::vector<uint8_t> data(size);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, data.data() + done, size - done, off_t(done));
+        if (n <= 0) break;
+        done += size_t(n);
+    }
+    if (done != size) {
+        std::cerr << "Error: Unable to read image file descriptor" << std::endl;
+        return cv::Mat();
+    }
+    return decodeReduced(data.data(), size, required_width, factor, max_bytes);
+}
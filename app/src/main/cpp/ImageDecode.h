@@ -0,0 +1,27 @@
+#ifndef IMAGEDECODE_H
+#define IMAGEDECODE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <opencv2/core.hpp>
+
+
+/**
+ * Decoding of captured photos straight to the working resolution.
+ * JPEGs are scaled by 1/2, 1/4 or 1/8 in the DCT domain while decoding, so a 12-48 MP photo
+ * never exists at full size in memory. EXIF orientation is ignored, like BitmapFactory does.
+ */
+
+bool jpegSize(const uint8_t* data, size_t size, cv::Size& image_size);
+
+int reducedDecodeFactor(cv::Size image_size, int required_width);
+
+size_t reducedBytes(cv::Size image_size, int factor);
+
+cv::Mat decodeReduced(const uint8_t* data, size_t size, int required_width, int& factor, size_t max_bytes = 0);
+
+cv::Mat decodeFileDescriptor(int fd, int required_width, int& factor, size_t max_bytes = 0);
+
+
+#endif //IMAGEDECODE_H
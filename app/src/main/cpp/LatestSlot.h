@@ -0,0 +1,80 @@
+#ifndef LATESTSLOT_H
+#define LATESTSLOT_H
+
+#include <stdio.h>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+
+
+/**
+ * Single-slot queue where the latest value wins. A value put while another one is pending replaces it,
+ * so the consumer always gets the newest value and never works through a backlog.
+ * Values are exchanged with swap, the caller gets the replaced (or previously taken) value back
+ * and can reuse its buffers.
+ */
+template <typename T>
+class LatestSlot {
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    T value;
+    bool pending = false;
+    bool closed = false;
+
+public:
+    /**
+     * Put a value into the slot.
+     * @param in value to put, on return holds the replaced pending value or a spare one
+     * @return true if a pending value was replaced (dropped)
+     */
+    bool put(T& in) {
+        bool dropped;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (closed) return false;
+            std::swap(value, in);
+            dropped = pending;
+            pending = true;
+        }
+        ready.notify_one();
+        return dropped;
+    }
+
+    /**
+     * Wait for a pending value and take it.
+     * @param out receives the value, its previous content is left in the slot for reuse
+     * @return false if the slot was closed
+     */
+    bool take(T& out) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return pending || closed; });
+        if (closed) return false;
+        std::swap(value, out);
+        pending = false;
+        return true;
+    }
+
+    /**
+     * Wake up the consumer and reject further values.
+     */
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        ready.notify_all();
+    }
+
+    /**
+     * Open the slot again, a pending value is discarded.
+     */
+    void reopen() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = false;
+        pending = false;
+    }
+};
+
+
+#endif //LATESTSLOT_H
@@ -0,0 +1,174 @@
+#include "LiveMeasurement.h"
+#include "ObjectDetector.h"
+#include "Trace.h"
+
+#include <string.h>
+
+static const double FPS_SMOOTHING = 0.2;    // weight of the newest frame interval
+
+
+/**
+ * Constructor. The worker is started with start().
+ * @param card_model card template features
+ * @param config detector parameters
+ * @param deadline_ms time budget of one frame, 0 for none
+ */
+LiveMeasurement::LiveMeasurement(std::shared_ptr<const CardModel> card_model, const DetectorConfig& config, double deadline_ms)
+        : card_model(card_model), config(config), deadline_ms(deadline_ms), running(false), dropped(0) {
+}
+
+LiveMeasurement::~LiveMeasurement() {
+    stop();
+}
+
+
+/**
+ * Start the worker thread.
+ */
+void LiveMeasurement::start() {
+    if (running.exchange(true)) return;
+    slot.reopen();
+    {
+        std::lock_guard<std::mutex> lock(overlay_mutex);
+        overlay = LiveOverlay();
+    }
+    dropped = 0;
+    worker = std::thread(&LiveMeasurement::run, this);
+}
+
+
+/**
+ * Stop the worker thread. The frame being processed is finished, a pending one is discarded.
+ */
+void LiveMeasurement::stop() {
+    if (!running.exchange(false)) return;
+    slot.close();
+    if (worker.joinable()) worker.join();
+}
+
+
+/**
+ * Copy a YUV_420_888 camera frame and hand it to the worker. Never blocks on the measurement,
+ * a frame which is still pending is replaced and counted as dropped.
+ * @param y luma plane
+ * @param y_row_stride bytes per luma row
+ * @param u chroma U plane
+ * @param v chroma V plane
+ * @param uv_row_stride bytes per chroma row
+ * @param uv_pixel_stride bytes between chroma samples (1 planar, 2 interleaved)
+ * @param width frame width
+ * @param height frame height
+ * @param rotation clockwise rotation to upright
+ * @return false if the worker is not running
+ */
+bool LiveMeasurement::submitYuv420(const uint8_t* y, int y_row_stride, const uint8_t* u, const uint8_t* v,
+                                   int uv_row_stride, int uv_pixel_stride, int width, int height, int rotation) {
+    if (!running) return false;
+    std::lock_guard<std::mutex> lock(submit_mutex);
+
+    // pack into I420, the buffer is reused once it went through the slot
+    spare.yuv.create(height * 3 / 2, width, CV_8U);
+    uint8_t* dst = spare.yuv.data;
+    for (int r = 0; r < height; r++) {
+        memcpy(dst + r * width, y + r * y_row_stride, width);
+    }
+    int cw = width / 2, ch = height / 2;
+    uint8_t* dst_u = dst + width * height;
+    uint8_t* dst_v = dst_u + cw * ch;
+    for (int r = 0; r < ch; r++) {
+        const uint8_t* src_u = u + r * uv_row_stride;
+        const uint8_t* src_v = v + r * uv_row_stride;
+        if (uv_pixel_stride == 1) {
+            memcpy(dst_u + r * cw, src_u, cw);
+            memcpy(dst_v + r * cw, src_v, cw);
+        } else {
+            for (int c = 0; c < cw; c++) {
+                dst_u[r * cw + c] = src_u[c * uv_pixel_stride];
+                dst_v[r * cw + c] = src_v[c * uv_pixel_stride];
+            }
+        }
+    }
+    spare.rotation = rotation;
+    spare.id = next_id++;
+    spare.arrival_ns = int64_t(trace::nowNs());
+    // every submitted frame is recorded, also the ones the worker will not get to
+    if (recorder) recorder->add(SourceImage::wrap(spare.yuv, PIXEL_I420), rotation, spare.id, spare.arrival_ns);
+
+    if (slot.put(spare)) dropped++;
+    return true;
+}
+
+
+/**
+ * Record the submitted frames, or stop recording them.
+ * @param recorder open recorder, null to stop
+ */
+void LiveMeasurement::setRecorder(std::shared_ptr<FrameRecorder> recorder) {
+    std::lock_guard<std::mutex> lock(submit_mutex);
+    this->recorder = recorder;
+}
+
+
+/**
+ * Overlay of the last processed frame.
+ * @return copy of the overlay, frame_id is -1 before the first frame
+ */
+LiveOverlay LiveMeasurement::latestOverlay() {
+    std::lock_guard<std::mutex> lock(overlay_mutex);
+    LiveOverlay copy = overlay;
+    copy.dropped = dropped;
+    return copy;
+}
+
+
+/**
+ * Worker loop. Takes the newest frame, rotates it upright and measures it in I420 within the deadline.
+ */
+void LiveMeasurement::run() {
+    ObjectDetector detector(card_model, config);
+    TreeTracker tracker;
+    MeasureOptions options;
+    options.deadline_ms = deadline_ms;
+    options.tracker = &tracker;
+
+    Frame frame;
+    cv::Mat rotated;
+    int64_t last_done_ns = 0;
+    double fps = 0;
+    int64_t processed = 0;
+
+    while (slot.take(frame)) {
+        TRACE_SPAN(span, "liveFrame");
+        // the stages read the YUV planes directly, only the working images are converted to grey and BGR
+        SourceImage source = SourceImage::wrap(frame.yuv, PIXEL_I420).rotated(frame.rotation, rotated);
+
+        MeasureResult result;
+        detector.measureTree(source, options, result);
+
+        int64_t done_ns = int64_t(trace::nowNs());
+        if (last_done_ns > 0) {
+            double current = 1e9 / double(done_ns - last_done_ns);
+            fps = fps > 0 ? (1 - FPS_SMOOTHING) * fps + FPS_SMOOTHING * current : current;
+        }
+        last_done_ns = done_ns;
+        processed++;
+        TRACE_COUNTER(span, "degradations", result.degradations);
+        TRACE_COUNTER(span, "tree_tracked", result.tree_tracked);
+
+        std::lock_guard<std::mutex> lock(overlay_mutex);
+        overlay.frame_id = frame.id;
+        overlay.code = result.code;
+        overlay.width = source.cols();
+        overlay.height = source.rows();
+        // the card is known even when the tree was not found
+        for (int i = 0; i < 4; i++) {
+            overlay.card[i] = result.card.size() == 4 ? result.card[i] : cv::Point2f();
+            overlay.tree[i] = result.tree.size() == 4 ? result.tree[i] : cv::Point2f();
+        }
+        overlay.diameter = result.diameter;
+        overlay.degradations = result.degradations;
+        overlay.latency_ms = (done_ns - frame.arrival_ns) / 1e6;
+        overlay.fps = fps;
+        overlay.processed = processed;
+    }
+}
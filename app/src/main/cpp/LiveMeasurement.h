@@ -0,0 +1,87 @@
+#ifndef LIVEMEASUREMENT_H
+#define LIVEMEASUREMENT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <opencv2/core.hpp>
+
+#include "CardModel.h"
+#include "DetectorConfig.h"
+#include "FrameCapture.h"
+#include "LatestSlot.h"
+
+
+/**
+ * Geometry and statistics of the last processed live frame.
+ * Coordinates are in the upright frame (after rotation), width x height.
+ */
+struct LiveOverlay {
+    int64_t frame_id = -1;          /**< Id of the processed frame, -1 before the first one */
+    int code = -1;                  /**< measureTree error code */
+    int width = 0;
+    int height = 0;
+    cv::Point2f card[4];            /**< Card quad, valid if code is 0 or > 1 */
+    cv::Point2f tree[4];            /**< Left and right trunk line, top points first, valid if code is 0 */
+    double diameter = 0;            /**< Provisional diameter in mm, valid if code is 0 */
+    int degradations = 0;           /**< Degradation flags applied to meet the frame deadline */
+    double latency_ms = 0;          /**< From frame arrival to this overlay */
+    double fps = 0;                 /**< Processed frames per second, smoothed */
+    int64_t processed = 0;          /**< Frames processed since start */
+    int64_t dropped = 0;            /**< Frames replaced by a newer one before processing */
+};
+
+
+/**
+ * Live measurement on camera frames. Frames are handed over through a single-slot latest-frame-wins
+ * queue to one worker thread, so a slow device processes fewer frames but the latency from a frame
+ * to its overlay stays at one measurement.
+ */
+class LiveMeasurement {
+private:
+    /**
+     * Frame copied out of the camera buffer.
+     */
+    struct Frame {
+        cv::Mat yuv;                /**< I420, height * 3 / 2 rows */
+        int rotation = 0;           /**< Clockwise rotation to upright, 0, 90, 180 or 270 */
+        int64_t id = 0;
+        int64_t arrival_ns = 0;
+    };
+
+    std::shared_ptr<const CardModel> card_model;
+    DetectorConfig config;
+    double deadline_ms = 0;
+
+    LatestSlot<Frame> slot;
+    Frame spare;                    /**< Buffer the next frame is copied into */
+    std::mutex submit_mutex;
+    std::shared_ptr<FrameRecorder> recorder;    /**< Records the submitted frames, may be null */
+    std::thread worker;
+    std::atomic<bool> running;
+    int64_t next_id = 0;
+    std::atomic<int64_t> dropped;
+
+    std::mutex overlay_mutex;
+    LiveOverlay overlay;
+
+    void run();
+
+public:
+    LiveMeasurement(std::shared_ptr<const CardModel> card_model, const DetectorConfig& config, double deadline_ms);
+    ~LiveMeasurement();
+
+    void start();
+    void stop();
+    bool submitYuv420(const uint8_t* y, int y_row_stride, const uint8_t* u, const uint8_t* v,
+                      int uv_row_stride, int uv_pixel_stride, int width, int height, int rotation);
+    void setRecorder(std::shared_ptr<FrameRecorder> recorder);
+    LiveOverlay latestOverlay();
+    double deadlineMs() const { return deadline_ms; }
+};
+
+
+#endif //LIVEMEASUREMENT_H
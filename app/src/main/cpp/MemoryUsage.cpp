@@ -0,0 +1,51 @@
+#include "MemoryUsage.h"
+
+#include <string.h>
+#include <fstream>
+#include <string>
+
+
+/**
+ * Read a "kB" field of /proc/self/status.
+ * @param field name with the colon, e.g. "VmRSS:"
+ * @return bytes, 0 if not found
+ */
+static size_t statusField(const char* field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    size_t length = strlen(field);
+    while (std::getline(status, line)) {
+        if (line.compare(0, length, field) == 0) {
+            return size_t(std::stoull(line.substr(length))) * 1024;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * @return current resident set size in bytes
+ */
+size_t residentBytes() {
+    return statusField("VmRSS:");
+}
+
+
+/**
+ * @return highest resident set size since process start or the last resetPeakResident, in bytes
+ */
+size_t peakResidentBytes() {
+    return statusField("VmHWM:");
+}
+
+
+/**
+ * Restart peak tracking at the current resident size, so the peak of a single call can be measured.
+ * @return false if the kernel does not support it, peakResidentBytes then keeps the process peak
+ */
+bool resetPeakResident() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+    clear_refs.flush();
+    return bool(clear_refs);
+}
@@ -0,0 +1,20 @@
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+
+/**
+ * Resident memory of the process from /proc/self/status (Linux and Android).
+ * All functions return 0 or false where /proc is not available.
+ */
+
+size_t residentBytes();
+
+size_t peakResidentBytes();
+
+bool resetPeakResident();
+
+
+#endif //MEMORYUSAGE_H
@@ -3,86 +3,240 @@
 #include "CardDetection.h"
 #include "TreeDetection.h"
 #include "TreeDiameter.h"
-#include <android/log.h>
+#include "Trace.h"
+#include "ScratchPool.h"
+#include "DebugCapture.h"
+#include "AndroidLog.h"
+
+#include <chrono>
+#include <math.h>
 
 using namespace std;
 
 //temporary
 //std::string path_to_card = "../images/karta2.png";
 
-int ObjectDetector::measureTree (cv::Mat input_image, double &diameter) {
-    this->TreeInputImage = input_image;
-    int ret_value = 0;
+int ObjectDetector::measureTree (const SourceImage& input_image, double &diameter) const {
+    std::vector<cv::Point2f> card, tree;
+    return measureTree(input_image, card, tree, diameter);
+}
 
-    // detect all
-    ret_value = detectCard();
+int ObjectDetector::measureTree (const SourceImage& input_image, std::vector<cv::Point2f> &card, std::vector<cv::Point2f> &tree, double &diameter) const {
+    MeasureResult result;
+    int ret_value = measureTree(input_image, MeasureOptions(), result);
     if (ret_value > 0) return ret_value;
 
-    ret_value = detectTree();
+    //return vals
+    card = result.card;
+    tree = result.tree;
+    diameter = result.diameter;
+
+    return 0;
+}
+
+/**
+ * Measure tree diameter within a time budget.
+ * When the stage time model of the scheduler predicts an overrun, cheaper variants are used,
+ * they are reported in result.degradations.
+ * Safe to call from several threads at once.
+ * @param input_image image with tree and card, any PixelFormat; cv::Mat converts implicitly
+ * @param options deadline of the call
+ * @param result detected geometry, diameter and applied degradations
+ * @return error code, see measureTree
+ */
+int ObjectDetector::measureTree (const SourceImage& input_image, const MeasureOptions& options, MeasureResult& result) const {
+    TRACE_SPAN(span, "measureTree");
+    TRACE_COUNTER(span, "input_width", input_image.cols());
+    TRACE_COUNTER(span, "input_height", input_image.rows());
+    TRACE_COUNTER(span, "pixel_format", input_image.format());
+    MeasureContext context;
+    context.input = input_image;
+    context.options = options;
+    context.start = std::chrono::steady_clock::now();
+    if (capture::isEnabled()) capture::beginFrame();
+
+    // reallocations of the pool's image slots, 0 once the pool is warmed up for this input size;
+    // allocations inside OpenCV are not counted
+    ScratchPool& pool = ScratchPool::local();
+    size_t pool_allocations = pool.allocations();
+
+    int ret_value = measure(context);
+    TRACE_COUNTER(span, "pool_reallocations", pool.allocations() - pool_allocations);
+    TRACE_COUNTER(span, "pool_bytes", pool.bytes());
+    TRACE_COUNTER(span, "card_width", context.frame_config.card_resize_width);
+    TRACE_COUNTER(span, "tree_width", context.frame_config.tree_resize_width);
+    TRACE_COUNTER(span, "degradations", context.degradations);
+
+    result.code = ret_value;
+    result.degradations = context.degradations;
+    result.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - context.start).count();
+    // the card is known even when the tree was not found
+    if (ret_value != 1) result.card = std::move(context.card_polygon);
     if (ret_value > 0) return ret_value;
 
-    //measure
-    computeDiameter();
     //return vals
-    diameter = this->diameter_value;
+    result.tree = std::move(context.tree_polygon);
+    result.tree_tracked = context.tree_tracked;
+    result.diameter = context.diameter;
 
     return 0;
 }
 
-int ObjectDetector::measureTree (cv::Mat input_image, std::vector<cv::Point2f> &card, std::vector<cv::Point2f> &tree, double &diameter) {
-    this->TreeInputImage = input_image;
+/**
+ * Time left until the deadline of the call.
+ * @return milliseconds, infinity if the call has no deadline
+ */
+double MeasureContext::remainingMs() const {
+    if (options.deadline_ms <= 0) return INFINITY;
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return options.deadline_ms - elapsed;
+}
+
+int ObjectDetector::measure(MeasureContext& context) const {
     int ret_value = 0;
+    const DetectorConfig& config = *this->config;
+    DetectorConfig& frame_config = context.frame_config;
+
+    // working resolution for this frame, Hough votes scale with the image width
+    ResolutionPlan frame_plan = scheduler.plan(context.input.size(), config);
+    frame_config = config;
+    frame_config.card_resize_width = frame_plan.card_width;
+    frame_config.tree_resize_width = frame_plan.tree_width;
+    frame_config.hough_threshold = std::max(10, int(round(
+            double(config.hough_threshold) * frame_plan.tree_width / config.tree_resize_width)));
+    context.degradations = DEGRADE_NONE;
+    cv::Size size = context.input.size();
+
+    // SIFT and grabcut memory grows with the working resolution
+    if (context.options.memory_budget_bytes != NO_MEMORY_BUDGET) {
+        context.degradations |= ResolutionScheduler::fitMemory(size, context.options.memory_budget_bytes, frame_config);
+    }
+
+    // with a deadline, card detection gets its share of the predicted time of both stages
+    double remaining = context.remainingMs();
+    if (remaining < INFINITY) {
+        double card_ms = scheduler.predictCardMs(size, frame_config);
+        double tree_ms = scheduler.predictTreeMs(size, frame_config);
+        if (card_ms + tree_ms > remaining) {
+            context.degradations |= scheduler.fitCard(size, remaining * card_ms / (card_ms + tree_ms), frame_config);
+        }
+    }
 
     // detect all
-    ret_value = detectCard();
-    if (ret_value > 0) return ret_value;
+    auto start = std::chrono::steady_clock::now();
+    ret_value = detectCard(context);
+    auto card_end = std::chrono::steady_clock::now();
+    double card_ms = std::chrono::duration<double, std::milli>(card_end - start).count();
+    TreeTracker* tracker = context.options.tracker;
+    if (ret_value > 0) {
+        scheduler.update(size, frame_config, context.card_polygon, card_ms, 0);
+        if (tracker) tracker->clear();
+        return ret_value;
+    }
+
+    // a tracked stream moves the last trunk edges with the card and skips segmentation
+    if (tracker && tracker->track(context.input, context.card_polygon, frame_config, context.tree_polygon)) {
+        context.tree_tracked = true;
+        scheduler.update(size, frame_config, context.card_polygon, card_ms, 0);
+        if (computeDiameter(context) < 0) return 3;
+        return 0;
+    }
+
+    // tree detection gets whatever is left
+    remaining = context.remainingMs();
+    if (remaining < INFINITY) {
+        context.degradations |= scheduler.fitTree(size, remaining, frame_config);
+    }
 
-    ret_value = detectTree();
+    int attempts = 0;
+    ret_value = detectTree(context, attempts);
+    double tree_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - card_end).count();
+    scheduler.update(size, frame_config, context.card_polygon, card_ms, tree_ms / std::max(attempts, 1));
+    if (tracker) {
+        // the last attempt searched above (1) or under (2) the card
+        if (ret_value > 0) tracker->clear();
+        else tracker->restart(context.input, context.card_polygon, context.tree_polygon, attempts, frame_config);
+    }
     if (ret_value > 0) return ret_value;
 
     //measure
-    computeDiameter();
-    //return vals
-    card = this->card_polygon;
-    tree = this->tree_polygon;
-    diameter = this->diameter_value;
+    if (computeDiameter(context) < 0) return 3;
 
     return 0;
 }
 
 
 ObjectDetector::ObjectDetector () {//prázdný kontrsuktor
+    config = std::make_shared<const DetectorConfig>();
 }
 
-ObjectDetector::ObjectDetector (cv::Mat chosen_card_image) {//constructor with card file
-    this->CardInputImage = chosen_card_image;
+ObjectDetector::ObjectDetector (const cv::Mat& chosen_card_image, const DetectorConfig& config) {//constructor with card file
+    this->config = std::make_shared<const DetectorConfig>(config);
+    card_model = CardModel::build(chosen_card_image, config.card_template_blur);
 }
 
-ObjectDetector::ObjectDetector (string path_to_card) {//constructor with card file
-    CardInputImage = cv::imread(path_to_card);
-    if (!CardInputImage.data) {
+ObjectDetector::ObjectDetector (const string& path_to_card, const DetectorConfig& config) {//constructor with card file
+    this->config = std::make_shared<const DetectorConfig>(config);
+    cv::Mat card_image = cv::imread(path_to_card);
+    if (!card_image.data) {
         std::cerr << "Error: Unable to read card image file" << std::endl;
         __android_log_print(ANDROID_LOG_ERROR, "STORMY", "Error: Unable to read card image file");
     }
+    card_model = CardModel::build(card_image, config.card_template_blur);
 }
 
+ObjectDetector::ObjectDetector (std::shared_ptr<const CardModel> model, const DetectorConfig& config) {//constructor with prebuilt card features
+    this->config = std::make_shared<const DetectorConfig>(config);
+    card_model = model;
+}
+
+ObjectDetector::ObjectDetector (std::shared_ptr<const CardModel> model, std::shared_ptr<const DetectorConfig> config) {//constructor with shared model and config
+    this->config = config ? config : std::make_shared<const DetectorConfig>();
+    card_model = model;
+}
+
+
+/**
+ * Forget what the resolution scheduler learned from earlier measurements, e.g. before an unrelated image.
+ * Safe while measureTree runs, a concurrent update may survive the reset.
+ */
+void ObjectDetector::resetScheduler() {
+    scheduler.reset();
+}
+
+
+/**
+ * Replace the config. The card model keeps the template blur it was built with.
+ * Must not run concurrently with measureTree.
+ * @param config new config
+ */
+void ObjectDetector::setConfig(const DetectorConfig& config) {
+    this->config = std::make_shared<const DetectorConfig>(config);
+    scheduler.reset();
+    if (card_model && card_model->templateBlur() != config.card_template_blur) {
+        std::clog << "ObjectDetector: card model built with template blur " << card_model->templateBlur()
+                  << ", config asks for " << config.card_template_blur << std::endl;
+    }
+}
 
 
-int ObjectDetector::detectCard(){
+
+int ObjectDetector::detectCard(MeasureContext& context) const {
+    TRACE_SPAN(span, "detectCard");
     // Load ID card from image, later SIFT
-    //image is in CardInputImage
-    if (!CardInputImage.data) {
+    //features are in card_model
+    if (!card_model) {
         std::cerr << "Error: Unable to read card image file" << std::endl;
         __android_log_print(ANDROID_LOG_ERROR, "STORMY", "Error: Unable to read card image file");
         return 1;
     }
 
-    CardDetection cardDet = CardDetection(TreeInputImage, CardInputImage);
-    card_polygon = cardDet.getPoints();
+    CardDetection cardDet = CardDetection(context.input, *card_model, context.frame_config);
+    context.card_polygon = cardDet.getPoints();
 
     //float confidence = cardDet.getConfidenceScore();
     //cout << "Confidence score: " << confidence << endl;
-    if (card_polygon.empty()) {
+    if (context.card_polygon.empty()) {
         std::clog << "Card was not found." << std::endl;
         __android_log_print(ANDROID_LOG_ERROR, "STORMY", "Card was not found.");
         return 1;
@@ -91,71 +245,46 @@ int ObjectDetector::detectCard(){
 }
 
 
-int ObjectDetector::detectTree(){
+int ObjectDetector::detectTree(MeasureContext& context, int &attempts) const {
+    TRACE_SPAN(span, "detectTree");
 
-    TreeDetection tree = TreeDetection(TreeInputImage, card_polygon);
+    auto start = std::chrono::steady_clock::now();
+    TreeDetection tree = TreeDetection(context.input, context.card_polygon, context.frame_config);
     int ret = tree.findTree(1);
+    attempts = 1;
     if (ret < 0) {
+        // the retry takes about as long as the first attempt, skip it if that would miss the deadline
+        double attempt_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (attempt_ms > context.remainingMs()) {
+            context.degradations |= DEGRADE_SKIP_RETRY;
+            std::clog << "Tree was not found. No time for another try" << std::endl;
+            __android_log_print(ANDROID_LOG_ERROR, "STORMY", "Tree was not found. No time for another try");
+            return 2;
+        }
         std::clog << "Tree was not found. Another try" << std::endl;
         __android_log_print(ANDROID_LOG_ERROR, "STORMY", "Tree was not found. Another try");
+        attempts = 2;
         ret = tree.findTree(2);
-        if (ret < 0) {
+            if (ret < 0) {
             std::clog << "Tree was not found." << std::endl;
             __android_log_print(ANDROID_LOG_ERROR, "STORMY", "Tree was not found.");
             return 2;
         }
     }
-    tree_polygon = tree.getTreeLines();
+    context.tree_polygon = tree.getTreeLines();
 
     return 0;
 }
 
 
-int ObjectDetector::computeDiameter(){
-    if (this->card_polygon.empty() || this->tree_polygon.empty()){
+int ObjectDetector::computeDiameter(MeasureContext& context) const {
+    TRACE_SPAN(span, "computeDiameter");
+    if (context.card_polygon.empty() || context.tree_polygon.empty()){
         std::cerr << "Error: Empty card or tree points" << std::endl;
         __android_log_print(ANDROID_LOG_ERROR, "STORMY", "Error: Empty card or tree points");
         return (-1);
     }
     //measure
-    float tree_width_in_pixels = getTreeWidth(this->tree_polygon, this->card_polygon);
-    float card_width_in_pixels = distBetweenPoints(this->card_polygon[0], this->card_polygon[1]);
-    this->diameter_value = float((tree_width_in_pixels / card_width_in_pixels * 85.6));
+    context.diameter = treeDiameterMm(context.tree_polygon, context.card_polygon);
     return 0;
 }
-
-
-// ./treeProject path/to/image
-
-int main(int argc, char const* argv[]){
-
-    std::string path_to_tree;
-
-    // parse args
-    if (argc == 2){
-        path_to_tree = argv[1];
-    }else{
-        std::cerr << "Set path to image (./treeProject path/to/image)" << std::endl;
-        return -1;
-    }
-
-    // Load Image of tree
-    //std::clog << "Filename: " + path_to_tree << std::endl;
-    cv::Mat input_image = cv::imread(path_to_tree);
-    if (!input_image.data) {
-        std::cerr << "Error: Unable to read tree image file" << std::endl;
-        __android_log_print(ANDROID_LOG_ERROR, "STORMY", "Error: Unable to read tree image file");
-        return -1;
-    }
-
-    //ObjectDetector detector; // detect all
-    ObjectDetector detector;
-    std::vector<cv::Point2f> card_polygon, tree_polygon;
-    double diameter_value = 0.0;
-    cout << "ObjectDetector::measureTree() returned code: " << detector.measureTree(input_image, card_polygon, tree_polygon, diameter_value) << endl;
-    cout << "Diameter: " << diameter_value << endl;
-
-    __android_log_print(ANDROID_LOG_DEBUG, "STORMY", "Diameter= %d",diameter_value);
-
-    return 0;
-}
\ No newline at end of file
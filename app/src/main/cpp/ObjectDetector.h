@@ -1,44 +1,102 @@
 //treeo project class structure
+#ifndef OBJECTDETECTOR_H
+#define OBJECTDETECTOR_H
+
 #include <iostream>
+#include <chrono>
+#include <memory>
 #include <string>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
+#include "CardModel.h"
+#include "DetectorConfig.h"
+#include "ResolutionScheduler.h"
+#include "SourceImage.h"
+#include "TreeTracker.h"
 
 using namespace std;
 
-class ObjectDetector {
-private:
-    cv::Mat TreeInputImage;
-    cv::Mat CardInputImage;
 
-    //pair<int, int>* card_polygon; //nebo std::vector<cv::Point2f>
+static const size_t NO_MEMORY_BUDGET = 0;      // MeasureOptions::memory_budget_bytes without a limit
+static const size_t MIN_MEMORY_BUDGET = 1;     // smallest budget, always runs at the minimal widths with ORB
+
+
+/**
+ * Per-call options of measureTree.
+ */
+struct MeasureOptions {
+    double deadline_ms = 0;     /**< Time budget of the call, cheaper variants are used to meet it. 0 for no deadline */
+    size_t memory_budget_bytes = NO_MEMORY_BUDGET;  /**< Working memory of the call without the input image, lower resolutions are used to meet it */
+    TreeTracker* tracker = nullptr; /**< Trunk edges of the previous frame of a stream, tracked instead of segmenting when possible. Owned by the caller */
+};
+
+
+/**
+ * Output of measureTree.
+ */
+struct MeasureResult {
+    int code = 0;                       /**< Same error codes as measureTree returns */
+    std::vector<cv::Point2f> card;      /**< Also set when only the tree was not found */
+    std::vector<cv::Point2f> tree;
+    double diameter = 0;
+    int degradations = DEGRADE_NONE;    /**< Degradation flags applied to meet the deadline */
+    double elapsed_ms = 0;
+    bool tree_tracked = false;          /**< Tree lines come from the tracker, not from segmentation */
+};
+
+
+/**
+ * State of one measureTree call. It lives on the caller's stack, so calls on different threads
+ * share only the immutable parts of the detector.
+ */
+struct MeasureContext {
+    SourceImage input;              /**< Header of the caller's image in its native layout, valid during the call */
+    DetectorConfig frame_config;    /**< Config with the working widths chosen for this frame */
+    MeasureOptions options;
+    std::chrono::steady_clock::time_point start;
+    int degradations = DEGRADE_NONE;
+
     std::vector<cv::Point2f> card_polygon;
-    double card_confidence = 0;//0 to 1
-    //pair<int, int>* tree_polygon; //nebo std::vector<cv::Point2f>
     std::vector<cv::Point2f> tree_polygon;
-    double tree_confidence = 0; //0 to 1
-    double diameter_value;
-    double diameter_cofidence = 0; //0 to 1
+    bool tree_tracked = false;
+    double diameter = 0;
+
+    double remainingMs() const;
+};
+
+
+/**
+ * Measures tree diameters against one card model and config.
+ * measureTree is const and reentrant: any number of threads may call it on the same detector,
+ * each call keeps its state in a MeasureContext and its temporaries in the ScratchPool of its thread.
+ * The card model and config are immutable and may be shared with other detectors; the one mutable part of the
+ * model, the FLANN index of CARD_MATCH_INDEX, is searched under its own lock.
+ */
+class ObjectDetector {
+private:
+    std::shared_ptr<const CardModel> card_model;    //card template features, may be shared by several detectors
+    std::shared_ptr<const DetectorConfig> config;   //parameters of all stages, may be shared by several detectors
+    mutable ResolutionScheduler scheduler;          //learns card size and stage times across measureTree calls, lock-free
 
     //the following functions only return error codes
-    int setImage(string);
-    int detectCard();
-    int refineCardPosition();
-    int detectTree();
-    int computeDiameter();
-    //void reset();//internal structures/data
+    int measure(MeasureContext& context) const;
+    int detectCard(MeasureContext& context) const;
+    int detectTree(MeasureContext& context, int &attempts) const;
+    int computeDiameter(MeasureContext& context) const;
 public:
     ObjectDetector ();
-    ObjectDetector (cv::Mat);
-    ObjectDetector (string);
+    ObjectDetector (const cv::Mat&, const DetectorConfig& config = DetectorConfig());
+    ObjectDetector (const string&, const DetectorConfig& config = DetectorConfig());
+    ObjectDetector (std::shared_ptr<const CardModel>, const DetectorConfig& config = DetectorConfig());
+    ObjectDetector (std::shared_ptr<const CardModel>, std::shared_ptr<const DetectorConfig> config);
 
-    //Getters
-    std::vector<cv::Point2f> getCardPolygon(){return card_polygon;}
-    std::vector<cv::Point2f> getTreePolygon(){return tree_polygon;}
-    double getDiameterValue(){return diameter_value;}
+    void setConfig(const DetectorConfig& config);   //not while measureTree runs on another thread
+    void resetScheduler();                          //forget the learned card size and stage times
+    const DetectorConfig& getConfig() const {return *config;}
 
-    int measureTree(cv::Mat input_image, double &diameter); //&confidence
-    int measureTree(cv::Mat input_image, std::vector<cv::Point2f> &card, std::vector<cv::Point2f> &tree, double &diameter); //&confidence
+    int measureTree(const SourceImage& input_image, double &diameter) const; //&confidence
+    int measureTree(const SourceImage& input_image, std::vector<cv::Point2f> &card, std::vector<cv::Point2f> &tree, double &diameter) const; //&confidence
+    int measureTree(const SourceImage& input_image, const MeasureOptions& options, MeasureResult& result) const;
     /*return value is error type:
     0 OK
     1 card failed
@@ -47,3 +105,4 @@ public:
     */
 };
 
+#endif //OBJECTDETECTOR_H
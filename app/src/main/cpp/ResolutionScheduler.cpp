@@ -0,0 +1,273 @@
+#include "ResolutionScheduler.h"
+
+#include <algorithm>
+#include <math.h>
+
+static const int MIN_CARD_WIDTH = 400;      // below this SIFT does not find the card template reliably
+static const int MIN_TREE_WIDTH = 240;      // below this grabcut and Hough lose the trunk edges
+static const double SMOOTHING = 0.3;        // weight of the newest frame in the stage time averages
+static const double ORB_COST = 0.3;         // ORB card detection time relative to SIFT at the same width
+static const int MAX_WIDTH_FACTOR = 2;      // adaptive widths stay within this factor of the configured ones
+
+// stage times assumed before the first measurement, on the slow side of the supported phones,
+// so a deadline is enforced from the first frame on; the first measured time replaces them
+static const double DEFAULT_CARD_MS_PER_MPX = 600;  // SIFT card detection per megapixel of its working image
+static const double DEFAULT_TREE_MS_PER_MPX = 150;  // one findTree attempt per megapixel and grabcut iteration + 1
+
+// transient bytes per working-image pixel, measured with OpenCV 4.5
+static const double SIFT_BYTES_PER_PIXEL = 240;     // float pyramid of the 2x upscaled image, 6 Gaussian + 5 DoG layers per octave
+static const double ORB_BYTES_PER_PIXEL = 8;        // 8-bit pyramid and FAST scores
+static const double TREE_BYTES_PER_PIXEL = 200;     // grabcut neighbour weights, GMM indices and graph; HSV, masks
+
+
+/**
+ * Megapixels of an image resized to given width.
+ */
+static double megapixels(int width, cv::Size input_size) {
+    return double(width) * width * input_size.height / input_size.width / 1e6;
+}
+
+
+/**
+ * Copy the history of another scheduler.
+ */
+ResolutionScheduler& ResolutionScheduler::operator=(const ResolutionScheduler& other) {
+    card_fraction.store(other.card_fraction.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    card_ms_per_mpx.store(other.card_ms_per_mpx.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    tree_ms_per_mpx.store(other.tree_ms_per_mpx.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return *this;
+}
+
+
+/**
+ * Choose working widths for the next frame.
+ * @param input_size size of the input image
+ * @param config configured widths, targets and limits
+ * @return widths, the configured ones if adaptive resolution is off
+ */
+ResolutionPlan ResolutionScheduler::plan(cv::Size input_size, const DetectorConfig& config) const {
+    ResolutionPlan plan = {config.card_resize_width, config.tree_resize_width};
+    if (!config.adaptive_resolution || input_size.width <= 0) return plan;
+
+    // keep the card at the size the stages were tuned for
+    float card_fraction = this->card_fraction.load(std::memory_order_relaxed);
+    if (card_fraction > 0) {
+        plan.card_width = int(round(config.card_target_pixels / card_fraction));
+        plan.tree_width = int(round(config.tree_card_pixels / card_fraction));
+    }
+
+    // stage time grows with the number of pixels, scale both areas down to fit the target;
+    // the soft target waits for measured times, the default rates would shrink every first photo
+    if (config.target_latency_ms > 0 && card_ms_per_mpx.load(std::memory_order_relaxed) > 0
+        && tree_ms_per_mpx.load(std::memory_order_relaxed) > 0) {
+        DetectorConfig planned = config;
+        planned.card_resize_width = plan.card_width;
+        planned.tree_resize_width = plan.tree_width;
+        double predicted = predictCardMs(input_size, planned) + predictTreeMs(input_size, planned);
+        if (predicted > config.target_latency_ms) {
+            double scale = sqrt(config.target_latency_ms / predicted);
+            plan.card_width = int(plan.card_width * scale);
+            plan.tree_width = int(plan.tree_width * scale);
+        }
+    }
+
+    // never upscale the input and never go far above the configured widths
+    int max_card = std::min(input_size.width, MAX_WIDTH_FACTOR * config.card_resize_width);
+    int max_tree = std::min(input_size.width, MAX_WIDTH_FACTOR * config.tree_resize_width);
+    plan.card_width = std::max(std::min(plan.card_width, max_card), std::min(MIN_CARD_WIDTH, max_card));
+    plan.tree_width = std::max(std::min(plan.tree_width, max_tree), std::min(MIN_TREE_WIDTH, max_tree));
+    return plan;
+}
+
+
+/**
+ * Learn from a finished frame.
+ * @param input_size size of the input image
+ * @param frame_config parameters the frame was processed with
+ * @param card card corners in the input image, empty if the card was not found
+ * @param card_ms time of card detection
+ * @param tree_attempt_ms time of one tree detection attempt, 0 if it did not run
+ */
+void ResolutionScheduler::update(cv::Size input_size, const DetectorConfig& frame_config,
+                                 const std::vector<cv::Point2f>& card, double card_ms, double tree_attempt_ms) {
+    if (input_size.width <= 0) return;
+
+    // a lost card falls back to the configured widths rather than keeping a stale estimate
+    card_fraction.store(card.size() == 4 ? float(cv::norm(card[1] - card[0]) / input_size.width) : 0,
+                        std::memory_order_relaxed);
+
+    // ORB times say little about SIFT, only SIFT frames are learned from
+    if (!frame_config.fast_descriptor) {
+        double card_rate = card_ms / megapixels(frame_config.card_resize_width, input_size);
+        double previous = card_ms_per_mpx.load(std::memory_order_relaxed);
+        card_ms_per_mpx.store(previous > 0 ? (1 - SMOOTHING) * previous + SMOOTHING * card_rate : card_rate,
+                              std::memory_order_relaxed);
+    }
+    if (tree_attempt_ms > 0) {
+        double tree_rate = tree_attempt_ms / megapixels(frame_config.tree_resize_width, input_size)
+                           / (frame_config.grabcut_iterations + 1);
+        double previous = tree_ms_per_mpx.load(std::memory_order_relaxed);
+        tree_ms_per_mpx.store(previous > 0 ? (1 - SMOOTHING) * previous + SMOOTHING * tree_rate : tree_rate,
+                              std::memory_order_relaxed);
+    }
+}
+
+
+/**
+ * Forget all history, e.g. when the camera or the scene changes.
+ */
+void ResolutionScheduler::reset() {
+    card_fraction.store(0, std::memory_order_relaxed);
+    card_ms_per_mpx.store(0, std::memory_order_relaxed);
+    tree_ms_per_mpx.store(0, std::memory_order_relaxed);
+}
+
+
+/**
+ * Expected time of card detection.
+ * @param input_size size of the input image
+ * @param frame_config working width and descriptor
+ * @return milliseconds, a conservative default rate if there is no history yet
+ */
+double ResolutionScheduler::predictCardMs(cv::Size input_size, const DetectorConfig& frame_config) const {
+    double rate = card_ms_per_mpx.load(std::memory_order_relaxed);
+    if (rate <= 0) rate = DEFAULT_CARD_MS_PER_MPX;
+    double ms = rate * megapixels(frame_config.card_resize_width, input_size);
+    return frame_config.fast_descriptor ? ms * ORB_COST : ms;
+}
+
+
+/**
+ * Expected time of one tree detection attempt (findTree).
+ * @param input_size size of the input image
+ * @param frame_config working width and grabcut iterations
+ * @return milliseconds, a conservative default rate if there is no history yet
+ */
+double ResolutionScheduler::predictTreeMs(cv::Size input_size, const DetectorConfig& frame_config) const {
+    double rate = tree_ms_per_mpx.load(std::memory_order_relaxed);
+    if (rate <= 0) rate = DEFAULT_TREE_MS_PER_MPX;
+    return rate * megapixels(frame_config.tree_resize_width, input_size) * (frame_config.grabcut_iterations + 1);
+}
+
+
+/**
+ * Make card detection fit its budget: lower resolution first, ORB if even the smallest width does not fit.
+ * @param input_size size of the input image
+ * @param budget_ms time available for card detection
+ * @param frame_config parameters of the frame, modified
+ * @return applied Degradation flags
+ */
+int ResolutionScheduler::fitCard(cv::Size input_size, double budget_ms, DetectorConfig& frame_config) const {
+    double predicted = predictCardMs(input_size, frame_config);
+    if (predicted <= 0 || predicted <= budget_ms) return DEGRADE_NONE;
+
+    int flags = DEGRADE_NONE;
+    int width = std::max(std::min(MIN_CARD_WIDTH, frame_config.card_resize_width),
+                         int(frame_config.card_resize_width * sqrt(std::max(budget_ms, 0.0) / predicted)));
+    if (width < frame_config.card_resize_width) {
+        frame_config.card_resize_width = width;
+        flags |= DEGRADE_CARD_RESOLUTION;
+    }
+    if (predictCardMs(input_size, frame_config) > budget_ms) {
+        frame_config.fast_descriptor = true;
+        flags |= DEGRADE_FAST_DESCRIPTOR;
+    }
+    return flags;
+}
+
+
+/**
+ * Make one tree detection attempt fit its budget: fewer grabcut iterations first, lower resolution if
+ * even one iteration does not fit. The Hough threshold is scaled with the width.
+ * @param input_size size of the input image
+ * @param budget_ms time available for tree detection
+ * @param frame_config parameters of the frame, modified
+ * @return applied Degradation flags
+ */
+int ResolutionScheduler::fitTree(cv::Size input_size, double budget_ms, DetectorConfig& frame_config) const {
+    double predicted = predictTreeMs(input_size, frame_config);
+    if (predicted <= 0 || predicted <= budget_ms) return DEGRADE_NONE;
+
+    int flags = DEGRADE_NONE;
+    double per_iteration = predicted / (frame_config.grabcut_iterations + 1);
+    int iterations = std::max(1, int(budget_ms / per_iteration) - 1);
+    if (iterations < frame_config.grabcut_iterations) {
+        frame_config.grabcut_iterations = iterations;
+        flags |= DEGRADE_GRABCUT_ITERATIONS;
+    }
+
+    predicted = predictTreeMs(input_size, frame_config);
+    if (predicted > budget_ms) {
+        int width = std::max(std::min(MIN_TREE_WIDTH, frame_config.tree_resize_width),
+                             int(frame_config.tree_resize_width * sqrt(std::max(budget_ms, 0.0) / predicted)));
+        if (width < frame_config.tree_resize_width) {
+            frame_config.hough_threshold = std::max(10, int(round(
+                    double(frame_config.hough_threshold) * width / frame_config.tree_resize_width)));
+            frame_config.tree_resize_width = width;
+            flags |= DEGRADE_TREE_RESOLUTION;
+        }
+    }
+    return flags;
+}
+
+
+/**
+ * Expected peak of the working memory of a measurement, without the input image.
+ * Card and tree detection run one after the other, their scratch pool images stay allocated.
+ * @param input_size size of the input image
+ * @param frame_config working widths and descriptor
+ * @return bytes
+ */
+size_t ResolutionScheduler::predictBytes(cv::Size input_size, const DetectorConfig& frame_config) {
+    double card_pixels = megapixels(frame_config.card_resize_width, input_size) * 1e6;
+    double tree_pixels = megapixels(frame_config.tree_resize_width, input_size) * 1e6;
+    double card_bytes = card_pixels * (frame_config.fast_descriptor ? ORB_BYTES_PER_PIXEL : SIFT_BYTES_PER_PIXEL);
+    double tree_bytes = tree_pixels * TREE_BYTES_PER_PIXEL;
+    // the grey card image and the BGR tree image of the pool
+    return size_t(std::max(card_bytes, tree_bytes) + card_pixels + 3 * tree_pixels);
+}
+
+
+/**
+ * Make a measurement fit a memory budget: lower resolution of both stages, ORB if even the smallest widths do not fit.
+ * @param input_size size of the input image
+ * @param budget_bytes working memory available, see predictBytes
+ * @param frame_config parameters of the frame, modified
+ * @return applied Degradation flags
+ */
+int ResolutionScheduler::fitMemory(cv::Size input_size, size_t budget_bytes, DetectorConfig& frame_config) {
+    double predicted = double(predictBytes(input_size, frame_config));
+    if (predicted <= budget_bytes) return DEGRADE_NONE;
+
+    // bytes grow with the pixel count, i.e. with the square of the width
+    int flags = DEGRADE_NONE;
+    double scale = sqrt(budget_bytes / predicted);
+    int card_width = std::max(std::min(MIN_CARD_WIDTH, frame_config.card_resize_width), int(frame_config.card_resize_width * scale));
+    int tree_width = std::max(std::min(MIN_TREE_WIDTH, frame_config.tree_resize_width), int(frame_config.tree_resize_width * scale));
+    if (card_width < frame_config.card_resize_width) {
+        frame_config.card_resize_width = card_width;
+        flags |= DEGRADE_CARD_RESOLUTION;
+    }
+    if (tree_width < frame_config.tree_resize_width) {
+        frame_config.hough_threshold = std::max(10, int(round(
+                double(frame_config.hough_threshold) * tree_width / frame_config.tree_resize_width)));
+        frame_config.tree_resize_width = tree_width;
+        flags |= DEGRADE_TREE_RESOLUTION;
+    }
+    if (predictBytes(input_size, frame_config) > budget_bytes && !frame_config.fast_descriptor) {
+        frame_config.fast_descriptor = true;
+        flags |= DEGRADE_FAST_DESCRIPTOR;
+    }
+    return flags;
+}
+
+
+/**
+ * Widest working image any plan can ask for, the input does not need to be wider.
+ * @param config configured widths
+ * @return width in pixels
+ */
+int ResolutionScheduler::maxWorkingWidth(const DetectorConfig& config) {
+    int width = std::max(config.card_resize_width, config.tree_resize_width);
+    return config.adaptive_resolution ? MAX_WIDTH_FACTOR * width : width;
+}
@@ -0,0 +1,72 @@
+#ifndef RESOLUTIONSCHEDULER_H
+#define RESOLUTIONSCHEDULER_H
+
+#include <stdio.h>
+#include <atomic>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "DetectorConfig.h"
+
+
+/**
+ * Working widths of the stages for one frame.
+ */
+struct ResolutionPlan {
+    int card_width;     /**< Width of the image SIFT runs on */
+    int tree_width;     /**< Width of the image tree detection runs on */
+};
+
+
+/**
+ * Cheaper variants applied to a frame so it meets its deadline. Combined as bit flags.
+ */
+enum Degradation {
+    DEGRADE_NONE = 0,
+    DEGRADE_CARD_RESOLUTION = 1,        /**< SIFT on a smaller image */
+    DEGRADE_FAST_DESCRIPTOR = 2,        /**< ORB instead of SIFT */
+    DEGRADE_TREE_RESOLUTION = 4,        /**< Tree detection on a smaller image */
+    DEGRADE_GRABCUT_ITERATIONS = 8,     /**< Fewer grabcut iterations */
+    DEGRADE_SKIP_RETRY = 16             /**< Tree not searched under the card after it was not found above */
+};
+
+
+/**
+ * Chooses the working resolution of card and tree detection per frame.
+ * The card width of the previous frame says how much the image can be downscaled while the card
+ * keeps enough pixels for SIFT and for the trunk edges, the measured stage times say how much
+ * it has to be downscaled to fit the latency target. Without history the configured widths are used.
+ * The same stage time model predicts whether a frame fits its deadline and which cheaper variants it needs,
+ * starting from conservative default rates until the first stage times are measured;
+ * a per-pixel memory model whether it fits a memory budget.
+ * The history is kept in relaxed atomics, so concurrent measurements can plan and update without locks;
+ * an update racing with another one may be lost, which only delays the smoothed estimates.
+ */
+class ResolutionScheduler {
+private:
+    std::atomic<float> card_fraction{0};        /**< Card width / input width of the last frame where the card was found, 0 if unknown */
+    std::atomic<double> card_ms_per_mpx{0};     /**< Smoothed SIFT card detection time per megapixel of its working image */
+    std::atomic<double> tree_ms_per_mpx{0};     /**< Smoothed time of one findTree attempt per megapixel and grabcut iteration + 1 */
+
+public:
+    ResolutionScheduler() {}
+    ResolutionScheduler(const ResolutionScheduler& other) { *this = other; }
+    ResolutionScheduler& operator=(const ResolutionScheduler& other);
+
+    ResolutionPlan plan(cv::Size input_size, const DetectorConfig& config) const;
+    void update(cv::Size input_size, const DetectorConfig& frame_config, const std::vector<cv::Point2f>& card,
+                double card_ms, double tree_attempt_ms);
+    void reset();
+
+    double predictCardMs(cv::Size input_size, const DetectorConfig& frame_config) const;
+    double predictTreeMs(cv::Size input_size, const DetectorConfig& frame_config) const;
+    int fitCard(cv::Size input_size, double budget_ms, DetectorConfig& frame_config) const;
+    int fitTree(cv::Size input_size, double budget_ms, DetectorConfig& frame_config) const;
+
+    static size_t predictBytes(cv::Size input_size, const DetectorConfig& frame_config);
+    static int fitMemory(cv::Size input_size, size_t budget_bytes, DetectorConfig& frame_config);
+    static int maxWorkingWidth(const DetectorConfig& config);
+};
+
+
+#endif //RESOLUTIONSCHEDULER_H
@@ -0,0 +1,190 @@
+#include "ResultCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+// file format: header, then 'count' fixed-size records, all little-endian
+static const uint32_t CACHE_MAGIC = 0x31435254;     // "TRC1"
+static const uint32_t CACHE_VERSION = 1;
+
+#pragma pack(push, 1)
+struct CacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+};
+
+struct CacheFileRecord {
+    uint64_t image_hash;
+    uint64_t config_version;
+    int32_t code;
+    double diameter;
+    uint8_t card_count;         /**< 0 or 4 */
+    uint8_t tree_count;         /**< 0 or 4 */
+    float card[8];
+    float tree[8];
+};
+#pragma pack(pop)
+
+
+/**
+ * Constructor.
+ * @param capacity maximum number of results, the least recently used one is evicted
+ */
+ResultCache::ResultCache(size_t capacity) : capacity(capacity > 0 ? capacity : 1) {
+}
+
+
+/**
+ * Find a stored result and mark it as recently used.
+ * @param image_hash hashImage of the input
+ * @param config_version DetectorConfig::version of the detector
+ * @param result output
+ * @return true on hit
+ */
+bool ResultCache::lookup(uint64_t image_hash, uint64_t config_version, CachedResult& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find({image_hash, config_version});
+    if (it == index.end()) {
+        miss_count++;
+        return false;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    result = it->second->second;
+    hit_count++;
+    return true;
+}
+
+
+/**
+ * Store a result, replacing an older one with the same key.
+ * @param image_hash hashImage of the input
+ * @param config_version DetectorConfig::version of the detector
+ * @param result result to store
+ */
+void ResultCache::store(uint64_t image_hash, uint64_t config_version, const CachedResult& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    insert({image_hash, config_version}, result);
+}
+
+
+void ResultCache::insert(const Key& key, const CachedResult& result) {
+    auto it = index.find(key);
+    if (it != index.end()) {
+        it->second->second = result;
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+    entries.emplace_front(key, result);
+    index[key] = entries.begin();
+    if (entries.size() > capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    index.clear();
+}
+
+size_t ResultCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+size_t ResultCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hit_count;
+}
+
+size_t ResultCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return miss_count;
+}
+
+
+/**
+ * Write all entries, least recently used first, so load restores the order.
+ * @param path output file
+ * @return true on success
+ */
+bool ResultCache::save(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+
+    CacheFileHeader header = {CACHE_MAGIC, CACHE_VERSION, uint32_t(entries.size())};
+    out.write((const char*) &header, sizeof(header));
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        const CachedResult& result = it->second;
+        CacheFileRecord record = {};
+        record.image_hash = it->first.image_hash;
+        record.config_version = it->first.config_version;
+        record.code = result.code;
+        record.diameter = result.diameter;
+        record.card_count = uint8_t(result.card.size() == 4 ? 4 : 0);
+        record.tree_count = uint8_t(result.tree.size() == 4 ? 4 : 0);
+        for (int i = 0; i < record.card_count; i++) {
+            record.card[2 * i] = result.card[i].x;
+            record.card[2 * i + 1] = result.card[i].y;
+        }
+        for (int i = 0; i < record.tree_count; i++) {
+            record.tree[2 * i] = result.tree[i].x;
+            record.tree[2 * i + 1] = result.tree[i].y;
+        }
+        out.write((const char*) &record, sizeof(record));
+    }
+    return bool(out);
+}
+
+
+/**
+ * Add entries saved with save(). A missing, foreign or corrupt file leaves the cache unchanged.
+ * Records beyond the capacity are the least recently used ones and are skipped.
+ * @param path cache file
+ * @return true on success
+ */
+bool ResultCache::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    std::streamoff file_size = in.tellg();
+    in.seekg(0);
+
+    CacheFileHeader header;
+    if (!in.read((char*) &header, sizeof(header)) || header.magic != CACHE_MAGIC || header.version != CACHE_VERSION) {
+        std::cerr << "ResultCache: ignoring incompatible file " << path << std::endl;
+        return false;
+    }
+    // the count comes from disk, check it before allocating anything for it
+    if (file_size != std::streamoff(sizeof(CacheFileHeader) + uint64_t(header.count) * sizeof(CacheFileRecord))) {
+        std::cerr << "ResultCache: ignoring corrupt file " << path << ", " << header.count
+                  << " records in " << file_size << " bytes" << std::endl;
+        return false;
+    }
+    size_t count = std::min(size_t(header.count), capacity);
+    in.seekg(std::streamoff((header.count - count) * sizeof(CacheFileRecord)), std::ios::cur);
+    std::vector<CacheFileRecord> records(count);
+    if (count > 0 && !in.read((char*) records.data(), std::streamsize(records.size() * sizeof(CacheFileRecord)))) {
+        std::cerr << "ResultCache: ignoring truncated file " << path << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const CacheFileRecord& record : records) {
+        CachedResult result;
+        result.code = record.code;
+        result.diameter = record.diameter;
+        for (int i = 0; i < 4 && record.card_count == 4; i++) {
+            result.card.push_back(cv::Point2f(record.card[2 * i], record.card[2 * i + 1]));
+        }
+        for (int i = 0; i < 4 && record.tree_count == 4; i++) {
+            result.tree.push_back(cv::Point2f(record.tree[2 * i], record.tree[2 * i + 1]));
+        }
+        insert({record.image_hash, record.config_version}, result);
+    }
+    return true;
+}
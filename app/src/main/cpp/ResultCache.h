@@ -0,0 +1,69 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/core.hpp>
+
+
+/**
+ * Measurement stored in the cache.
+ */
+struct CachedResult {
+    int code = 0;
+    std::vector<cv::Point2f> card;
+    std::vector<cv::Point2f> tree;
+    double diameter = 0;
+};
+
+
+/**
+ * Bounded LRU cache of measurement results keyed by image content hash and config version,
+ * so a re-submitted photo is answered without running the pipeline.
+ * Can be persisted to a compact binary file. Thread-safe.
+ */
+class ResultCache {
+private:
+    struct Key {
+        uint64_t image_hash;
+        uint64_t config_version;
+        bool operator==(const Key& other) const {
+            return image_hash == other.image_hash && config_version == other.config_version;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return size_t(key.image_hash ^ (key.config_version * 31)); }
+    };
+    typedef std::list<std::pair<Key, CachedResult>> Entries;
+
+    size_t capacity;
+    Entries entries;        /**< Most recently used first */
+    std::unordered_map<Key, Entries::iterator, KeyHash> index;
+    mutable std::mutex mutex;
+    size_t hit_count = 0;
+    size_t miss_count = 0;
+
+    void insert(const Key& key, const CachedResult& result);
+
+public:
+    explicit ResultCache(size_t capacity = 64);
+
+    bool lookup(uint64_t image_hash, uint64_t config_version, CachedResult& result);
+    void store(uint64_t image_hash, uint64_t config_version, const CachedResult& result);
+    void clear();
+
+    size_t size() const;
+    size_t hits() const;
+    size_t misses() const;
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+};
+
+
+#endif //RESULTCACHE_H
@@ -0,0 +1,381 @@
+#include "RunMask.h"
+
+#include <algorithm>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/**
+ * Append a run to the row being built, merging it with the last run if they overlap or touch.
+ */
+static inline void appendRun(std::vector<Run>& runs, size_t row_first, int start, int end) {
+    if (start >= end) return;
+    if (runs.size() > row_first && start <= runs.back().end) {
+        runs.back().end = std::max(runs.back().end, end);
+    } else {
+        runs.push_back({start, end});
+    }
+}
+
+
+/**
+ * Build the mask from grabcut labels, GC_FGD and GC_PR_FGD are foreground.
+ * @param labels CV_8U grabcut mask, possibly of a band of columns only
+ * @param col_offset column of the mask where the labels start
+ * @param cols mask width, columns outside the labels are background
+ */
+void RunMask::fromLabels(const cv::Mat& labels, int col_offset, int cols) {
+    mask_rows = labels.rows;
+    mask_cols = cols;
+    runs.clear();
+    row_start.assign(1, 0);
+    static const uint64_t LABEL_BITS = 0x0101010101010101ull;  // foreground bit of 8 labels
+    for (int r = 0; r < labels.rows; r++) {
+        const uchar* label = labels.ptr<uchar>(r);
+        int c = 0;
+        while (c < labels.cols) {
+            // GC_FGD = 1 and GC_PR_FGD = 3 are the odd labels
+            bool foreground = label[c] & 1;
+            int start = c++;
+            // 8 labels at a time inside long runs of either kind
+            for (uint64_t word; c + 8 <= labels.cols; c += 8) {
+                memcpy(&word, label + c, 8);
+                if ((word & LABEL_BITS) != (foreground ? LABEL_BITS : 0)) break;
+            }
+            while (c < labels.cols && bool(label[c] & 1) == foreground) c++;
+            if (foreground) runs.push_back({col_offset + start, col_offset + c});
+        }
+        row_start.push_back(int(runs.size()));
+    }
+}
+
+
+/**
+ * Paint the mask into a dense image, for debug output.
+ * @param dst output CV_8U image, foreground 255
+ */
+void RunMask::toMat(cv::Mat& dst) const {
+    dst.create(mask_rows, mask_cols, CV_8U);
+    for (int r = 0; r < mask_rows; r++) {
+        uchar* row = dst.ptr<uchar>(r);
+        memset(row, 0, size_t(mask_cols));
+        for (const Run* run = rowBegin(r); run != rowEnd(r); run++) memset(row + run->start, 255, size_t(run->end - run->start));
+    }
+}
+
+
+/**
+ * Horizontal dilation, a pixel is foreground if any pixel of [x - left, x + right] is.
+ */
+void RunMask::dilateRows(int left, int right, RunMask& dst) const {
+    dst.mask_rows = mask_rows;
+    dst.mask_cols = mask_cols;
+    dst.runs.clear();
+    dst.row_start.assign(1, 0);
+    for (int r = 0; r < mask_rows; r++) {
+        size_t first = dst.runs.size();
+        for (const Run* run = rowBegin(r); run != rowEnd(r); run++) {
+            appendRun(dst.runs, first, std::max(0, run->start - right), std::min(mask_cols, run->end + left));
+        }
+        dst.row_start.push_back(int(dst.runs.size()));
+    }
+}
+
+
+/**
+ * Horizontal erosion, a pixel is foreground if all pixels of [x - left, x + right] are.
+ * Pixels outside the mask count as foreground, like the default border of cv::erode.
+ */
+void RunMask::erodeRows(int left, int right, RunMask& dst) const {
+    dst.mask_rows = mask_rows;
+    dst.mask_cols = mask_cols;
+    dst.runs.clear();
+    dst.row_start.assign(1, 0);
+    for (int r = 0; r < mask_rows; r++) {
+        for (const Run* run = rowBegin(r); run != rowEnd(r); run++) {
+            int start = run->start == 0 ? 0 : run->start + left;
+            int end = run->end == mask_cols ? mask_cols : run->end - right;
+            if (start < end) dst.runs.push_back({start, end});
+        }
+        dst.row_start.push_back(int(dst.runs.size()));
+    }
+}
+
+
+/**
+ * Vertical dilation, a row is the union of the rows [y - up, y + down] within the mask.
+ */
+void RunMask::dilateColumns(int up, int down, RunMask& dst, RunMaskScratch& scratch) const {
+    dst.mask_rows = mask_rows;
+    dst.mask_cols = mask_cols;
+    dst.runs.clear();
+    dst.row_start.assign(1, 0);
+    std::vector<Run>& window = scratch.window;
+    for (int r = 0; r < mask_rows; r++) {
+        window.assign(rowBegin(std::max(0, r - up)), rowEnd(std::min(mask_rows - 1, r + down)));
+        std::sort(window.begin(), window.end(), [](const Run& a, const Run& b) { return a.start < b.start; });
+        size_t first = dst.runs.size();
+        for (const Run& run : window) appendRun(dst.runs, first, run.start, run.end);
+        dst.row_start.push_back(int(dst.runs.size()));
+    }
+}
+
+
+/**
+ * Vertical erosion, a row is the intersection of the rows [y - up, y + down].
+ * Rows outside the mask count as foreground, like the default border of cv::erode.
+ */
+void RunMask::erodeColumns(int up, int down, RunMask& dst, RunMaskScratch& scratch) const {
+    dst.mask_rows = mask_rows;
+    dst.mask_cols = mask_cols;
+    dst.runs.clear();
+    dst.row_start.assign(1, 0);
+    std::vector<Run>& current = scratch.current;
+    std::vector<Run>& next = scratch.next;
+    for (int r = 0; r < mask_rows; r++) {
+        int first = std::max(0, r - up), last = std::min(mask_rows - 1, r + down);
+        // a trunk row is usually a single run, the intersection is then a single run too
+        Run single = {0, mask_cols};
+        int row = first;
+        for (; row <= last && row_start[row + 1] - row_start[row] == 1; row++) {
+            single.start = std::max(single.start, runs[row_start[row]].start);
+            single.end = std::min(single.end, runs[row_start[row]].end);
+        }
+        if (row > last) {
+            if (single.start < single.end) dst.runs.push_back(single);
+            dst.row_start.push_back(int(dst.runs.size()));
+            continue;
+        }
+        current.assign(rowBegin(first), rowEnd(first));
+        for (int w = first + 1; w <= last && !current.empty(); w++) {
+            // intersect two sorted run lists
+            next.clear();
+            const Run* a = current.data();
+            const Run* a_end = a + current.size();
+            const Run* b = rowBegin(w);
+            const Run* b_end = rowEnd(w);
+            while (a != a_end && b != b_end) {
+                int start = std::max(a->start, b->start), end = std::min(a->end, b->end);
+                if (start < end) next.push_back({start, end});
+                if (a->end < b->end) a++;
+                else b++;
+            }
+            current.swap(next);
+        }
+        dst.runs.insert(dst.runs.end(), current.begin(), current.end());
+        dst.row_start.push_back(int(dst.runs.size()));
+    }
+}
+
+
+/**
+ * Dilation in place with a rectangular kernel, anchored at its centre like cv::dilate with the default border.
+ * @param kernel kernel width and height
+ * @param scratch temporaries, reused between calls
+ */
+void RunMask::dilate(cv::Size kernel, RunMaskScratch& scratch) {
+    dilateRows(kernel.width / 2, kernel.width - 1 - kernel.width / 2, scratch.tmp);
+    scratch.tmp.dilateColumns(kernel.height / 2, kernel.height - 1 - kernel.height / 2, *this, scratch);
+}
+
+
+/**
+ * Erosion in place with a rectangular kernel, anchored at its centre like cv::erode with the default border.
+ * @param kernel kernel width and height
+ * @param scratch temporaries, reused between calls
+ */
+void RunMask::erode(cv::Size kernel, RunMaskScratch& scratch) {
+    erodeRows(kernel.width / 2, kernel.width - 1 - kernel.width / 2, scratch.tmp);
+    scratch.tmp.erodeColumns(kernel.height / 2, kernel.height - 1 - kernel.height / 2, *this, scratch);
+}
+
+
+/**
+ * Morphological opening in place, equals cv::morphologyEx(MORPH_OPEN) with a rectangular kernel.
+ * @param kernel kernel width and height
+ * @param scratch temporaries, reused between calls
+ */
+void RunMask::open(cv::Size kernel, RunMaskScratch& scratch) {
+    erode(kernel, scratch);
+    dilate(kernel, scratch);
+}
+
+
+/**
+ * Morphological closing in place, equals cv::morphologyEx(MORPH_CLOSE) with a rectangular kernel.
+ * @param kernel kernel width and height
+ * @param scratch temporaries, reused between calls
+ */
+void RunMask::close(cv::Size kernel, RunMaskScratch& scratch) {
+    dilate(kernel, scratch);
+    erode(kernel, scratch);
+}
+
+
+/**
+ * Columns covered by exactly one of two rows of runs.
+ */
+static void symmetricDifference(const Run* a, const Run* a_end, const Run* b, const Run* b_end, int cols, std::vector<Run>& out) {
+    int x = 0;
+    while (x < cols) {
+        while (a != a_end && a->end <= x) a++;
+        while (b != b_end && b->end <= x) b++;
+        bool in_a = a != a_end && a->start <= x;
+        bool in_b = b != b_end && b->start <= x;
+        int next_a = a == a_end ? INT_MAX : (in_a ? a->end : a->start);
+        int next_b = b == b_end ? INT_MAX : (in_b ? b->end : b->start);
+        int next = std::min(cols, std::min(next_a, next_b));
+        if (in_a != in_b) out.push_back({x, next});
+        x = next;
+    }
+}
+
+
+/**
+ * Mask value with a replicated border.
+ */
+bool RunMask::at(int x, int y) const {
+    x = std::min(std::max(x, 0), mask_cols - 1);
+    y = std::min(std::max(y, 0), mask_rows - 1);
+    for (const Run* run = rowBegin(y); run != rowEnd(y) && run->start <= x; run++) {
+        if (x < run->end) return true;
+    }
+    return false;
+}
+
+
+/**
+ * 3x3 Sobel derivatives of the mask as a 0/255 image, replicated border like cv::Canny.
+ */
+void RunMask::sobel(int x, int y, int& dx, int& dy) const {
+    int p[3][3];
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) p[i][j] = at(x + j - 1, y + i - 1) ? 255 : 0;
+    }
+    dx = (p[0][2] + 2 * p[1][2] + p[2][2]) - (p[0][0] + 2 * p[1][0] + p[2][0]);
+    dy = (p[2][0] + 2 * p[2][1] + p[2][2]) - (p[0][0] + 2 * p[0][1] + p[0][2]);
+}
+
+
+/**
+ * Non-zero Sobel gradients of a row: pixels whose 3x3 neighbourhood crosses a run end or a change
+ * between rows, the gradient is zero everywhere else.
+ * @param r row
+ * @param spans temporary buffer
+ * @param out output gradients, sorted by column
+ */
+void RunMask::gradients(int r, std::vector<Run>& spans, std::vector<Gradient>& out) const {
+    spans.clear();
+    int first = std::max(0, r - 1), last = std::min(mask_rows - 1, r + 1);
+    for (int w = first; w <= last; w++) {
+        for (const Run* run = rowBegin(w); run != rowEnd(w); run++) {
+            spans.push_back({run->start - 1, run->start + 1});
+            spans.push_back({run->end - 1, run->end + 1});
+        }
+    }
+    size_t changes = spans.size();
+    for (int w = first; w < last; w++) symmetricDifference(rowBegin(w), rowEnd(w), rowBegin(w + 1), rowEnd(w + 1), mask_cols, spans);
+    for (size_t i = changes; i < spans.size(); i++) {
+        spans[i].start--;
+        spans[i].end++;
+    }
+    std::sort(spans.begin(), spans.end(), [](const Run& a, const Run& b) { return a.start < b.start; });
+
+    int x = 0;
+    for (const Run& span : spans) {
+        for (x = std::max(x, std::max(span.start, 0)); x < std::min(span.end, mask_cols); x++) {
+            int dx, dy;
+            sobel(x, r, dx, dy);
+            if (dx != 0 || dy != 0) out.push_back({x, dx, dy, std::abs(dx) + std::abs(dy)});
+        }
+    }
+}
+
+
+/**
+ * Edge pixels of the mask, the ones cv::Canny with aperture 3 and the L1 norm finds on the mask as a 0/255 image.
+ * Sobel, non-maximum suppression and hysteresis run only on the pixels with a non-zero gradient,
+ * a few per row, instead of on the whole image.
+ * @param low_threshold Canny low threshold
+ * @param high_threshold Canny high threshold
+ * @param points output, sorted by row and column
+ * @param scratch temporaries, reused between calls
+ */
+void RunMask::boundary(double low_threshold, double high_threshold, std::vector<cv::Point>& points, RunMaskScratch& scratch) const {
+    static const int TG22 = 13573;      // tan(22.5 deg) in Q15, as in cv::Canny
+    int low = cvFloor(low_threshold), high = cvFloor(high_threshold);
+    if (low > high) std::swap(low, high);
+
+    // gradients of rows r - 1, r and r + 1, other pixels have a zero gradient; rows outside the mask stay empty like the zero padding of cv::Canny
+    std::vector<Gradient>* rows = scratch.rows;
+    std::vector<Run>& spans = scratch.spans;
+    for (int i = 0; i < 3; i++) rows[i].clear();
+    gradients(0, spans, rows[2]);
+    auto magnitude = [](const std::vector<Gradient>& row, int x) {
+        auto it = std::lower_bound(row.begin(), row.end(), x, [](const Gradient& g, int x) { return g.x < x; });
+        return it != row.end() && it->x == x ? it->m : 0;
+    };
+
+    // local maxima above the low threshold, row after row; strong ones are above the high threshold
+    std::vector<cv::Point>& maxima = scratch.maxima;
+    std::vector<char>& strong = scratch.strong;
+    std::vector<int>& maxima_start = scratch.maxima_start;
+    maxima.clear();
+    strong.clear();
+    maxima_start.assign(1, 0);
+    for (int r = 0; r < mask_rows; r++) {
+        std::swap(rows[0], rows[1]);
+        std::swap(rows[1], rows[2]);
+        rows[2].clear();
+        if (r + 1 < mask_rows) gradients(r + 1, spans, rows[2]);
+
+        for (const Gradient& g : rows[1]) {
+            if (g.m <= low) continue;
+            // non-maximum suppression across the gradient direction
+            int ax = std::abs(g.dx), ay = std::abs(g.dy) << 15;
+            int tg22x = ax * TG22;
+            bool maximum;
+            if (ay < tg22x) {
+                maximum = g.m > magnitude(rows[1], g.x - 1) && g.m >= magnitude(rows[1], g.x + 1);
+            } else if (ay > tg22x + (ax << 16)) {
+                maximum = g.m > magnitude(rows[0], g.x) && g.m >= magnitude(rows[2], g.x);
+            } else {
+                int s = (g.dx ^ g.dy) < 0 ? -1 : 1;
+                maximum = g.m > magnitude(rows[0], g.x - s) && g.m > magnitude(rows[2], g.x + s);
+            }
+            if (maximum) {
+                maxima.push_back(cv::Point(g.x, r));
+                strong.push_back(g.m > high);
+            }
+        }
+        maxima_start.push_back(int(maxima.size()));
+    }
+
+    // hysteresis, weak maxima are kept when 8-connected to a strong one
+    std::vector<int>& stack = scratch.stack;
+    stack.clear();
+    for (size_t i = 0; i < maxima.size(); i++) {
+        if (strong[i]) stack.push_back(int(i));
+    }
+    while (!stack.empty()) {
+        cv::Point p = maxima[stack.back()];
+        stack.pop_back();
+        for (int w = std::max(0, p.y - 1); w <= std::min(mask_rows - 1, p.y + 1); w++) {
+            auto begin = maxima.begin() + maxima_start[w], end = maxima.begin() + maxima_start[w + 1];
+            auto it = std::lower_bound(begin, end, p.x - 1, [](const cv::Point& a, int x) { return a.x < x; });
+            for (; it != end && it->x <= p.x + 1; it++) {
+                size_t i = size_t(it - maxima.begin());
+                if (!strong[i]) {
+                    strong[i] = 1;
+                    stack.push_back(int(i));
+                }
+            }
+        }
+    }
+
+    points.clear();
+    for (size_t i = 0; i < maxima.size(); i++) {
+        if (strong[i]) points.push_back(maxima[i]);
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef RUNMASK_H
+#define RUNMASK_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+
+/**
+ * Horizontal run of foreground pixels, columns [start, end).
+ */
+struct Run {
+    int start;
+    int end;
+};
+
+
+/**
+ * Sobel derivatives and L1 magnitude of a mask pixel.
+ */
+struct Gradient {
+    int x;
+    int dx;
+    int dy;
+    int m;
+};
+
+
+struct RunMaskScratch;
+
+
+/**
+ * Binary mask stored as foreground runs per row. A trunk mask has one or two runs per row,
+ * so it takes a few bytes per row instead of a byte per pixel, and morphology and boundary
+ * extraction cost per run instead of per pixel.
+ * Runs of a row are sorted, disjoint and not adjacent.
+ */
+class RunMask {
+private:
+    int mask_rows = 0;
+    int mask_cols = 0;
+    std::vector<Run> runs;              /**< Runs of all rows, row after row */
+    std::vector<int> row_start;         /**< Index of the first run of each row, rows + 1 entries */
+
+    void dilateRows(int left, int right, RunMask& dst) const;
+    void erodeRows(int left, int right, RunMask& dst) const;
+    void dilateColumns(int up, int down, RunMask& dst, RunMaskScratch& scratch) const;
+    void erodeColumns(int up, int down, RunMask& dst, RunMaskScratch& scratch) const;
+    bool at(int x, int y) const;
+    void sobel(int x, int y, int& dx, int& dy) const;
+    void gradients(int r, std::vector<Run>& spans, std::vector<Gradient>& out) const;
+
+public:
+    RunMask() {}
+
+    void fromLabels(const cv::Mat& labels, int col_offset, int cols);
+    void toMat(cv::Mat& dst) const;
+
+    void dilate(cv::Size kernel, RunMaskScratch& scratch);
+    void erode(cv::Size kernel, RunMaskScratch& scratch);
+    void open(cv::Size kernel, RunMaskScratch& scratch);
+    void close(cv::Size kernel, RunMaskScratch& scratch);
+
+    void boundary(double low_threshold, double high_threshold, std::vector<cv::Point>& points, RunMaskScratch& scratch) const;
+
+    int rows() const { return mask_rows; }
+    int cols() const { return mask_cols; }
+    size_t runCount() const { return runs.size(); }
+    size_t bytes() const { return runs.size() * sizeof(Run) + row_start.size() * sizeof(int); }
+    const Run* rowBegin(int row) const { return runs.data() + row_start[row]; }
+    const Run* rowEnd(int row) const { return runs.data() + row_start[row + 1]; }
+};
+
+
+/**
+ * Temporaries of the RunMask operations. The caller keeps them, e.g. in its ScratchPool,
+ * so repeated operations reuse the memory of the previous ones.
+ */
+struct RunMaskScratch {
+    RunMask tmp;                        /**< Mask between the row and the column pass of the morphology */
+    std::vector<Run> window;
+    std::vector<Run> current;
+    std::vector<Run> next;
+    std::vector<Run> spans;
+    std::vector<Gradient> rows[3];      /**< Gradients of three neighbouring rows */
+    std::vector<cv::Point> maxima;
+    std::vector<char> strong;
+    std::vector<int> maxima_start;
+    std::vector<int> stack;
+};
+
+
+#endif //RUNMASK_H
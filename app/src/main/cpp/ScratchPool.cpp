@@ -0,0 +1,66 @@
+#include "ScratchPool.h"
+
+
+/**
+ * Pool of the calling thread.
+ * @return pool, created on first use
+ */
+ScratchPool& ScratchPool::local() {
+    static thread_local ScratchPool pool;
+    return pool;
+}
+
+
+/**
+ * Get temporary image of given size and type. The content is undefined.
+ * The buffer is reallocated only if it is smaller than requested or has a different type,
+ * otherwise a view into the existing buffer is returned. OpenCV functions writing into the view
+ * keep using its memory because size and type already match.
+ * @param slot slot of the temporary
+ * @param rows number of rows
+ * @param cols number of columns
+ * @param type OpenCV type, e.g. CV_8UC3
+ * @return view with the requested size and type
+ */
+cv::Mat ScratchPool::get(Slot slot, int rows, int cols, int type) {
+    cv::Mat& buffer = buffers[slot];
+
+    if (buffer.type() != type || buffer.rows < rows || buffer.cols < cols) {
+        buffer.create(std::max(rows, buffer.rows), std::max(cols, buffer.cols), type);
+        allocation_count++;
+    }
+    return buffer(cv::Rect(0, 0, cols, rows));
+}
+
+
+/**
+ * Debug counter of the image slots. Stays the same between two measurements if the pool served
+ * its slots without reallocating; it does not see allocations inside OpenCV or of the vectors in tree().
+ * @return number of image buffer allocations since the pool was created
+ */
+size_t ScratchPool::allocations() const {
+    return allocation_count;
+}
+
+
+/**
+ * @return memory held by the pool in bytes
+ */
+size_t ScratchPool::bytes() const {
+    size_t sum = 0;
+    for (int i = 0; i < SLOT_COUNT; i++) {
+        sum += buffers[i].total() * buffers[i].elemSize();
+    }
+    return sum;
+}
+
+
+/**
+ * Free all buffers, e.g. when the app goes to background. The counter is kept.
+ */
+void ScratchPool::release() {
+    for (int i = 0; i < SLOT_COUNT; i++) {
+        buffers[i].release();
+    }
+    tree_buffers = TreeBuffers();
+}
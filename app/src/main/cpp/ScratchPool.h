@@ -0,0 +1,69 @@
+#ifndef SCRATCHPOOL_H
+#define SCRATCHPOOL_H
+
+#include <stdio.h>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "RunMask.h"
+
+
+/**
+ * Per-thread pool of temporary images used by the pipeline stages.
+ * Every temporary has its own slot. A slot keeps one buffer which only grows, so after the first
+ * measurements of a given input size the pooled temporaries are not reallocated.
+ * A buffer is valid until the same slot is requested again on the same thread.
+ * The pool covers the temporaries of the pipeline code; OpenCV calls (SIFT, FLANN, grabCut's graph)
+ * still allocate internally, so a measurement is not free of heap allocations.
+ */
+class ScratchPool {
+public:
+    enum Slot {
+        CARD_IMAGE,             /**< Grey input image resized for SIFT */
+        TREE_IMAGE,             /**< Input image resized for tree detection */
+        SOURCE_COLOR,           /**< RGBA or grey input resized for tree detection, before conversion to BGR */
+        GRABCUT_MASK,
+        GRABCUT_HSV,
+        GRABCUT_GREEN,
+        GRABCUT_BGD_MODEL,
+        GRABCUT_FGD_MODEL,
+        HOUGH_ACCUMULATOR,      /**< Votes of the trunk edge Hough transform */
+        SLOT_COUNT
+    };
+
+    /**
+     * Non-image temporaries of tree detection. Vectors keep their capacity, like the image slots.
+     */
+    struct TreeBuffers {
+        RunMask mask;                       /**< Trunk mask of the last findTree */
+        RunMaskScratch mask_scratch;        /**< Temporaries of the trunk mask morphology and boundary */
+        std::vector<cv::Point> edges;       /**< Boundary points of the trunk mask */
+        std::vector<float> hough_sin;       /**< Angle tables of the Hough transform */
+        std::vector<float> hough_cos;
+        std::vector<int> hough_peaks;
+        std::vector<cv::Vec2f> hough_lines;
+    };
+
+    static ScratchPool& local();
+
+    cv::Mat get(Slot slot, int rows, int cols, int type);
+    cv::Mat get(Slot slot, cv::Size size, int type) { return get(slot, size.height, size.width, type); }
+
+    TreeBuffers& tree() { return tree_buffers; }
+
+    size_t allocations() const;
+    size_t bytes() const;
+    void release();
+
+private:
+    cv::Mat buffers[SLOT_COUNT];        /**< Backing buffers, the returned Mats are views into them */
+    size_t allocation_count = 0;        /**< Image buffers (re)allocated since the pool was created */
+    TreeBuffers tree_buffers;
+
+    ScratchPool() {}
+    ScratchPool(const ScratchPool&) = delete;
+    ScratchPool& operator=(const ScratchPool&) = delete;
+};
+
+
+#endif //SCRATCHPOOL_H
@@ -0,0 +1,298 @@
+#include "SourceImage.h"
+#include "GrayResizeBlur.h"
+#include "ScratchPool.h"
+#include "Trace.h"
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include <opencv2/imgproc.hpp>
+
+// fixed-point constants of OpenCV's YUV 4:2:0 to RGB conversion, ITU-R BT.601 limited range
+static const int YUV_SHIFT = 20;
+static const int YUV_CY = 1220542;
+static const int YUV_CUB = 2116026;
+static const int YUV_CUG = -409993;
+static const int YUV_CVG = -852492;
+static const int YUV_CVR = 1673527;
+static const int LINEAR_BITS = 11;          // bilinear weights, like cv::resize of 8-bit images
+static const int YUV_STRIPE_ROWS = 32;      // output rows per parallel task
+
+
+/**
+ * Source indices and weights of bilinear resizing along one axis, positions as in cv::resize.
+ */
+static void linearAxis(int src_len, int dst_len, std::vector<int>& ofs, std::vector<int>& coef) {
+    ofs.resize(2 * dst_len);
+    coef.resize(2 * dst_len);
+    double scale = double(src_len) / dst_len;
+    for (int d = 0; d < dst_len; d++) {
+        float f = float((d + 0.5) * scale - 0.5);
+        int s = int(floorf(f));
+        f -= s;
+        if (s < 0) {
+            s = 0;
+            f = 0;
+        }
+        if (s >= src_len - 1) {
+            s = src_len - 1;
+            f = 0;
+        }
+        ofs[2 * d] = s;
+        ofs[2 * d + 1] = std::min(s + 1, src_len - 1);
+        coef[2 * d + 1] = int(roundf(f * (1 << LINEAR_BITS)));
+        coef[2 * d] = (1 << LINEAR_BITS) - coef[2 * d + 1];
+    }
+}
+
+
+/**
+ * Planes of a YUV 4:2:0 image. Chroma samples of a row are pixel_step bytes apart, 2 for NV21, 1 for I420.
+ */
+struct Yuv420Planes {
+    const uchar* y;
+    size_t y_step;
+    const uchar* u;
+    const uchar* v;
+    size_t uv_step;
+    int uv_pixel_step;
+};
+
+
+static inline int bilinear(const uchar* row0, const uchar* row1, int x0, int x1, int wx0, int wx1, int wy0, int wy1) {
+    return (wy0 * (wx0 * row0[x0] + wx1 * row0[x1]) + wy1 * (wx0 * row1[x0] + wx1 * row1[x1])
+            + (1 << (2 * LINEAR_BITS - 1))) >> (2 * LINEAR_BITS);
+}
+
+
+/**
+ * Bilinear resize of the Y, U and V planes and BT.601 conversion to BGR in one pass.
+ * Only the source pixels the interpolation reads are touched, and they are converted at the working
+ * resolution. Equals cvtColor(YUV2BGR_NV21 / _I420) + resize(INTER_LINEAR) on smooth regions; at sharp
+ * edges the order of interpolation and the non-linear clipping differ by a few levels.
+ */
+static void yuvResizeToBgr(const Yuv420Planes& planes, cv::Size size, cv::Mat& dst, cv::Size dsize) {
+    std::vector<int> y_xofs, y_xcoef, y_yofs, y_ycoef, c_xofs, c_xcoef, c_yofs, c_ycoef;
+    linearAxis(size.width, dsize.width, y_xofs, y_xcoef);
+    linearAxis(size.height, dsize.height, y_yofs, y_ycoef);
+    linearAxis(size.width / 2, dsize.width, c_xofs, c_xcoef);
+    linearAxis(size.height / 2, dsize.height, c_yofs, c_ycoef);
+    for (int& x : c_xofs) x *= planes.uv_pixel_step;
+
+    int stripes = (dsize.height + YUV_STRIPE_ROWS - 1) / YUV_STRIPE_ROWS;
+    cv::parallel_for_(cv::Range(0, stripes), [&](const cv::Range& range) {
+        int first = range.start * YUV_STRIPE_ROWS;
+        int last = std::min(dsize.height, range.end * YUV_STRIPE_ROWS);
+        for (int dy = first; dy < last; dy++) {
+            const uchar* y0 = planes.y + y_yofs[2 * dy] * planes.y_step;
+            const uchar* y1 = planes.y + y_yofs[2 * dy + 1] * planes.y_step;
+            const uchar* u0 = planes.u + c_yofs[2 * dy] * planes.uv_step;
+            const uchar* u1 = planes.u + c_yofs[2 * dy + 1] * planes.uv_step;
+            const uchar* v0 = planes.v + c_yofs[2 * dy] * planes.uv_step;
+            const uchar* v1 = planes.v + c_yofs[2 * dy + 1] * planes.uv_step;
+            int ywy0 = y_ycoef[2 * dy], ywy1 = y_ycoef[2 * dy + 1];
+            int cwy0 = c_ycoef[2 * dy], cwy1 = c_ycoef[2 * dy + 1];
+            uchar* out = dst.ptr<uchar>(dy);
+
+            for (int dx = 0; dx < dsize.width; dx++) {
+                int luma = bilinear(y0, y1, y_xofs[2 * dx], y_xofs[2 * dx + 1], y_xcoef[2 * dx], y_xcoef[2 * dx + 1], ywy0, ywy1);
+                int cx0 = c_xofs[2 * dx], cx1 = c_xofs[2 * dx + 1], cwx0 = c_xcoef[2 * dx], cwx1 = c_xcoef[2 * dx + 1];
+                int u = bilinear(u0, u1, cx0, cx1, cwx0, cwx1, cwy0, cwy1) - 128;
+                int v = bilinear(v0, v1, cx0, cx1, cwx0, cwx1, cwy0, cwy1) - 128;
+
+                int y = std::max(0, luma - 16) * YUV_CY + (1 << (YUV_SHIFT - 1));
+                out[3 * dx] = cv::saturate_cast<uchar>((y + YUV_CUB * u) >> YUV_SHIFT);
+                out[3 * dx + 1] = cv::saturate_cast<uchar>((y + YUV_CUG * u + YUV_CVG * v) >> YUV_SHIFT);
+                out[3 * dx + 2] = cv::saturate_cast<uchar>((y + YUV_CVR * v) >> YUV_SHIFT);
+            }
+        }
+    });
+}
+
+
+static Yuv420Planes nv21Planes(const cv::Mat& data, cv::Size size) {
+    const uchar* vu = data.ptr<uchar>(size.height);
+    return {data.ptr<uchar>(0), data.step[0], vu + 1, vu, data.step[0], 2};
+}
+
+
+static Yuv420Planes i420Planes(const cv::Mat& data, cv::Size size) {
+    const uchar* u = data.ptr<uchar>(size.height);
+    size_t uv_step = size_t(size.width / 2);
+    return {data.ptr<uchar>(0), data.step[0], u, u + uv_step * (size.height / 2), uv_step, 1};
+}
+
+
+/**
+ * Kernels of one pixel format: grey working image of card detection, BGR working image of tree detection.
+ */
+template <int Format> struct FormatKernels;
+
+template <> struct FormatKernels<PIXEL_BGR> {
+    static void gray(const cv::Mat& data, cv::Mat& dst, cv::Size dsize, int blur_size) {
+        grayResizeBlur(data, dst, dsize, blur_size);
+    }
+    static void color(const cv::Mat& data, cv::Mat& dst, cv::Size dsize) {
+        cv::resize(data, dst, dsize, 0, 0, cv::INTER_LINEAR);
+    }
+};
+
+template <> struct FormatKernels<PIXEL_RGBA> {
+    static void gray(const cv::Mat& data, cv::Mat& dst, cv::Size dsize, int blur_size) {
+        grayResizeBlur(data, dst, dsize, blur_size, true);
+    }
+    // resizing is per channel, resized RGBA converted to BGR equals resized BGR
+    static void color(const cv::Mat& data, cv::Mat& dst, cv::Size dsize) {
+        cv::Mat resized = ScratchPool::local().get(ScratchPool::SOURCE_COLOR, dsize, CV_8UC4);
+        cv::resize(data, resized, dsize, 0, 0, cv::INTER_LINEAR);
+        cv::cvtColor(resized, dst, cv::COLOR_RGBA2BGR);
+    }
+};
+
+template <> struct FormatKernels<PIXEL_GRAY> {
+    static void gray(const cv::Mat& data, cv::Mat& dst, cv::Size dsize, int blur_size) {
+        grayResizeBlur(data, dst, dsize, blur_size);
+    }
+    static void color(const cv::Mat& data, cv::Mat& dst, cv::Size dsize) {
+        cv::Mat resized = ScratchPool::local().get(ScratchPool::SOURCE_COLOR, dsize, CV_8U);
+        cv::resize(data, resized, dsize, 0, 0, cv::INTER_LINEAR);
+        cv::cvtColor(resized, dst, cv::COLOR_GRAY2BGR);
+    }
+};
+
+// the Y plane is the grey image
+template <> struct FormatKernels<PIXEL_NV21> {
+    static void gray(const cv::Mat& data, cv::Mat& dst, cv::Size dsize, int blur_size) {
+        grayResizeBlur(data.rowRange(0, data.rows * 2 / 3), dst, dsize, blur_size);
+    }
+    static void color(const cv::Mat& data, cv::Mat& dst, cv::Size dsize) {
+        cv::Size size(data.cols, data.rows * 2 / 3);
+        yuvResizeToBgr(nv21Planes(data, size), size, dst, dsize);
+    }
+};
+
+template <> struct FormatKernels<PIXEL_I420> {
+    static void gray(const cv::Mat& data, cv::Mat& dst, cv::Size dsize, int blur_size) {
+        grayResizeBlur(data.rowRange(0, data.rows * 2 / 3), dst, dsize, blur_size);
+    }
+    static void color(const cv::Mat& data, cv::Mat& dst, cv::Size dsize) {
+        cv::Size size(data.cols, data.rows * 2 / 3);
+        yuvResizeToBgr(i420Planes(data, size), size, dst, dsize);
+    }
+};
+
+
+template <int Format>
+SourceImage SourceImage::specialize(const cv::Mat& data) {
+    SourceImage source;
+    source.data = data;
+    source.pixel_format = Format;
+    source.image_size = Format == PIXEL_NV21 || Format == PIXEL_I420 ? cv::Size(data.cols, data.rows * 2 / 3) : data.size();
+    source.gray_kernel = &FormatKernels<Format>::gray;
+    source.color_kernel = &FormatKernels<Format>::color;
+    return source;
+}
+
+
+/**
+ * Wrap pixels of a known layout and choose the kernels of that layout.
+ * @param data pixels, see PixelFormat for the expected type and shape
+ * @param format PixelFormat
+ * @return wrapped image, the pixels are not copied
+ */
+SourceImage SourceImage::wrap(const cv::Mat& data, int format) {
+    if (format == PIXEL_NV21 || format == PIXEL_I420) {
+        CV_Assert(data.empty() || (data.type() == CV_8UC1 && data.rows % 3 == 0 && data.cols % 2 == 0 && (data.rows / 3) % 2 == 0));
+        CV_Assert(format != PIXEL_I420 || data.isContinuous());
+    } else {
+        static const int channels[] = {3, 4, 1};
+        CV_Assert(format >= PIXEL_BGR && format <= PIXEL_GRAY);
+        CV_Assert(data.empty() || (data.depth() == CV_8U && data.channels() == channels[format]));
+    }
+    switch (format) {
+        case PIXEL_RGBA: return specialize<PIXEL_RGBA>(data);
+        case PIXEL_GRAY: return specialize<PIXEL_GRAY>(data);
+        case PIXEL_NV21: return specialize<PIXEL_NV21>(data);
+        case PIXEL_I420: return specialize<PIXEL_I420>(data);
+        default: return specialize<PIXEL_BGR>(data);
+    }
+}
+
+
+/**
+ * Rotate the image by a multiple of 90 degrees in its own layout, YUV planes stay YUV.
+ * @param rotation clockwise rotation, 0, 90, 180 or 270; anything else returns the image as it is
+ * @param buffer pixels of the rotated image, reused between calls
+ * @return rotated image over 'buffer'
+ */
+SourceImage SourceImage::rotated(int rotation, cv::Mat& buffer) const {
+    if (empty() || (rotation != 90 && rotation != 180 && rotation != 270)) return *this;
+    int code = rotation == 90 ? cv::ROTATE_90_CLOCKWISE : rotation == 180 ? cv::ROTATE_180 : cv::ROTATE_90_COUNTERCLOCKWISE;
+    if (pixel_format != PIXEL_NV21 && pixel_format != PIXEL_I420) {
+        cv::rotate(data, buffer, code);
+        return wrap(buffer, pixel_format);
+    }
+
+    int width = cols(), height = rows();
+    bool swap = code != cv::ROTATE_180;
+    int out_width = swap ? height : width, out_height = swap ? width : height;
+    buffer.create(out_height * 3 / 2, out_width, CV_8U);
+
+    cv::Mat out_y(out_height, out_width, CV_8U, buffer.data);
+    cv::rotate(data.rowRange(0, height), out_y, code);
+    if (pixel_format == PIXEL_NV21) {
+        // interleaved V/U pairs rotate as 2-channel pixels
+        cv::Mat in_chroma(height / 2, width / 2, CV_8UC2, const_cast<uchar*>(data.ptr(height)), data.step[0]);
+        cv::Mat out_chroma(out_height / 2, out_width / 2, CV_8UC2, buffer.ptr(out_height));
+        cv::rotate(in_chroma, out_chroma, code);
+    } else {
+        size_t plane = size_t(width / 2) * (height / 2);
+        for (int p = 0; p < 2; p++) {
+            cv::Mat in_chroma(height / 2, width / 2, CV_8U, data.data + size_t(width) * height + p * plane);
+            cv::Mat out_chroma(out_height / 2, out_width / 2, CV_8U, buffer.data + size_t(out_width) * out_height + p * plane);
+            cv::rotate(in_chroma, out_chroma, code);
+        }
+    }
+    return wrap(buffer, pixel_format);
+}
+
+
+/**
+ * Grey working image of card detection: grey conversion, bilinear resize and Gaussian blur in one pass.
+ * @param dst output CV_8U image, e.g. a ScratchPool view of dsize
+ * @param dsize working size
+ * @param blur_size odd Gaussian kernel size, 1 or less for none
+ */
+void SourceImage::grayResized(cv::Mat& dst, cv::Size dsize, int blur_size) const {
+    gray_kernel(data, dst, dsize, blur_size);
+}
+
+
+/**
+ * BGR working image of tree detection, bilinear resize and colour conversion in one pass over the source.
+ * @param dst output CV_8UC3 image of dsize, e.g. a ScratchPool view
+ * @param dsize working size
+ */
+void SourceImage::colorResized(cv::Mat& dst, cv::Size dsize) const {
+    TRACE_SPAN(span, "colorResized");
+    TRACE_COUNTER(span, "format", pixel_format);
+    dst.create(dsize, CV_8UC3);
+    color_kernel(data, dst, dsize);
+}
+
+
+/**
+ * Full-resolution BGR copy, for tools and debug output only; the pipeline never needs it.
+ * @return BGR image, the wrapped pixels themselves for PIXEL_BGR
+ */
+cv::Mat SourceImage::bgr() const {
+    cv::Mat out;
+    switch (pixel_format) {
+        case PIXEL_RGBA: cv::cvtColor(data, out, cv::COLOR_RGBA2BGR); break;
+        case PIXEL_GRAY: cv::cvtColor(data, out, cv::COLOR_GRAY2BGR); break;
+        case PIXEL_NV21: cv::cvtColor(data, out, cv::COLOR_YUV2BGR_NV21); break;
+        case PIXEL_I420: cv::cvtColor(data, out, cv::COLOR_YUV2BGR_I420); break;
+        default: out = data;
+    }
+    return out;
+}
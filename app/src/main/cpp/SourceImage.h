@@ -0,0 +1,60 @@
+#ifndef SOURCEIMAGE_H
+#define SOURCEIMAGE_H
+
+#include <stdio.h>
+#include <opencv2/core.hpp>
+
+
+/**
+ * Pixel layouts the pipeline reads without converting the whole frame first.
+ */
+enum PixelFormat {
+    PIXEL_BGR = 0,      /**< CV_8UC3, OpenCV's default */
+    PIXEL_RGBA = 1,     /**< CV_8UC4, Android Bitmap ARGB_8888 as converted by Utils.bitmapToMat */
+    PIXEL_GRAY = 2,     /**< CV_8UC1 */
+    PIXEL_NV21 = 3,     /**< CV_8UC1 of height * 3 / 2 rows: Y plane, then interleaved V/U at half resolution */
+    PIXEL_I420 = 4,     /**< CV_8UC1 of height * 3 / 2 rows: Y plane, then U and V planes at half resolution, continuous */
+    PIXEL_FORMAT_COUNT
+};
+
+
+/**
+ * Input image in the layout it arrived in. The layout is dispatched once, when the image is wrapped:
+ * the stages then call the kernels specialized for it, which read the native layout and produce only
+ * the working-resolution images they need, grey for card detection and BGR for tree detection.
+ * No full-resolution colour conversion is made. Only the header is kept, the pixels are shared with the caller.
+ * The layout is always named by the caller (wrap), an OpenCV image does not say whether it is BGR(A) or RGB(A).
+ */
+class SourceImage {
+private:
+    typedef void (*GrayKernel)(const cv::Mat& data, cv::Mat& dst, cv::Size dsize, int blur_size);
+    typedef void (*ColorKernel)(const cv::Mat& data, cv::Mat& dst, cv::Size dsize);
+
+    cv::Mat data;                       /**< Pixels in the source layout */
+    cv::Size image_size;                /**< Size of the image, without the chroma rows of YUV */
+    int pixel_format = PIXEL_BGR;
+    GrayKernel gray_kernel = nullptr;
+    ColorKernel color_kernel = nullptr;
+
+    template <int Format> static SourceImage specialize(const cv::Mat& data);
+
+public:
+    SourceImage() {}
+
+    static SourceImage wrap(const cv::Mat& data, int format);
+
+    int format() const { return pixel_format; }
+    cv::Size size() const { return image_size; }
+    int cols() const { return image_size.width; }
+    int rows() const { return image_size.height; }
+    bool empty() const { return data.empty(); }
+    const cv::Mat& pixels() const { return data; }
+
+    void grayResized(cv::Mat& dst, cv::Size dsize, int blur_size) const;
+    void colorResized(cv::Mat& dst, cv::Size dsize) const;
+    cv::Mat bgr() const;
+    SourceImage rotated(int rotation, cv::Mat& buffer) const;
+};
+
+
+#endif //SOURCEIMAGE_H
@@ -0,0 +1,173 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+
+namespace trace {
+
+std::atomic<bool> enabled(false);
+
+namespace {
+
+    /**
+     * Ring buffer owned by one thread. Only the owner writes events, 'head' is published
+     * with release order so a reader never sees an event before it is complete.
+     */
+    struct ThreadBuffer {
+        std::atomic<bool> in_use;
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> dumped;   /**< Events before it were written by an earlier dump */
+        int tid;
+        Event events[RING_SIZE];
+    };
+
+    ThreadBuffer buffers[MAX_THREADS];
+    std::atomic<int> next_tid(1);
+
+    /**
+     * Claim a free buffer for the calling thread. Lock-free, a slot freed by a finished
+     * thread is reused; its events not dumped yet keep the tid of the finished thread.
+     * Every thread gets a new tid, also when the system reuses its thread id.
+     */
+    ThreadBuffer* claimBuffer() {
+        for (int i = 0; i < MAX_THREADS; i++) {
+            bool expected = false;
+            if (buffers[i].in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                buffers[i].tid = next_tid.fetch_add(1, std::memory_order_relaxed);
+                return &buffers[i];
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * Releases the buffer slot when its thread exits.
+     */
+    struct BufferOwner {
+        ThreadBuffer* buffer = nullptr;
+        bool claimed = false;
+        ~BufferOwner() {
+            if (buffer) buffer->in_use.store(false, std::memory_order_release);
+        }
+    };
+
+    thread_local BufferOwner owner;
+
+    void writeJsonString(std::ostream& out, const char* str) {
+        out << '"';
+        for (const char* c = str; *c; c++) {
+            if (*c == '"' || *c == '\\') out << '\\';
+            out << *c;
+        }
+        out << '"';
+    }
+}
+
+
+/**
+ * Turn recording on or off. Spans which are already open keep their state.
+ * @param on true to record spans
+ */
+void setEnabled(bool on) {
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+
+/**
+ * Monotonic time used for all spans.
+ * @return nanoseconds from an unspecified start
+ */
+uint64_t nowNs() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+
+/**
+ * Store finished span into the ring buffer of the calling thread.
+ * If all buffers are taken by other threads the event is dropped.
+ * @param event finished span
+ */
+void record(const Event& event) {
+    if (!owner.claimed) {
+        owner.buffer = claimBuffer();
+        owner.claimed = true;
+    }
+    ThreadBuffer* buffer = owner.buffer;
+    if (!buffer) return;
+
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    Event& stored = buffer->events[head % RING_SIZE];
+    stored = event;
+    stored.tid = buffer->tid;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+
+/**
+ * Drop all recorded events. Call only while no pipeline is running.
+ */
+void clear() {
+    for (int i = 0; i < MAX_THREADS; i++) {
+        buffers[i].head.store(0, std::memory_order_release);
+        buffers[i].dumped.store(0, std::memory_order_release);
+    }
+}
+
+
+/**
+ * Write the spans recorded since the previous dump as Chrome trace JSON (chrome://tracing, ui.perfetto.dev),
+ * every span is written once. Spans become complete events ("ph":"X"), counters become their args.
+ * Dump while the pipeline is idle, a thread which wraps its ring during the dump can tear its oldest events.
+ * Only one dump at a time.
+ * @param out output stream
+ */
+void dumpChromeJson(std::ostream& out) {
+    int pid = int(getpid());
+    bool first = true;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (int i = 0; i < MAX_THREADS; i++) {
+        ThreadBuffer& buffer = buffers[i];
+        uint64_t head = buffer.head.load(std::memory_order_acquire);
+        uint64_t begin = std::max(buffer.dumped.load(std::memory_order_relaxed),
+                                  head > uint64_t(RING_SIZE) ? head - RING_SIZE : 0);
+        buffer.dumped.store(head, std::memory_order_relaxed);
+
+        for (uint64_t n = begin; n < head; n++) {
+            const Event& event = buffer.events[n % RING_SIZE];
+            if (!first) out << ",";
+            first = false;
+
+            out << "{\"name\":";
+            writeJsonString(out, event.name);
+            out << ",\"cat\":\"tree\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << event.tid;
+            out << ",\"ts\":" << event.start_ns / 1000 << "." << (event.start_ns % 1000) / 100;
+            out << ",\"dur\":" << event.duration_ns / 1000 << "." << (event.duration_ns % 1000) / 100;
+            out << ",\"args\":{";
+            for (int c = 0; c < event.counter_count; c++) {
+                if (c > 0) out << ",";
+                writeJsonString(out, event.counter_names[c]);
+                out << ":" << event.counter_values[c];
+            }
+            out << "}}";
+        }
+    }
+    out << "]}";
+}
+
+
+/**
+ * Chrome trace JSON of the spans recorded since the previous dump.
+ * @return JSON document
+ */
+std::string dumpChromeJson() {
+    std::ostringstream out;
+    dumpChromeJson(out);
+    return out.str();
+}
+
+} // namespace trace
@@ -0,0 +1,100 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <iostream>
+
+/**
+ * Build switch for the trace spans. With 0 the TRACE_* macros expand to nothing,
+ * with 1 every span costs one relaxed atomic load while tracing is disabled at runtime.
+ * Counter values are evaluated only for recording spans.
+ */
+#ifndef TREE_TRACE
+#define TREE_TRACE 1
+#endif
+
+
+namespace trace {
+
+const int MAX_COUNTERS = 8;         /**< Counters stored with one span */
+const int RING_SIZE = 2048;         /**< Events kept per thread, older ones are overwritten */
+const int MAX_THREADS = 32;         /**< Threads which can record at the same time */
+
+/**
+ * One finished span. Names must be string literals, only the pointers are stored.
+ */
+struct Event {
+    const char* name;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    int counter_count;
+    const char* counter_names[MAX_COUNTERS];
+    int64_t counter_values[MAX_COUNTERS];
+    int tid;                /**< Trace thread id, set by record() */
+};
+
+extern std::atomic<bool> enabled;
+
+inline bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+void setEnabled(bool on);
+
+uint64_t nowNs();
+void record(const Event& event);
+void clear();
+void dumpChromeJson(std::ostream& out);
+std::string dumpChromeJson();
+
+
+/**
+ * Scoped span. Measures time from construction to destruction and stores it
+ * with its counters into the ring buffer of the calling thread.
+ */
+class Span {
+private:
+    Event event;
+    bool active;
+
+public:
+    explicit Span(const char* name) : active(isEnabled()) {
+        if (active) {
+            event.name = name;
+            event.counter_count = 0;
+            event.start_ns = nowNs();
+        }
+    }
+    ~Span() {
+        if (active) {
+            event.duration_ns = nowNs() - event.start_ns;
+            record(event);
+        }
+    }
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    bool isActive() const { return active; }
+
+    void counter(const char* name, int64_t value) {
+        if (active && event.counter_count < MAX_COUNTERS) {
+            event.counter_names[event.counter_count] = name;
+            event.counter_values[event.counter_count] = value;
+            event.counter_count++;
+        }
+    }
+};
+
+} // namespace trace
+
+
+#if TREE_TRACE
+#define TRACE_SPAN(var, name) trace::Span var(name)
+#define TRACE_COUNTER(var, name, value) do { if (var.isActive()) var.counter(name, int64_t(value)); } while (0)
+#else
+#define TRACE_SPAN(var, name)
+#define TRACE_COUNTER(var, name, value) ((void)0)
+#endif
+
+
+#endif //TRACE_H
@@ -1,22 +1,36 @@
 #include "TreeDetection.h"
+#include "Trace.h"
+#include "ScratchPool.h"
+#include "DebugCapture.h"
+
+static const uint64_t GRABCUT_SEED = 0xffffffff;    // initial state of cv::RNG, kmeans of the GMMs starts from it
+static const cv::Size TREE_KERNEL(3, 7);        // open and close of the trunk mask, removes thin branches and fills bark gaps
+static const double HOUGH_MIN_THETA = -1;       // line normals within 1 rad of horizontal, trunk edges are near vertical
+static const double HOUGH_MAX_THETA = 1;
 
 /**
  * Constructor. Resize original image to defined width. Resize and order card points.
- * @param source_img original input image with tree and card
+ * @param source_img original input image with tree and card, any PixelFormat
  * @param card_pts vector of card points, corresponds to the original image
+ * @param config detection parameters
  */
-TreeDetection::TreeDetection(cv::Mat source_img, std::vector<cv::Point2f> card_pts) {
-    // resize image
-    ratio = float(resize_to_width / source_img.cols);
-    int new_height = round(ratio * source_img.rows);
-    cv::resize(source_img, image, cv::Size(resize_to_width, new_height), cv::INTER_LINEAR);
+TreeDetection::TreeDetection(const SourceImage& source_img, const std::vector<cv::Point2f>& card_pts, const DetectorConfig& config)
+        : tree_mask(ScratchPool::local().tree().mask) {
+    this->config = config;
+    this->resize_to_width = float(config.tree_resize_width);
+
+    // resize image, BGR whatever the source layout
+    ratio = float(resize_to_width / source_img.cols());
+    int new_height = round(ratio * source_img.rows());
+    image = ScratchPool::local().get(ScratchPool::TREE_IMAGE, new_height, int(resize_to_width), CV_8UC3);
+    source_img.colorResized(image, cv::Size(resize_to_width, new_height));
 
-    cv::GaussianBlur(image, image, cv::Size(3, 3), 0);
+    cv::GaussianBlur(image, image, cv::Size(config.tree_blur, config.tree_blur), 0);
 
     // resize card points to image
-    std::vector<cv::Point2f> pts;
-    for (int i = 0; i < int(card_pts.size()); i++) {
-        pts.push_back(cv::Point2f(card_pts[i].x * ratio, card_pts[i].y * ratio));
+    std::array<cv::Point2f, 4> pts;
+    for (int i = 0; i < 4; i++) {
+        pts[i] = cv::Point2f(card_pts.at(i).x * ratio, card_pts.at(i).y * ratio);
     }
     // order card points
     this->card_points = orderCardPoints(pts);
@@ -30,21 +44,24 @@ TreeDetection::TreeDetection(cv::Mat source_img, std::vector<cv::Point2f> card_p
  * @return 0 if detection is successful, -1 otherwise
  */
 int TreeDetection::findTree(int position) {
+    TRACE_SPAN(span, "findTree");
+    TRACE_COUNTER(span, "position", position);
     // crop image above or under card
     if(position == 1){
-        roi = cv::Rect2f(cv::Point2f(0,0), cv::Point2f(resize_to_width, card_points["tl"].y));
+        roi = cv::Rect2f(cv::Point2f(0,0), cv::Point2f(resize_to_width, card_points.tl.y));
     }else{
-        roi = cv::Rect2f(cv::Point2f(0,card_points["br"].y), cv::Point2f(resize_to_width, image.rows-1));
+        roi = cv::Rect2f(cv::Point2f(0,card_points.br.y), cv::Point2f(resize_to_width, image.rows-1));
     }
 
     // init tree mask
     image_roi = image(roi);
-    tree_mask_roi = cv::Mat::zeros(image_roi.rows, image_roi.cols, CV_8U);
+    TRACE_COUNTER(span, "roi_width", image_roi.cols);
+    TRACE_COUNTER(span, "roi_height", image_roi.rows);
 
     // tree segmentation
     cv::Point2f center = cv::Point2f(
-            (this->card_points["tl"].x + this->card_points["br"].x) / 2,
-            (this->card_points["tl"].y + this->card_points["br"].y) / 2);
+            (this->card_points.tl.x + this->card_points.br.x) / 2,
+            (this->card_points.tl.y + this->card_points.br.y) / 2);
 
     doGrabcut(center);
 
@@ -57,53 +74,68 @@ int TreeDetection::findTree(int position) {
 
 /**
  * Create input mask for graph cut algorithm (green background, foreground behind card).
- * Run grabcut, save output binary tree mask.
+ * Run grabcut and save output binary tree mask.
  * @param card_center center of the detected card
  */
 void TreeDetection::doGrabcut(cv::Point2f card_center) {
-    cv::Mat mask(image_roi.rows, image_roi.cols, CV_8U, cv::Scalar::all(cv::GC_PR_BGD));
-    cv::Mat bgd_model = cv::Mat();
-    cv::Mat fgd_model = cv::Mat();
+    TRACE_SPAN(span, "doGrabcut");
+    TRACE_COUNTER(span, "roi_pixels", image_roi.total());
+    ScratchPool& pool = ScratchPool::local();
+
+    // mask green color as background
+    cv::Mat hsv = pool.get(ScratchPool::GRABCUT_HSV, image_roi.size(), CV_8UC3);
+    cv::Mat green = pool.get(ScratchPool::GRABCUT_GREEN, image_roi.size(), CV_8U);
+    static const cv::Mat green_kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
+    cv::cvtColor(image_roi, hsv, cv::COLOR_BGR2HSV);
+    cv::inRange(hsv, config.green_lower, config.green_upper, green);
+    cv::morphologyEx(green, green, cv::MORPH_OPEN, green_kernel);
+
+    cv::Mat mask = pool.get(ScratchPool::GRABCUT_MASK, image_roi.size(), CV_8U);
+    // grabcut GMM models, 5 components with 13 values each
+    cv::Mat bgd_model = pool.get(ScratchPool::GRABCUT_BGD_MODEL, 1, 13 * 5, CV_64F);
+    cv::Mat fgd_model = pool.get(ScratchPool::GRABCUT_FGD_MODEL, 1, 13 * 5, CV_64F);
+    mask.setTo(cv::Scalar::all(cv::GC_PR_BGD));
 
     // draw wider GC_PR_FGD vertical line in the center of the card
-    int line_width = round(0.11 * image_roi.cols);
-    for (int i = 0; i < roi.height; i++) {
-        for (int j = -line_width; j < line_width; j++) {
-            mask.at<uchar>(i, card_center.x + j) = cv::GC_PR_FGD;
-        }
+    int line_width = round(config.seed_line_width * image_roi.cols);
+    int center = int(card_center.x);
+    int seed_start = std::max(center - line_width, 0);
+    int seed_end = std::min(center + line_width, mask.cols);
+    if (seed_end > seed_start) {
+        mask.colRange(seed_start, seed_end).setTo(cv::Scalar::all(cv::GC_PR_FGD));
     }
 
     // mask green color as background GC_BGD
-    cv::Mat hsv;
-    cv::Mat green;
-    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
-    cv::cvtColor(image_roi, hsv, cv::COLOR_BGR2HSV);
-    cv::inRange(hsv, cv::Scalar(38, 55, 55), cv::Scalar(95, 255, 255), green);
-    cv::morphologyEx(green, green, cv::MORPH_OPEN, kernel);
     mask.setTo(cv::Scalar::all(cv::GC_BGD), green);
 
-    grabCut(image_roi, mask, cv::Rect(0, 0, image_roi.cols-1, image_roi.rows-1), bgd_model, fgd_model, 5, cv::GC_INIT_WITH_MASK );
-
-
-    // create a binary mask from the segmentation
-    tree_mask_roi = (mask == cv::GC_FGD) | (mask == cv::GC_PR_FGD);
-    kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 7));
-    cv::morphologyEx(tree_mask_roi, tree_mask_roi, cv::MORPH_OPEN, kernel, cv::Point(-1, -1), 1);
-    cv::morphologyEx(tree_mask_roi, tree_mask_roi, cv::MORPH_CLOSE, kernel, cv::Point(-1, -1), 1);
-
-
-    if (TREE_SHOW_IMAGES) {
-        // mask foreground pixels of the original image
-        cv::Mat masked_foreground_image = cv::Mat();
-        cv::bitwise_and(image_roi, image_roi, masked_foreground_image, tree_mask_roi);
-
-        cv::imshow("Grabcut input mask", mask);
-        cv::imshow("masked_foreground_image", masked_foreground_image);
-        cv::imshow("tree_mask", tree_mask_roi);
-        cv::imshow("green", green);
-        cv::waitKey(0);
-    }
-
+    // grabcut labels 0-3 scaled to visible grey levels
+    DEBUG_CAPTURE("grabcut_seed", [seed = mask.clone()]() { cv::Mat out; seed.convertTo(out, CV_8U, 85); return out; });
+    DEBUG_CAPTURE("green_mask", [green = green.clone()]() { return green; });
+
+    // the GMM initialisation draws from the RNG of the thread, reseed so the result does not depend on earlier calls;
+    // the caller's RNG state is restored afterwards
+    uint64_t caller_rng_state = cv::theRNG().state;
+    cv::theRNG().state = GRABCUT_SEED;
+    grabCut(image_roi, mask, cv::Rect(0, 0, image_roi.cols-1, image_roi.rows-1), bgd_model, fgd_model,
+            config.grabcut_iterations, cv::GC_INIT_WITH_MASK);
+    cv::theRNG().state = caller_rng_state;
+
+
+    // trunk mask as row runs, GC_FGD and GC_PR_FGD are foreground
+    tree_mask.fromLabels(mask, 0, image_roi.cols);
+    RunMaskScratch& scratch = pool.tree().mask_scratch;
+    tree_mask.open(TREE_KERNEL, scratch);
+    tree_mask.close(TREE_KERNEL, scratch);
+    TRACE_COUNTER(span, "mask_runs", tree_mask.runCount());
+    TRACE_COUNTER(span, "mask_bytes", tree_mask.bytes());
+
+    // foreground pixels of the image
+    DEBUG_CAPTURE("tree_mask", [roi = image_roi.clone(), mask = tree_mask]() {
+        cv::Mat dense, out;
+        mask.toMat(dense);
+        cv::bitwise_and(roi, roi, out, dense);
+        return out;
+    });
 }
 
 
@@ -146,26 +178,112 @@ int TreeDetection::lines_intersect(cv::Vec2f line1, cv::Vec2f line2){
 
 
 /**
- * Find lines that respresent tree edges.
- * Uses Canny edge detecor and Hough transformation on tree mask to find lines.
- * @return 0 if lines were found, -1 otherwise
+ * Standard Hough transform of edge points, the same votes, peaks and order as cv::HoughLines with
+ * rho 1 and theta CV_PI/180, without the edge image: the points come from the run boundaries.
+ * @param points edge points
+ * @param size image size, sets the rho range
+ * @param threshold minimal votes, exclusive
+ * @param min_theta smallest line angle
+ * @param max_theta largest line angle
+ * @param lines output lines (rho, theta), most votes first
  */
-int TreeDetection::findLines(){
+void houghLines(const std::vector<cv::Point>& points, cv::Size size, int threshold,
+                double min_theta, double max_theta, std::vector<cv::Vec2f>& lines) {
+    const double theta = CV_PI / 180;
+    int numangle = cvRound((max_theta - min_theta) / theta);
+    int numrho = (size.width + size.height) * 2 + 1;
+
+    ScratchPool::TreeBuffers& buffers = ScratchPool::local().tree();
+    std::vector<float>& tab_sin = buffers.hough_sin;
+    std::vector<float>& tab_cos = buffers.hough_cos;
+    tab_sin.resize(numangle);
+    tab_cos.resize(numangle);
+    float angle = float(min_theta);
+    for (int n = 0; n < numangle; angle += float(theta), n++) {
+        tab_sin[n] = float(sin(double(angle)));
+        tab_cos[n] = float(cos(double(angle)));
+    }
+
+    // one row per angle with a zero border around, as in OpenCV
+    cv::Mat accum = ScratchPool::local().get(ScratchPool::HOUGH_ACCUMULATOR, numangle + 2, numrho + 2, CV_32S);
+    accum.setTo(cv::Scalar::all(0));
+    for (const cv::Point& p : points) {
+        for (int n = 0; n < numangle; n++) {
+            int r = cvRound(p.x * tab_cos[n] + p.y * tab_sin[n]) + (numrho - 1) / 2;
+            accum.at<int>(n + 1, r + 1)++;
+        }
+    }
+
+    // local maxima over rho and angle
+    std::vector<int>& peaks = buffers.hough_peaks;
+    peaks.clear();
+    const int* votes = accum.ptr<int>(0);
+    const int step = numrho + 2;
+    for (int r = 0; r < numrho; r++) {
+        for (int n = 0; n < numangle; n++) {
+            int base = (n + 1) * step + r + 1;
+            if (votes[base] > threshold && votes[base] > votes[base - 1] && votes[base] >= votes[base + 1] &&
+                votes[base] > votes[base - step] && votes[base] >= votes[base + step]) {
+                peaks.push_back(base);
+            }
+        }
+    }
+    std::sort(peaks.begin(), peaks.end(), [votes](int a, int b) { return votes[a] > votes[b] || (votes[a] == votes[b] && a < b); });
 
-    cv::Mat canny_out = cv::Mat::zeros(this->image_roi.size(), CV_8UC1);
+    lines.clear();
+    for (int base : peaks) {
+        int n = base / step - 1;
+        int r = base - (n + 1) * step - 1;
+        lines.push_back(cv::Vec2f((r - (numrho - 1) * 0.5f), float(min_theta) + n * float(theta)));
+    }
+}
 
-    // use canny edge detector on tree mask
-    cv::Canny(tree_mask_roi, canny_out, 50, 200, 3);
 
-    // use hough transform on Canny edges to find lines
-    std::vector<cv::Vec2f> lines;
-    cv::HoughLines(canny_out, lines, 1, CV_PI/180, 50, 0, 0, -1, 1 );
+/**
+ * Find lines that respresent tree edges.
+ * Uses the boundary of the tree mask runs and Hough transformation to find lines.
+ * @return 0 if lines were found, -1 otherwise
+ */
+int TreeDetection::findLines(){
+    TRACE_SPAN(span, "findLines");
+
+    // Canny edges of the mask, computed on the runs
+    ScratchPool::TreeBuffers& buffers = ScratchPool::local().tree();
+    std::vector<cv::Point>& edges = buffers.edges;
+    tree_mask.boundary(config.canny_low, config.canny_high, edges, buffers.mask_scratch);
+    TRACE_COUNTER(span, "edge_points", edges.size());
+
+    // use hough transform on the edges to find lines
+    std::vector<cv::Vec2f>& lines = buffers.hough_lines;
+    houghLines(edges, image_roi.size(), config.hough_threshold, HOUGH_MIN_THETA, HOUGH_MAX_THETA, lines);
+    TRACE_COUNTER(span, "hough_lines", lines.size());
+    DEBUG_CAPTURE("canny", [size = image_roi.size(), edges]() {
+        cv::Mat out(size, CV_8U, cv::Scalar::all(0));
+        for (const cv::Point& p : edges) out.at<uchar>(p) = 255;
+        return out;
+    });
+    if (capture::isEnabled()) {
+        // line end points are computed now, only drawing is left for the dump
+        std::vector<cv::Point2f> ends;
+        for (const cv::Vec2f& line : lines) {
+            cv::Point2f a, b;
+            linePoints(line, a, b);
+            ends.push_back(a);
+            ends.push_back(b);
+        }
+        capture::add("hough_lines", [roi = image_roi.clone(), ends]() {
+            cv::Mat out = roi.clone();
+            for (size_t i = 0; i + 1 < ends.size(); i += 2) {
+                cv::line(out, ends[i], ends[i + 1], cv::Scalar(0, 0, 255), 1, cv::LINE_AA);
+            }
+            return out;
+        });
+    }
     if (lines.size() <= 1) {
         std::cerr << TAG << ": Couldn't detect tree lines with Hough" << std::endl;
         return -1;
     }
 
-    //cv::imshow("canny_out", canny_out);
     cv::Point2f pt1, pt2, pt3, pt4;
     linePoints(lines[0], pt1, pt2);
     int intersect = 0;
@@ -194,25 +312,9 @@ int TreeDetection::findLines(){
     left_tree_line = std::make_tuple(pt1+shift_p, pt2+shift_p);
     right_tree_line = std::make_tuple(pt3+shift_p, pt4+shift_p);
 
-
-    if (TREE_SHOW_IMAGES) {
-        cv::imshow("canny_out", canny_out);
-
-        cv::Mat hough_lines = image.clone();
-        for (size_t i = 0; i < lines.size(); i++) {
-            cv::Point2f pt1, pt2;
-            linePoints(lines[i], pt1, pt2);
-            cv::line(hough_lines, pt1, pt2, cv::Scalar(0, 0, 255), 1, cv::LINE_AA);
-        }
-        cv::imshow("hough_lines", hough_lines);
-
-        cv::Mat line_output = image.clone();
-        cv::line(line_output, std::get<0>(left_tree_line), std::get<1>(left_tree_line), cv::Scalar(0, 0, 255), 1, cv::LINE_AA);
-        cv::line(line_output, std::get<0>(right_tree_line), std::get<1>(right_tree_line), cv::Scalar(0, 0, 255), 1, cv::LINE_AA);
-        cv::imshow("line_output", line_output);
-
-        cv::waitKey(0);
-    }
+    DEBUG_CAPTURE("tree_lines", [image = image.clone(), card = card_points, left = left_tree_line, right = right_tree_line]() {
+        return drawTreeOutput(image, card, left, right);
+    });
 
     return 0;
 }
@@ -224,15 +326,29 @@ int TreeDetection::findLines(){
  * @return output image
  */
 cv::Mat TreeDetection::getOutputImage() {
+    return drawTreeOutput(image, card_points, left_tree_line, right_tree_line);
+}
+
+
+/**
+ * Draw card points and tree lines into a copy of the image.
+ * @param image resized input image
+ * @param card ordered card points
+ * @param left left tree line
+ * @param right right tree line
+ * @return output image
+ */
+cv::Mat drawTreeOutput(const cv::Mat& image, const CardPoints& card, const std::tuple<cv::Point2f, cv::Point2f>& left,
+                       const std::tuple<cv::Point2f, cv::Point2f>& right) {
     cv::Mat output_image = image.clone();
     // draw card points
-    cv::circle(output_image, card_points["tl"], 2, cv::Scalar(0, 0, 255), -1);
-    cv::circle(output_image, card_points["tr"], 2, cv::Scalar(0, 0, 255), -1);
-    cv::circle(output_image, card_points["bl"], 2, cv::Scalar(0, 255, 0), -1);
-    cv::circle(output_image, card_points["br"], 2, cv::Scalar(0, 255, 0), -1);
+    cv::circle(output_image, card.tl, 2, cv::Scalar(0, 0, 255), -1);
+    cv::circle(output_image, card.tr, 2, cv::Scalar(0, 0, 255), -1);
+    cv::circle(output_image, card.bl, 2, cv::Scalar(0, 255, 0), -1);
+    cv::circle(output_image, card.br, 2, cv::Scalar(0, 255, 0), -1);
     // draw tree lines
-    cv::line(output_image, std::get<0>(this->left_tree_line), std::get<1>(this->left_tree_line), cv::Scalar(0, 0, 255), 1, cv::LINE_AA);
-    cv::line(output_image, std::get<0>(this->right_tree_line), std::get<1>(this->right_tree_line), cv::Scalar(0, 0, 255), 1, cv::LINE_AA);
+    cv::line(output_image, std::get<0>(left), std::get<1>(left), cv::Scalar(0, 0, 255), 1, cv::LINE_AA);
+    cv::line(output_image, std::get<0>(right), std::get<1>(right), cv::Scalar(0, 0, 255), 1, cv::LINE_AA);
 
     return output_image;
 }
@@ -244,13 +360,10 @@ cv::Mat TreeDetection::getOutputImage() {
  * @return tree lines (4 points)
  */
 std::vector<cv::Point2f> TreeDetection::getTreeLines() {
-    std::vector<cv::Point2f> out;
-    out.push_back(std::get<0>(left_tree_line) / ratio);
-    out.push_back(std::get<1>(left_tree_line) / ratio);
-    out.push_back(std::get<0>(right_tree_line) / ratio);
-    out.push_back(std::get<1>(right_tree_line) / ratio);
-
-    return out;
+    return {std::get<0>(left_tree_line) / ratio,
+            std::get<1>(left_tree_line) / ratio,
+            std::get<0>(right_tree_line) / ratio,
+            std::get<1>(right_tree_line) / ratio};
 };
 
 
@@ -287,7 +400,7 @@ void TreeDetection::linePoints(cv::Vec2f line, cv::Point2f& pt1, cv::Point2f& pt
 
 }
 
-cv::Point2f TreeDetection::intersection(std::tuple<cv::Point2f, cv::Point2f> image_line, std::tuple<cv::Point2f, cv::Point2f> line){
+cv::Point2f TreeDetection::intersection(const std::tuple<cv::Point2f, cv::Point2f>& image_line, const std::tuple<cv::Point2f, cv::Point2f>& line){
     // Line AB represented as a1x + b1y = c1
     double a1 = std::get<1>(image_line).y - std::get<0>(image_line).y;
     double b1 = std::get<0>(image_line).x - std::get<1>(image_line).x;
@@ -314,36 +427,28 @@ cv::Point2f TreeDetection::intersection(std::tuple<cv::Point2f, cv::Point2f> ima
 /**
  * Order card points based on distance from origin.
  * @param c_points unordered card points
- * @return dictionary with ordered points, top-left = 'tl', bottom-right = 'br', tr, bl
+ * @return ordered points, top-left = 'tl', bottom-right = 'br', tr, bl
  */
-std::map<std::string, cv::Point2f> orderCardPoints(std::vector<cv::Point2f> c_points) {
+CardPoints orderCardPoints(const std::array<cv::Point2f, 4>& c_points) {
 
-    std::vector<float> distances;
-    std::map<std::string, cv::Point2f> card_pts;
+    std::array<float, 4> distances;
+    std::array<int, 4> order = {0, 1, 2, 3};
+    CardPoints card_pts;
 
     // compute distances
-    for (cv::Point2f p : c_points) {
-        float dist = (p.x * p.x) + (p.y * p.y);
-        distances.push_back(dist);
+    for (int i = 0; i < 4; i++) {
+        distances[i] = (c_points[i].x * c_points[i].x) + (c_points[i].y * c_points[i].y);
     }
     //sort
-    std::vector<float> sorted_distances(distances);
-    std::sort(sorted_distances.begin(), sorted_distances.end());
+    std::stable_sort(order.begin(), order.end(), [&distances](int a, int b) { return distances[a] < distances[b]; });
     //save points
-    auto it = find(distances.begin(), distances.end(), sorted_distances.at(0));
-    card_pts["tl"] = c_points.at(it - distances.begin());
-
-    it = find(distances.begin(), distances.end(), sorted_distances.at(1));
-    card_pts["bl"] = c_points.at(it - distances.begin());
-
-    it = find(distances.begin(), distances.end(), sorted_distances.at(2));
-    card_pts["tr"] = c_points.at(it - distances.begin());
-
-    it = find(distances.begin(), distances.end(), sorted_distances.at(3));
-    card_pts["br"] = c_points.at(it - distances.begin());
+    card_pts.tl = c_points[order[0]];
+    card_pts.bl = c_points[order[1]];
+    card_pts.tr = c_points[order[2]];
+    card_pts.br = c_points[order[3]];
 
-    if (card_pts["bl"].x > card_pts["tr"].x) {
-        std::swap(card_pts["bl"], card_pts["tr"]);
+    if (card_pts.bl.x > card_pts.tr.x) {
+        std::swap(card_pts.bl, card_pts.tr);
     }
 
     return card_pts;
@@ -393,15 +498,17 @@ double distanceToLine(cv::Point2f line_start, cv::Point2f line_end, cv::Point2f
  * @param input input image to mask
  * @return image with white mask of card
  */
-cv::Mat maskCard(std::map<std::string, cv::Point2f> points, cv::Mat input, int margin) {
+cv::Mat maskCard(const CardPoints& points, cv::Mat input, int margin) {
 
-    std::vector<cv::Point> pts;
-    pts.push_back(cv::Point(points["tl"].x - margin, points["tl"].y - margin));
-    pts.push_back(cv::Point(points["tr"].x + margin, points["tr"].y - margin));
-    pts.push_back(cv::Point(points["br"].x + margin, points["br"].y + margin));
-    pts.push_back(cv::Point(points["bl"].x - margin, points["bl"].y + margin));
+    std::array<cv::Point, 4> pts = {
+            cv::Point(points.tl.x - margin, points.tl.y - margin),
+            cv::Point(points.tr.x + margin, points.tr.y - margin),
+            cv::Point(points.br.x + margin, points.br.y + margin),
+            cv::Point(points.bl.x - margin, points.bl.y + margin)};
+    const cv::Point* polygon = pts.data();
+    int count = int(pts.size());
 
-    cv::fillPoly(input, std::vector<cv::Point>{pts}, cv::Scalar(255));
+    cv::fillPoly(input, &polygon, &count, 1, cv::Scalar(255));
 
     return input;
 }
\ No newline at end of file
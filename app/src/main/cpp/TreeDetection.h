@@ -4,16 +4,28 @@
 #include <stdio.h>
 #include <string>
 #include <iostream>
-#include <map>
+#include <array>
 #include <iterator>
 
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 
-#define TREE_SHOW_IMAGES 0
+#include "DetectorConfig.h"
+#include "SourceImage.h"
+#include "RunMask.h"
 
 
+/**
+ * Card corners ordered by position in the image.
+ */
+struct CardPoints {
+    cv::Point2f tl;     /**< Top left */
+    cv::Point2f tr;     /**< Top right */
+    cv::Point2f br;     /**< Bottom right */
+    cv::Point2f bl;     /**< Bottom left */
+};
+
 class TreeDetection {
 private:
     std::string TAG = "TreeDetection";
@@ -21,11 +33,12 @@ private:
     cv::Mat image;      /**< Input image resized to 'resize_to_width' */
     cv::Mat image_roi;  /**< Cropped resized image */   
     cv::Rect2f roi;     /**< Region of interest above or under card */  
-    float resize_to_width = 600;    /**< The width to which the input image is resized */
+    float resize_to_width;          /**< The width to which the input image is resized */
     float ratio;        /**< Ratio of resized width and original width */
 
-    cv::Mat tree_mask_roi;  /**< Binary mask of the tree */
-    std::map<std::string, cv::Point2f> card_points; /**< Ordered card points in map. Top left point = 'tl', bottom right = 'br' */
+    RunMask& tree_mask;     /**< Mask of the tree in the ROI, as row runs, kept in the ScratchPool of the thread and overwritten by its next findTree */
+    CardPoints card_points; /**< Ordered card points. Top left point = 'tl', bottom right = 'br' */
+    DetectorConfig config;  /**< Grabcut, colour and line detection parameters */
     std::tuple<cv::Point2f, cv::Point2f> left_tree_line, right_tree_line;   /**< The edge of tree represented by a line. Tuple points, top point first */
     //std::tuple<cv::Point2f, cv::Point2f> left_tree_line2, right_tree_line2;
 
@@ -35,15 +48,21 @@ private:
     int lines_intersect(cv::Vec2f line1, cv::Vec2f line2);
 
     void linePoints(cv::Vec2f line, cv::Point2f& pt1, cv::Point2f& pt2);
-    cv::Point2f intersection(std::tuple<cv::Point2f, cv::Point2f> image_line, std::tuple<cv::Point2f, cv::Point2f> line);
+    cv::Point2f intersection(const std::tuple<cv::Point2f, cv::Point2f>& image_line, const std::tuple<cv::Point2f, cv::Point2f>& line);
 public:
-    TreeDetection(cv::Mat source_img, std::vector<cv::Point2f> card_points);
+    TreeDetection(const SourceImage& source_img, const std::vector<cv::Point2f>& card_points, const DetectorConfig& config = DetectorConfig());
     ~TreeDetection(){};
 
     int findTree(int position);
 
     cv::Mat getOutputImage();
-    cv::Mat getTreeMask(){return tree_mask_roi;}
+    /**
+     * Trunk mask of the last findTree on this thread. The reference points into the thread's ScratchPool,
+     * shared by all TreeDetections of the thread: the next findTree on the thread overwrites it, and it must
+     * not be read on another thread. Copy the RunMask to keep it.
+     * @return mask of the tree in the ROI
+     */
+    const RunMask& getTreeMask(){return tree_mask;}
     std::vector<cv::Point2f> getTreeLines();
     //std::tuple<cv::Point2f, cv::Point2f> getLeftTreeLine(){return this->left_tree_line;};
     //std::tuple<cv::Point2f, cv::Point2f> getRightTreeLine(){return this->right_tree_line;};
@@ -52,8 +71,12 @@ public:
 
 double pointsDistance(cv::Point2f p1, cv::Point2f p2);
 double distanceToLine(cv::Point2f line_start, cv::Point2f line_end, cv::Point2f point);
-std::map<std::string, cv::Point2f> orderCardPoints(std::vector<cv::Point2f> points);
-cv::Mat maskCard(std::map<std::string, cv::Point2f> points, cv::Mat input, int margin = 0);
+CardPoints orderCardPoints(const std::array<cv::Point2f, 4>& points);
+void houghLines(const std::vector<cv::Point>& points, cv::Size size, int threshold,
+                double min_theta, double max_theta, std::vector<cv::Vec2f>& lines);
+cv::Mat maskCard(const CardPoints& points, cv::Mat input, int margin = 0);
+cv::Mat drawTreeOutput(const cv::Mat& image, const CardPoints& card, const std::tuple<cv::Point2f, cv::Point2f>& left,
+                       const std::tuple<cv::Point2f, cv::Point2f>& right);
 
 
 #endif //TREEDETECTION_H
\ No newline at end of file
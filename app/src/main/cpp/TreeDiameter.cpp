@@ -1,12 +1,17 @@
 #include "TreeDiameter.h"
 
+static const double CARD_WIDTH_MM = 85.6;    // ID-1 card width
+
 /**
  * Compute tree diameter.
- * @param treePts 4 tree points which represent 2 lines above card
+ * @param tree_pts 4 tree points which represent 2 lines above card
  * @param cardPts 4 card points
  * @return diameter of tree
  */
-float getTreeWidth( std::vector<cv::Point2f> treePts, std::vector<cv::Point2f> cardPts) {
+float getTreeWidth(const std::vector<cv::Point2f>& tree_pts, const std::vector<cv::Point2f>& cardPts) {
+
+    // lines are reordered in place, work on a copy on the stack
+    std::array<cv::Point2f, 4> treePts = {tree_pts.at(0), tree_pts.at(1), tree_pts.at(2), tree_pts.at(3)};
 
     // treePts[0] - top coordinate of left line
     // treePts[1] - bottom coordinate of left line
@@ -44,7 +49,7 @@ float getTreeWidth( std::vector<cv::Point2f> treePts, std::vector<cv::Point2f> c
     // compute first point of line in the middle
     cv::Point2f startPt, endPt;
     if (int(toDegrees(angle1)) == int(toDegrees(angle2))) {   // tree lines are parallel
-        std::vector<cv::Point2f> perp = getPerpendicularInInterSc(treePts[2], treePts[3]);
+        std::array<cv::Point2f, 2> perp = getPerpendicularInInterSc(treePts[2], treePts[3]);
         cv::Point2f i1 = line_intersection(perp[0], perp[1], treePts[2], treePts[3]);
         cv::Point2f i2 = line_intersection(perp[0], perp[1], treePts[0], treePts[1]);
         startPt = cv::Point2f(((i2.x + i1.x) / 2), ((i2.y + i1.y) / 2));
@@ -61,7 +66,7 @@ float getTreeWidth( std::vector<cv::Point2f> treePts, std::vector<cv::Point2f> c
     cv::Point2f inSc = line_intersection(cardPts[0], cardPts[1], startPt, endPt);
 
     // find perpendicular line to middle line in intersection
-    std::vector<cv::Point2f> perp = getPerpendicularInInterSc(startPt, inSc);
+    std::array<cv::Point2f, 2> perp = getPerpendicularInInterSc(startPt, inSc);
 
     // find final points. they are intersections between tree lines and perpendicular line
     cv::Point2f final1 = line_intersection(perp[0], perp[1], treePts[0], treePts[1]);
@@ -108,6 +113,18 @@ float getTreeWidth( std::vector<cv::Point2f> treePts, std::vector<cv::Point2f> c
     return distance;
 }
 
+/**
+ * Tree diameter in millimetres, the card width is the scale.
+ * @param tree_pts 4 tree points which represent 2 lines
+ * @param card_pts 4 card points, tl and tr first
+ * @return diameter in mm
+ */
+float treeDiameterMm(const std::vector<cv::Point2f>& tree_pts, const std::vector<cv::Point2f>& card_pts) {
+    float tree_width_in_pixels = getTreeWidth(tree_pts, card_pts);
+    float card_width_in_pixels = distBetweenPoints(card_pts[0], card_pts[1]);
+    return float(tree_width_in_pixels / card_width_in_pixels * CARD_WIDTH_MM);
+}
+
 /**
  * Compute distance between 2 points.
  * @param p1 first point
@@ -124,7 +141,7 @@ float distBetweenPoints(cv::Point2f p1, cv::Point2f p2) {
  * @param inSc second point of line and also point where perpendiclar line crosses input line
  * @return vector of 2 points - perpendical line
  */
-std::vector<cv::Point2f> getPerpendicularInInterSc(cv::Point2f startPt, cv::Point2f inSc) {
+std::array<cv::Point2f, 2> getPerpendicularInInterSc(cv::Point2f startPt, cv::Point2f inSc) {
     float vX = (inSc.x) - (startPt.x);
     float vY = (inSc.y) - (startPt.y);
 
@@ -141,10 +158,7 @@ std::vector<cv::Point2f> getPerpendicularInInterSc(cv::Point2f startPt, cv::Poin
     float dX = inSc.x - vX * len;
     float dY = inSc.y - vY * len;
 
-    std::vector<cv::Point2f> ret;
-    ret.push_back(cv::Point2f((cX), (cY)));
-    ret.push_back(cv::Point2f((dX), (dY)));
-    return (ret);
+    return {cv::Point2f((cX), (cY)), cv::Point2f((dX), (dY))};
 }
 
 /**
@@ -207,16 +221,12 @@ cv::Point2f line_intersection(cv::Point2f A, cv::Point2f B, cv::Point2f C, cv::P
  * @param w width of image
  * @return 2 points - line that intersect whole image
  */
-std::vector<cv::Point2f> extendLine(cv::Point2f l1, cv::Point2f l2, int h, int w) {
+std::array<cv::Point2f, 2> extendLine(cv::Point2f l1, cv::Point2f l2, int h, int w) {
     float nx = l2.x - l1.x;
     float ny = l2.y - l1.y;
 
     if (nx == 0) {     //vertical line
-
-        std::vector<cv::Point2f> ret;
-        ret.push_back(cv::Point2f(l1.x, 0));
-        ret.push_back(cv::Point2f(l1.x, float(h)));
-        return (ret);
+        return {cv::Point2f(l1.x, 0), cv::Point2f(l1.x, float(h))};
     }
 
     float x = 0;
@@ -227,10 +237,6 @@ std::vector<cv::Point2f> extendLine(cv::Point2f l1, cv::Point2f l2, int h, int w
     t = float((x - l1.x)) / nx;
     float y_e2 = l1.y + ny * t;
 
-    std::vector<cv::Point2f> ret;
-    ret.push_back(cv::Point2f(0, (y_e1)));
-    ret.push_back(cv::Point2f(float(w), (y_e2)));
-
-    return (ret);
+    return {cv::Point2f(0, (y_e1)), cv::Point2f(float(w), (y_e2))};
 }
 
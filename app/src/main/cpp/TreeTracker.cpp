@@ -0,0 +1,236 @@
+#include "TreeTracker.h"
+#include "Trace.h"
+#include "ScratchPool.h"
+
+#include <math.h>
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+
+static const int TRACK_ROW_STEP = 4;                // rows of the working image between edge samples
+static const float TRACK_CORRIDOR = 0.15f;          // half width of the search corridor, relative to the trunk width
+static const int TRACK_MIN_CORRIDOR = 4;            // corridor half width at least, pixels of the working image
+static const int TRACK_MIN_GRADIENT = 24;           // |dB| + |dG| + |dR| over two pixels below this is no edge
+static const float TRACK_MIN_SUPPORT = 0.6f;        // fraction of the sampled rows which must have an edge
+static const float TRACK_MAX_RESIDUAL = 2.0f;       // RMS distance of the edge points to their line always accepted, pixels
+static const float TRACK_RESIDUAL_GROWTH = 2.0f;    // above it the residual may grow to this multiple of the segmented frame's
+static const float TRACK_MAX_WIDTH_CHANGE = 1.3f;   // refitted trunk width relative to the predicted one
+
+
+/**
+ * x of a line through two points at row y.
+ */
+static inline float lineX(const cv::Point2f& top, const cv::Point2f& bottom, float y) {
+    return top.x + (bottom.x - top.x) * (y - top.y) / (bottom.y - top.y);
+}
+
+
+/**
+ * Strongest horizontal colour edge of a row within [from, to], with sub-pixel position.
+ * @return column, negative if no edge is strong enough
+ */
+static float strongestEdge(const cv::Mat& image, int row, int from, int to) {
+    const uchar* pixels = image.ptr<uchar>(row);
+    int cn = image.channels();
+    from = std::max(from, 1);
+    to = std::min(to, image.cols - 2);
+    if (to - from < 2) return -1;
+
+    auto gradient = [pixels, cn](int x) {
+        int sum = 0;
+        for (int c = 0; c < cn; c++) sum += std::abs(int(pixels[(x + 1) * cn + c]) - int(pixels[(x - 1) * cn + c]));
+        return sum;
+    };
+    int best_x = -1, best = TRACK_MIN_GRADIENT - 1;
+    for (int x = from; x <= to; x++) {
+        int g = gradient(x);
+        if (g > best) {
+            best = g;
+            best_x = x;
+        }
+    }
+    if (best_x < 0) return -1;
+
+    // parabola through the maximum and its neighbours
+    if (best_x > from && best_x < to) {
+        float left = float(gradient(best_x - 1)), right = float(gradient(best_x + 1));
+        float curvature = left - 2.f * best + right;
+        if (curvature < 0) return best_x + 0.5f * (left - right) / curvature;
+    }
+    return float(best_x);
+}
+
+
+/**
+ * Fit a line to edge points, robust to single outliers.
+ * @param points edge points, at least 2
+ * @param top output, point of the line at row 0
+ * @param bottom output, point of the line at the last row
+ * @param rows image height
+ * @return RMS distance of the points to the line, negative if the line is horizontal
+ */
+static float fitEdge(const std::vector<cv::Point2f>& points, cv::Point2f& top, cv::Point2f& bottom, int rows) {
+    cv::Vec4f line;
+    cv::fitLine(points, line, cv::DIST_HUBER, 0, 0.01, 0.01);
+    float vx = line[0], vy = line[1], x0 = line[2], y0 = line[3];
+    if (fabsf(vy) < 1e-3f) return -1;
+
+    double sum = 0;
+    for (const cv::Point2f& p : points) {
+        double distance = (p.x - x0) * vy - (p.y - y0) * vx;     // (vx, vy) has unit length
+        sum += distance * distance;
+    }
+    top = cv::Point2f(x0 + (0 - y0) * vx / vy, 0);
+    bottom = cv::Point2f(x0 + (rows - 1 - y0) * vx / vy, float(rows - 1));
+    return float(sqrt(sum / points.size()));
+}
+
+
+/**
+ * Refit both trunk edges to the image around the predicted lines.
+ * @param input current frame
+ * @param card_now card corners in the current frame
+ * @param predicted left and right line, top points first, input coordinates
+ * @param config working width and blur of tree detection
+ * @param fitted output, refitted lines like predicted
+ * @param residual output, larger RMS fit residual of the two edges, pixels of the working image
+ * @return false if an edge has too little support, the lines cross or the width jumps
+ */
+bool TreeTracker::refit(const SourceImage& input, const std::vector<cv::Point2f>& card_now, const std::vector<cv::Point2f>& predicted,
+                        const DetectorConfig& config, std::vector<cv::Point2f>& fitted, float& residual) const {
+    // same working image as TreeDetection, only the rows on the searched side of the card are blurred
+    float ratio = float(config.tree_resize_width) / input.cols();
+    int rows = int(round(ratio * input.rows()));
+    cv::Mat image = ScratchPool::local().get(ScratchPool::TREE_IMAGE, rows, config.tree_resize_width, CV_8UC3);
+    input.colorResized(image, image.size());
+
+    float card_top = INFINITY, card_bottom = -INFINITY;
+    for (const cv::Point2f& p : card_now) {
+        card_top = std::min(card_top, p.y * ratio);
+        card_bottom = std::max(card_bottom, p.y * ratio);
+    }
+    int first_row = position == 1 ? 2 : std::max(2, int(ceil(card_bottom)) + 1);
+    int last_row = position == 1 ? std::min(rows - 3, int(floor(card_top)) - 1) : rows - 3;
+    if (last_row - first_row < 3 * TRACK_ROW_STEP) return false;
+    cv::Mat band = image.rowRange(first_row - 2, last_row + 3);
+    cv::GaussianBlur(band, band, cv::Size(config.tree_blur, config.tree_blur), 0);
+
+    std::vector<cv::Point2f> lines(4);
+    for (int i = 0; i < 4; i++) lines[i] = predicted[i] * ratio;
+    if (fabsf(lines[1].y - lines[0].y) < 1 || fabsf(lines[3].y - lines[2].y) < 1) return false;
+
+    // strongest edge per sampled row within a corridor around each predicted line
+    std::vector<cv::Point2f> left_points, right_points;
+    int samples = 0;
+    for (int y = first_row; y <= last_row; y += TRACK_ROW_STEP) {
+        float left_x = lineX(lines[0], lines[1], float(y));
+        float right_x = lineX(lines[2], lines[3], float(y));
+        int corridor = std::max(TRACK_MIN_CORRIDOR, int(TRACK_CORRIDOR * (right_x - left_x)));
+        samples++;
+        float x = strongestEdge(image, y, int(left_x) - corridor, int(left_x) + corridor);
+        if (x >= 0) left_points.push_back(cv::Point2f(x, float(y)));
+        x = strongestEdge(image, y, int(right_x) - corridor, int(right_x) + corridor);
+        if (x >= 0) right_points.push_back(cv::Point2f(x, float(y)));
+    }
+    if (left_points.size() < TRACK_MIN_SUPPORT * samples || right_points.size() < TRACK_MIN_SUPPORT * samples) return false;
+
+    cv::Point2f left_top, left_bottom, right_top, right_bottom;
+    float left_residual = fitEdge(left_points, left_top, left_bottom, rows);
+    float right_residual = fitEdge(right_points, right_top, right_bottom, rows);
+    if (left_residual < 0 || right_residual < 0) return false;
+    residual = std::max(left_residual, right_residual);
+
+    // the edges must not cross within the image, nor change the trunk width abruptly
+    if (left_top.x >= right_top.x || left_bottom.x >= right_bottom.x) return false;
+    float middle = 0.5f * (first_row + last_row);
+    float width = lineX(right_top, right_bottom, middle) - lineX(left_top, left_bottom, middle);
+    float predicted_width = lineX(lines[2], lines[3], middle) - lineX(lines[0], lines[1], middle);
+    if (predicted_width <= 0 || width > TRACK_MAX_WIDTH_CHANGE * predicted_width
+        || width * TRACK_MAX_WIDTH_CHANGE < predicted_width) return false;
+
+    fitted = {left_top / ratio, left_bottom / ratio, right_top / ratio, right_bottom / ratio};
+    return true;
+}
+
+
+/**
+ * Track the trunk lines into the current frame.
+ * @param input current frame
+ * @param card_now card corners found in the current frame, same order as in the previous one
+ * @param config working width and blur of tree detection
+ * @param tree_now output, left and right line, top points first, input coordinates
+ * @return false if the frame has to be segmented, the tracker is then cleared
+ */
+bool TreeTracker::track(const SourceImage& input, const std::vector<cv::Point2f>& card_now, const DetectorConfig& config,
+                        std::vector<cv::Point2f>& tree_now) {
+    TRACE_SPAN(span, "trackTree");
+    if (!valid) return false;
+    if (card_now.size() != 4) {
+        clear();
+        return false;
+    }
+
+    // the card lies on the trunk, its motion moves the trunk edges
+    cv::Mat delta = cv::getPerspectiveTransform(card, card_now);
+    std::vector<cv::Point2f> predicted;
+    cv::perspectiveTransform(tree, predicted, delta);
+    for (const cv::Point2f& p : predicted) {
+        if (!std::isfinite(p.x) || !std::isfinite(p.y)) {
+            clear();
+            return false;
+        }
+    }
+
+    std::vector<cv::Point2f> fitted;
+    float residual = 0;
+    bool ok = refit(input, card_now, predicted, config, fitted, residual);
+    TRACE_COUNTER(span, "residual_x100", int(residual * 100));
+    if (!ok || residual > std::max(TRACK_MAX_RESIDUAL, TRACK_RESIDUAL_GROWTH * baseline_residual)) {
+        clear();
+        return false;
+    }
+
+    card = card_now;
+    tree = fitted;
+    tracked_frames++;
+    tree_now = fitted;
+    return true;
+}
+
+
+/**
+ * Start tracking from a segmented frame. The segmented lines are kept; the edge fit around them gives the
+ * residual later frames are compared with. Lines which do not lie on clear edges are not tracked.
+ * @param input segmented frame
+ * @param card_now card corners of the frame
+ * @param tree_now lines found by TreeDetection, top points first
+ * @param position side of the card the lines were found on, 1 above, 2 under
+ * @param config working width and blur of tree detection
+ */
+void TreeTracker::restart(const SourceImage& input, const std::vector<cv::Point2f>& card_now, const std::vector<cv::Point2f>& tree_now,
+                          int position, const DetectorConfig& config) {
+    clear();
+    if (card_now.size() != 4 || tree_now.size() != 4) return;
+    this->position = position;
+
+    std::vector<cv::Point2f> fitted;
+    float residual = 0;
+    if (!refit(input, card_now, tree_now, config, fitted, residual)) return;
+
+    valid = true;
+    card = card_now;
+    tree = tree_now;
+    baseline_residual = residual;
+}
+
+
+/**
+ * Forget the tracked lines, the next frame is segmented.
+ */
+void TreeTracker::clear() {
+    valid = false;
+    card.clear();
+    tree.clear();
+    baseline_residual = 0;
+    tracked_frames = 0;
+}
@@ -0,0 +1,44 @@
+#ifndef TREETRACKER_H
+#define TREETRACKER_H
+
+#include <stdio.h>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "DetectorConfig.h"
+#include "SourceImage.h"
+
+
+/**
+ * Follows the trunk edges of a live stream from frame to frame so grabcut does not run on every frame.
+ * The lines of the previous frame are moved with the homography between the previous and the current
+ * card, then each edge is refitted to the strongest colour edges in a narrow corridor around it.
+ * Tracking gives up when too few edge points are found, the fit residual grows or the lines cross;
+ * the caller then segments the frame and restarts the tracker from the result.
+ * One tracker belongs to one stream and is not thread-safe.
+ */
+class TreeTracker {
+private:
+    bool valid = false;
+    std::vector<cv::Point2f> card;      /**< Card corners of the last frame, input coordinates */
+    std::vector<cv::Point2f> tree;      /**< Left and right line of the last frame, top points first, input coordinates */
+    int position = 1;                   /**< Side of the card the edges are searched on, 1 above, 2 under */
+    float baseline_residual = 0;        /**< Fit residual on the segmented frame, pixels of the working image */
+    int tracked_frames = 0;             /**< Frames tracked since the last segmentation */
+
+    bool refit(const SourceImage& input, const std::vector<cv::Point2f>& card_now, const std::vector<cv::Point2f>& predicted,
+               const DetectorConfig& config, std::vector<cv::Point2f>& fitted, float& residual) const;
+
+public:
+    bool track(const SourceImage& input, const std::vector<cv::Point2f>& card_now, const DetectorConfig& config,
+               std::vector<cv::Point2f>& tree_now);
+    void restart(const SourceImage& input, const std::vector<cv::Point2f>& card_now, const std::vector<cv::Point2f>& tree_now,
+                 int position, const DetectorConfig& config);
+    void clear();
+
+    bool isTracking() const { return valid; }
+    int trackedFrames() const { return tracked_frames; }
+};
+
+
+#endif //TREETRACKER_H
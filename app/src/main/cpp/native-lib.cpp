@@ -2,6 +2,15 @@
 #include <string>
 #include <opencv2/core.hpp>
 #include "ObjectDetector.h"
+#include "Trace.h"
+#include "DebugCapture.h"
+#include "DetectorConfig.h"
+#include "LiveMeasurement.h"
+#include "FrameCapture.h"
+#include "ResultCache.h"
+#include "Hash.h"
+#include "ImageDecode.h"
+#include "MemoryUsage.h"
 #include <android/log.h>
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
@@ -10,6 +19,11 @@
 #include <fstream>
 #include <sstream>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 
 #define  LOG_TAG    "IAMGROOT-JNI"
 
@@ -19,6 +33,8 @@ namespace {
     constexpr char *RES_RAW_CONFIG_PATH_ENV_VAR = "RES_RAW_CONFIG_PATH";
     constexpr char *RES_CARD_FILE_NAME = "treeo_card.png";
     constexpr char *RES_SAMPLE_FILE_NAME = "tree.jpeg";
+    constexpr char *RES_CONFIG_FILE_NAME = "detector_config.json";
+    constexpr char *RES_CARD_FEATURES_FILE_NAME = "treeo_card.cardfeat";
 
     jobject getAssetManagerFromJava(JNIEnv *env, jobject obj);
 
@@ -26,7 +42,34 @@ namespace {
 
     cv::Mat readSampleImage(JNIEnv *env, jobject obj);
 
+    DetectorConfig readConfigFromAsset(JNIEnv *env, jobject obj);
+
+    std::shared_ptr<const CardModel> cardModelFromAsset(JNIEnv *env, jobject obj, const DetectorConfig &config);
+
     std::string readFile(std::string filePath);
+
+    std::mutex live_mutex;
+    std::shared_ptr<LiveMeasurement> live;     // live preview measurement, null when stopped; callers copy it and work outside live_mutex
+    std::shared_ptr<FrameRecorder> frame_recorder;  // capture of the live frames, null when not recording
+
+    constexpr int LIVE_OVERLAY_SIZE = 26;       // floats returned by pollLiveOverlay
+
+    ResultCache result_cache(64);               // results of recently measured photos
+
+    // measured / predicted working memory of the photo path, raised by every photo that goes over its budget;
+    // later photos plan with their working budget divided by it
+    std::atomic<double> memory_overrun(1);
+
+    std::mutex card_model_mutex;
+    std::shared_ptr<const CardModel> card_model;   // card features of the process, built once
+    std::shared_ptr<const ObjectDetector> photo_detector;  // detector of the photo path, its scheduler learns across photos
+    std::shared_ptr<const CardModel> photo_detector_model; // card model photo_detector was built with
+
+    std::shared_ptr<const ObjectDetector> photoDetector(JNIEnv *env, jobject obj, const DetectorConfig &config);
+
+    double measureCached(JNIEnv *env, jobject obj, const SourceImage &input, const MeasureOptions &options = MeasureOptions());
+
+    jlong closeFrameCapture(std::shared_ptr<FrameRecorder> recorder);
 }
 
 #define LOGD(...) ((void)__android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__))
@@ -36,19 +79,12 @@ extern "C"
 JNIEXPORT jdouble JNICALL
 Java_com_lae_iamgroot_MainActivity_measureTree(JNIEnv *env, jobject thiz, jlong mat) {
 
-    cv::Mat cardImageFile = readFileFromAsset(env, thiz);
-
-    ObjectDetector objectDetector = ObjectDetector(cardImageFile);
-
-    cv::Mat input = *(cv::Mat *) mat;
-
-    double diameter;
+    // Utils.bitmapToMat gives RGBA, the stages read it as it is
+    SourceImage input = SourceImage::wrap(*(cv::Mat *) mat, PIXEL_RGBA);
 
-    objectDetector.measureTree(input, diameter);
+    double _diameter = measureCached(env, thiz, input);
 
-    double _diameter = objectDetector.getDiameterValue();
-
-    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Diameter Value from CPP = %d", _diameter);
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Diameter Value from CPP = %f", _diameter);
 
     return _diameter;
 
@@ -64,19 +100,15 @@ namespace {
             AAssetManager *am = AAssetManager_fromJava(env, jam);
             if (am) {
                 AAsset *assetFile = AAssetManager_open(am, RES_CARD_FILE_NAME, AASSET_MODE_BUFFER);
+                if (!assetFile) return h;
 
+                // decode straight from the asset buffer, no intermediate copies
                 const void *buf = AAsset_getBuffer(assetFile);
-
-
-                LOGD("%s:\n%s", RES_CARD_FILE_NAME, static_cast<const char *>(buf));
-
                 long sizeOfImg = AAsset_getLength(assetFile);
-                char *buffer = (char *) malloc(sizeof(char) * sizeOfImg);
-                AAsset_read(assetFile, buffer, sizeOfImg);
-
-                std::vector<char> data(buffer, buffer + sizeOfImg);
-
-                h = cv::imdecode(data, -1);
+                if (buf) {
+                    h = cv::imdecode(cv::Mat(1, int(sizeOfImg), CV_8U, const_cast<void *>(buf)), -1);
+                }
+                AAsset_close(assetFile);
 
 
             }
@@ -93,24 +125,161 @@ namespace {
             if (am) {
                 AAsset *assetFile = AAssetManager_open(am, RES_SAMPLE_FILE_NAME,
                                                        AASSET_MODE_BUFFER);
+                if (!assetFile) return h;
 
                 const void *buf = AAsset_getBuffer(assetFile);
+                long sizeOfImg = AAsset_getLength(assetFile);
+                if (buf) {
+                    h = cv::imdecode(cv::Mat(1, int(sizeOfImg), CV_8U, const_cast<void *>(buf)), -1);
+                }
+                AAsset_close(assetFile);
 
 
-                LOGD("%s:\n%s", RES_SAMPLE_FILE_NAME, static_cast<const char *>(buf));
+            }
+        }
+        return h;
+    }
 
-                long sizeOfImg = AAsset_getLength(assetFile);
-                char *buffer = (char *) malloc(sizeof(char) * sizeOfImg);
-                AAsset_read(assetFile, buffer, sizeOfImg);
+    DetectorConfig readConfigFromAsset(JNIEnv *env, jobject obj) {
 
-                std::vector<char> data(buffer, buffer + sizeOfImg);
+        jobject jam = getAssetManagerFromJava(env, obj);
+        DetectorConfig config;
+        if (jam) {
+            AAssetManager *am = AAssetManager_fromJava(env, jam);
+            if (am) {
+                AAsset *assetFile = AAssetManager_open(am, RES_CONFIG_FILE_NAME, AASSET_MODE_BUFFER);
+                if (!assetFile) return config;
+
+                const char *buf = (const char *) AAsset_getBuffer(assetFile);
+                long size = AAsset_getLength(assetFile);
+                if (buf && !DetectorConfig::loadFromString(std::string(buf, size), config)) {
+                    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Invalid %s, using defaults", RES_CONFIG_FILE_NAME);
+                }
+                AAsset_close(assetFile);
+            }
+        }
+        return config;
+    }
 
-                h = cv::imdecode(data, -1);
+    /**
+     * Map the card-feature asset and use it in place. Needs the asset stored uncompressed.
+     * @return model, null if the asset is missing, compressed, stale or invalid
+     */
+    std::shared_ptr<const CardModel> mapCardFeatureAsset(AAssetManager *am, int template_blur) {
+        AAsset *assetFile = AAssetManager_open(am, RES_CARD_FEATURES_FILE_NAME, AASSET_MODE_UNKNOWN);
+        if (!assetFile) return nullptr;
+
+        off_t start = 0, length = 0;
+        int fd = AAsset_openFileDescriptor(assetFile, &start, &length);
+        AAsset_close(assetFile);
+        if (fd < 0) {
+            __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "%s is compressed, not mapping it", RES_CARD_FEATURES_FILE_NAME);
+            return nullptr;
+        }
 
+        // mmap offsets must be page aligned, the asset starts somewhere inside the apk
+        off_t page = sysconf(_SC_PAGESIZE);
+        off_t map_start = start / page * page;
+        size_t map_length = size_t(length + (start - map_start));
+        void *mapped = mmap(nullptr, map_length, PROT_READ, MAP_PRIVATE, fd, map_start);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Unable to map %s", RES_CARD_FEATURES_FILE_NAME);
+            return nullptr;
+        }
+        std::shared_ptr<const void> owner(mapped, [map_length](const void *p) {
+            munmap(const_cast<void *>(p), map_length);
+        });
+
+        std::string error;
+        std::shared_ptr<const CardModel> model = CardModel::fromBuffer(
+                (const uint8_t *) mapped + (start - map_start), size_t(length), template_blur, owner, error);
+        if (!model) {
+            __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Ignoring %s: %s", RES_CARD_FEATURES_FILE_NAME, error.c_str());
+        }
+        return model;
+    }
 
-            }
+    /**
+     * Card features for the config, from the mapped feature asset or, if that is stale, built from the card image.
+     * The model is kept for the lifetime of the process.
+     */
+    std::shared_ptr<const CardModel> cardModelFromAsset(JNIEnv *env, jobject obj, const DetectorConfig &config) {
+        std::lock_guard<std::mutex> lock(card_model_mutex);
+        if (card_model && card_model->templateBlur() == config.card_template_blur) return card_model;
+
+        jobject jam = getAssetManagerFromJava(env, obj);
+        AAssetManager *am = jam ? AAssetManager_fromJava(env, jam) : nullptr;
+        std::shared_ptr<const CardModel> model = am ? mapCardFeatureAsset(am, config.card_template_blur) : nullptr;
+        if (!model) {
+            LOGD("Building card features from %s", RES_CARD_FILE_NAME);
+            model = CardModel::build(readFileFromAsset(env, obj), config.card_template_blur);
         }
-        return h;
+        if (model) card_model = model;
+        return model;
+    }
+
+    /**
+     * Detector of the photo path, kept for the lifetime of the process so its resolution scheduler learns
+     * the card size and stage times across photos. Rebuilt when the config or the card model changes.
+     * measureTree is const and reentrant, concurrent calls share the detector without a lock.
+     */
+    std::shared_ptr<const ObjectDetector> photoDetector(JNIEnv *env, jobject obj, const DetectorConfig &config) {
+        std::shared_ptr<const CardModel> model = cardModelFromAsset(env, obj, config);
+        std::lock_guard<std::mutex> lock(card_model_mutex);
+        if (!photo_detector || photo_detector_model != model || photo_detector->getConfig().version() != config.version()) {
+            photo_detector = std::make_shared<ObjectDetector>(model, config);
+            photo_detector_model = model;
+        }
+        return photo_detector;
+    }
+
+    /**
+     * Measure an image, or return the stored result if the same image was measured with the same config.
+     * Results of deadline-degraded or adaptive-resolution runs depend on timing and are not stored.
+     * @param options deadline and memory budget of the measurement
+     */
+    double measureCached(JNIEnv *env, jobject obj, const SourceImage &input, const MeasureOptions &options) {
+        DetectorConfig config = readConfigFromAsset(env, obj);
+        bool cacheable = !config.adaptive_resolution;
+        // NV21 and I420 buffers of the same bytes are different images
+        uint64_t image_hash = hashImage(input.pixels()) ^ uint64_t(input.format());
+
+        CachedResult cached;
+        if (cacheable && result_cache.lookup(image_hash, config.version(), cached)) {
+            LOGD("Result cache hit, code %d", cached.code);
+            return cached.diameter;
+        }
+
+        std::shared_ptr<const ObjectDetector> detector = photoDetector(env, obj, config);
+        MeasureResult result;
+        detector->measureTree(input, options, result);
+
+        if (cacheable && result.degradations == DEGRADE_NONE) {
+            cached.code = result.code;
+            cached.card = result.card;
+            cached.tree = result.tree;
+            cached.diameter = result.diameter;
+            result_cache.store(image_hash, config.version(), cached);
+        }
+        return result.diameter;
+    }
+
+    /**
+     * Close a frame capture and log its statistics. Not under live_mutex, writing the queued frames takes a while.
+     * @return frames written, -1 if the file is incomplete
+     */
+    jlong closeFrameCapture(std::shared_ptr<FrameRecorder> recorder) {
+        bool closed = recorder->close();
+        LOGD("Frame capture: %lld frames, %lld dropped, %llu kB of %llu kB raw%s",
+             (long long) recorder->framesWritten(), (long long) recorder->framesDropped(),
+             (unsigned long long) recorder->bytesWritten() / 1024, (unsigned long long) recorder->rawBytes() / 1024,
+             recorder->isFull() ? ", stopped at the size limit" : "");
+        if (!closed) {
+            __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Frame capture incomplete");
+            return -1;
+        }
+        return recorder->framesWritten();
     }
 
     jobject getAssetManagerFromJava(JNIEnv *env, jobject obj) {
@@ -133,30 +302,250 @@ namespace {
     }
 
 }
+
+
+/**
+ * Measure a photo file. JPEGs are decoded directly at the smallest scale the pipeline can use.
+ * With a memory budget, half of it goes to the decoded photo and the rest to the working images,
+ * both use lower resolutions as needed. The decode time and the peak resident memory of the decode
+ * and of the whole call are logged. A call whose peak goes over the budget makes later calls plan
+ * with proportionally less working memory, down to the smallest widths and ORB.
+ * @param fd descriptor of the file, stays owned by the caller
+ * @param memoryBudget bytes of native memory the call may use, 0 for no limit
+ */
+extern "C"
+JNIEXPORT jdouble JNICALL
+Java_com_lae_iamgroot_CameraActivity_getTreeDiameterFromFd(JNIEnv *env, jobject thiz, jint fd, jlong memoryBudget) {
+
+    size_t budget = memoryBudget > 0 ? size_t(memoryBudget) : 0;
+    bool peak_reset = resetPeakResident();
+    size_t rss_before = residentBytes();
+
+    DetectorConfig config = readConfigFromAsset(env, thiz);
+    int factor = 1;
+    auto decode_start = std::chrono::steady_clock::now();
+    cv::Mat input = decodeFileDescriptor(fd, ResolutionScheduler::maxWorkingWidth(config), factor, budget / 2);
+    if (input.empty()) {
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Unable to decode photo");
+        return 0;
+    }
+    double decode_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decode_start).count();
+    size_t decode_peak = peakResidentBytes();
+    LOGD("Photo decoded at 1/%d: %dx%d in %.1f ms, peak native memory %zu kB", factor, input.cols, input.rows, decode_ms,
+         peak_reset && decode_peak > rss_before ? (decode_peak - rss_before) / 1024 : 0);
+
+    MeasureOptions options;
+    if (budget > 0) {
+        // a photo that alone uses up the budget is measured at the smallest widths
+        size_t image_bytes = input.total() * input.elemSize();
+        size_t working = budget > image_bytes ? size_t((budget - image_bytes) / memory_overrun.load()) : 0;
+        options.memory_budget_bytes = working > MIN_MEMORY_BUDGET ? working : MIN_MEMORY_BUDGET;
+    }
+    double _diameter = measureCached(env, thiz, SourceImage::wrap(input, PIXEL_BGR), options);
+
+    // without clear_refs the high-water mark may be older than this call
+    size_t peak = peakResidentBytes();
+    if (peak_reset && peak > rss_before) {
+        size_t used = peak - rss_before;
+        LOGD("Peak native memory of the measurement: %zu kB", used / 1024);
+        if (budget > 0 && used > budget) {
+            double overrun = memory_overrun.load() * used / budget;
+            memory_overrun.store(overrun);
+            __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "Measurement used %zu kB, budget %zu kB, later photos plan with 1/%.2f",
+                                used / 1024, budget / 1024, overrun);
+        }
+    }
+
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Diameter Value from CPP = %f", _diameter);
+
+    return _diameter;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_lae_iamgroot_CameraActivity_setTraceEnabled(JNIEnv *env, jobject thiz, jboolean enabled) {
+    trace::setEnabled(enabled);
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_com_lae_iamgroot_CameraActivity_dumpTrace(JNIEnv *env, jobject thiz) {
+    std::string json = trace::dumpChromeJson();
+    return env->NewStringUTF(json.c_str());
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_lae_iamgroot_CameraActivity_setDebugCaptureEnabled(JNIEnv *env, jobject thiz, jboolean enabled) {
+    capture::setEnabled(enabled);
+}
+
 extern "C"
 JNIEXPORT jint JNICALL
-Java_com_lae_iamgroot_MainActivity_checkCard(JNIEnv *env, jobject thiz) {
-    // TODO: implement checkCard()
+Java_com_lae_iamgroot_CameraActivity_dumpDebugCapture(JNIEnv *env, jobject thiz, jstring directory) {
+    const char *dir = env->GetStringUTFChars(directory, nullptr);
+    int written = capture::dump(dir);
+    env->ReleaseStringUTFChars(directory, dir);
+    return written;
+}
 
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_lae_iamgroot_CameraActivity_startLive(JNIEnv *env, jobject thiz, jdouble deadline_ms) {
+    std::lock_guard<std::mutex> lock(live_mutex);
+    if (live) return;
+    DetectorConfig config = readConfigFromAsset(env, thiz);
+    live = std::make_shared<LiveMeasurement>(cardModelFromAsset(env, thiz, config), config, deadline_ms);
+    live->start();
 }
 
 extern "C"
-JNIEXPORT jdouble JNICALL
-Java_com_lae_iamgroot_CameraActivity_getTreeDiameter(JNIEnv *env, jobject thiz, jlong mat) {
+JNIEXPORT void JNICALL
+Java_com_lae_iamgroot_CameraActivity_stopLive(JNIEnv *env, jobject thiz) {
+    std::shared_ptr<LiveMeasurement> stopped;
+    std::shared_ptr<FrameRecorder> recorder;
+    {
+        std::lock_guard<std::mutex> lock(live_mutex);
+        stopped = std::move(live);
+        recorder = std::move(frame_recorder);
+    }
+    if (stopped) stopped->stop();
+    if (recorder) closeFrameCapture(recorder);
+}
 
-    cv::Mat cardImageFile = readFileFromAsset(env, thiz);
+/**
+ * Record the frames submitted to live mode into a capture file, for replay with tools/CaptureReplay.
+ * Live mode has to be running, stopping it also ends the capture.
+ * @param path capture file, overwritten
+ * @param device description of the device stored in the capture
+ * @param max_bytes size of the capture file after which frames are no longer recorded, 0 for no limit
+ * @return false if live mode is not running, a capture is already running or the file cannot be created
+ */
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_lae_iamgroot_CameraActivity_startFrameCapture(JNIEnv *env, jobject thiz, jstring path, jstring device,
+                                                    jlong max_bytes) {
+    std::lock_guard<std::mutex> lock(live_mutex);
+    if (!live || frame_recorder) return JNI_FALSE;
+
+    CaptureInfo info;
+    const char *device_text = env->GetStringUTFChars(device, nullptr);
+    info.device = device_text;
+    env->ReleaseStringUTFChars(device, device_text);
+    info.config = readConfigFromAsset(env, thiz);
+    info.deadline_ms = live->deadlineMs();
+    info.start_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    info.opencv_version = CV_VERSION;
+
+    std::shared_ptr<FrameRecorder> recorder = std::make_shared<FrameRecorder>();
+    const char *file = env->GetStringUTFChars(path, nullptr);
+    bool opened = recorder->open(file, info, CAPTURE_PACKED, max_bytes > 0 ? uint64_t(max_bytes) : 0);
+    env->ReleaseStringUTFChars(path, file);
+    if (!opened) {
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Unable to start the frame capture");
+        return JNI_FALSE;
+    }
+    live->setRecorder(recorder);
+    frame_recorder = recorder;
+    return JNI_TRUE;
+}
 
-    ObjectDetector objectDetector = ObjectDetector(cardImageFile);
+/**
+ * End the frame capture, the queued frames and the index are written first.
+ * @return frames written, -1 if no capture was running or the file is incomplete
+ */
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_lae_iamgroot_CameraActivity_stopFrameCapture(JNIEnv *env, jobject thiz) {
+    std::shared_ptr<FrameRecorder> recorder;
+    {
+        std::lock_guard<std::mutex> lock(live_mutex);
+        recorder = std::move(frame_recorder);
+        if (live) live->setRecorder(nullptr);
+    }
+    return recorder ? closeFrameCapture(recorder) : -1;
+}
 
-    cv::Mat input = *(cv::Mat *) mat;
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_lae_iamgroot_CameraActivity_submitLiveFrame(JNIEnv *env, jobject thiz, jobject y, jint y_row_stride,
+                                                     jobject u, jobject v, jint uv_row_stride, jint uv_pixel_stride,
+                                                     jint width, jint height, jint rotation) {
+    // the frame is copied outside live_mutex, the UI thread polling the overlay or stopping live mode does not wait
+    // for it; a frame submitted while live mode stops is discarded by the stopped measurement
+    std::shared_ptr<LiveMeasurement> measurement;
+    {
+        std::lock_guard<std::mutex> lock(live_mutex);
+        measurement = live;
+    }
+    if (!measurement) return JNI_FALSE;
 
-    double diameter;
+    auto *y_data = (const uint8_t *) env->GetDirectBufferAddress(y);
+    auto *u_data = (const uint8_t *) env->GetDirectBufferAddress(u);
+    auto *v_data = (const uint8_t *) env->GetDirectBufferAddress(v);
+    if (!y_data || !u_data || !v_data) return JNI_FALSE;
 
-    objectDetector.measureTree(input, diameter);
+    return measurement->submitYuv420(y_data, y_row_stride, u_data, v_data, uv_row_stride, uv_pixel_stride,
+                                     width, height, rotation) ? JNI_TRUE : JNI_FALSE;
+}
 
-    double _diameter = objectDetector.getDiameterValue();
+/**
+ * Overlay of the last processed live frame as floats:
+ * frame id, code, width, height, card x/y * 4, tree x/y * 4, diameter, degradations, latency ms, fps,
+ * processed frames, dropped frames. Null if live mode is not running or no frame was processed yet.
+ */
+extern "C"
+JNIEXPORT jfloatArray JNICALL
+Java_com_lae_iamgroot_CameraActivity_pollLiveOverlay(JNIEnv *env, jobject thiz) {
+    LiveOverlay overlay;
+    {
+        std::lock_guard<std::mutex> lock(live_mutex);
+        if (!live) return nullptr;
+        overlay = live->latestOverlay();
+    }
+    if (overlay.frame_id < 0) return nullptr;
+
+    float values[LIVE_OVERLAY_SIZE];
+    int i = 0;
+    values[i++] = float(overlay.frame_id);
+    values[i++] = float(overlay.code);
+    values[i++] = float(overlay.width);
+    values[i++] = float(overlay.height);
+    for (const cv::Point2f &p : overlay.card) {
+        values[i++] = p.x;
+        values[i++] = p.y;
+    }
+    for (const cv::Point2f &p : overlay.tree) {
+        values[i++] = p.x;
+        values[i++] = p.y;
+    }
+    values[i++] = float(overlay.diameter);
+    values[i++] = float(overlay.degradations);
+    values[i++] = float(overlay.latency_ms);
+    values[i++] = float(overlay.fps);
+    values[i++] = float(overlay.processed);
+    values[i++] = float(overlay.dropped);
+
+    jfloatArray array = env->NewFloatArray(LIVE_OVERLAY_SIZE);
+    env->SetFloatArrayRegion(array, 0, LIVE_OVERLAY_SIZE, values);
+    return array;
+}
 
-    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Diameter Value from CPP = %d", _diameter);
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_lae_iamgroot_CameraActivity_loadResultCache(JNIEnv *env, jobject thiz, jstring path) {
+    const char *file = env->GetStringUTFChars(path, nullptr);
+    bool loaded = result_cache.load(file);
+    env->ReleaseStringUTFChars(path, file);
+    return loaded ? JNI_TRUE : JNI_FALSE;
+}
 
-    return _diameter;
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_lae_iamgroot_CameraActivity_saveResultCache(JNIEnv *env, jobject thiz, jstring path) {
+    const char *file = env->GetStringUTFChars(path, nullptr);
+    bool saved = result_cache.save(file);
+    env->ReleaseStringUTFChars(path, file);
+    return saved ? JNI_TRUE : JNI_FALSE;
 }
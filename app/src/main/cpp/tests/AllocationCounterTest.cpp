@@ -0,0 +1,41 @@
+#include "tools/AllocationCounter.h"
+#include "TestCheck.h"
+
+#include <string.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+int main() {
+    // operator new goes through the malloc hook
+    AllocationCount before = allocationCount();
+    std::unique_ptr<std::vector<int>> numbers(new std::vector<int>(1000));
+    AllocationCount used = allocationCount() - before;
+    CHECK_EQ(used.count, uint64_t(2));
+    CHECK(used.bytes >= 1000 * sizeof(int) + sizeof(std::vector<int>));
+    CHECK_EQ(used.large, uint64_t(0));
+
+    // aligned and large allocations, as cv::fastMalloc makes them
+    before = allocationCount();
+    void* aligned = nullptr;
+    CHECK_EQ(posix_memalign(&aligned, 64, LARGE_ALLOCATION), 0);
+    CHECK(aligned != nullptr && uintptr_t(aligned) % 64 == 0);
+    memset(aligned, 1, LARGE_ALLOCATION);
+    free(aligned);
+    used = allocationCount() - before;
+    CHECK_EQ(used.count, uint64_t(1));
+    CHECK_EQ(used.large, uint64_t(1));
+
+    // other threads count too; nothing is counted without allocations
+    before = allocationCount();
+    std::thread worker([] { std::string text(100, 'x'); CHECK_EQ(text.size(), size_t(100)); });
+    worker.join();
+    CHECK((allocationCount() - before).count >= 1);
+    before = allocationCount();
+    numbers->assign(1000, 7);
+    CHECK_EQ((allocationCount() - before).count, uint64_t(0));
+
+    return testResult();
+}
@@ -0,0 +1,105 @@
+#include "CardMatcher.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <set>
+#include <opencv2/features2d.hpp>
+
+
+/**
+ * SIFT-like descriptors: integers 0-255 stored as floats.
+ */
+static cv::Mat randomDescriptors(int rows, cv::RNG& rng) {
+    cv::Mat descriptors(rows, 128, CV_32F);
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < 128; c++) descriptors.at<float>(r, c) = float(rng.uniform(0, 256));
+    }
+    return descriptors;
+}
+
+/**
+ * Image descriptors: unrelated ones, then noisy copies of some card descriptors, a few of them twice.
+ * @param source output, per image row the card row it was copied from, -1 for unrelated ones
+ */
+static cv::Mat imageDescriptors(const cv::Mat& card, cv::RNG& rng, std::vector<int>& source) {
+    cv::Mat image = randomDescriptors(300, rng);
+    source.assign(image.rows, -1);
+    for (int r = 0; r < card.rows * 2 / 3; r++) {
+        int copies = r % 10 == 0 ? 2 : 1;
+        for (int k = 0; k < copies; k++) {
+            source.push_back(r);
+            cv::Mat copy = card.row(r).clone();
+            for (int c = 0; c < copy.cols; c++) {
+                copy.at<float>(0, c) = float(std::min(255, std::max(0, int(copy.at<float>(0, c)) + rng.uniform(-12, 13))));
+            }
+            image.push_back(copy);
+        }
+    }
+    return image;
+}
+
+static std::vector<cv::DMatch> ratioTest(const std::vector<std::vector<cv::DMatch>>& knn, float ratio) {
+    std::vector<cv::DMatch> good;
+    for (const std::vector<cv::DMatch>& matches : knn) {
+        if (matches.size() > 1 && matches[0].distance < ratio * matches[1].distance) good.push_back(matches[0]);
+    }
+    return good;
+}
+
+static std::set<std::pair<int, int>> pairs(const std::vector<cv::DMatch>& matches) {
+    std::set<std::pair<int, int>> result;
+    for (const cv::DMatch& match : matches) result.insert(std::make_pair(match.queryIdx, match.trainIdx));
+    return result;
+}
+
+
+int main() {
+    cv::RNG rng(1234);
+    const float ratio = 0.7f;
+    CardFeatures card;
+    card.descriptors = randomDescriptors(240, rng);
+    card.count = card.descriptors.rows;
+    card.index = std::make_shared<cv::flann::Index>(card.descriptors, cv::flann::KDTreeIndexParams(4));
+    card.index_mutex = std::make_shared<std::mutex>();
+    card.descriptors.convertTo(card.compact[DESCRIPTOR_UINT8], CV_8U);
+    std::vector<int> source;
+    cv::Mat image = imageDescriptors(card.descriptors, rng, source);
+
+    // SIMD brute force equals OpenCV's exact matcher
+    std::vector<std::vector<cv::DMatch>> reference_knn, knn;
+    cv::BFMatcher::create(cv::NORM_L2)->knnMatch(card.descriptors, image, reference_knn, 2);
+    knnMatchL2(card.descriptors, image, knn);
+    CHECK_EQ(knn.size(), reference_knn.size());
+    for (size_t i = 0; i < std::min(knn.size(), reference_knn.size()); i++) {
+        CHECK_EQ(knn[i].size(), size_t(2));
+        if (knn[i].size() != 2 || reference_knn[i].size() != 2) continue;
+        CHECK_EQ(knn[i][0].trainIdx, reference_knn[i][0].trainIdx);
+        CHECK_EQ(knn[i][1].trainIdx, reference_knn[i][1].trainIdx);
+        CHECK(fabsf(knn[i][0].distance - reference_knn[i][0].distance) <= 1e-3f * reference_knn[i][0].distance + 1e-3f);
+    }
+    std::set<std::pair<int, int>> exact = pairs(ratioTest(reference_knn, ratio));
+    CHECK(exact.size() > 100);
+
+    std::vector<cv::DMatch> good;
+    matchCard(card, image, CARD_MATCH_BRUTE_FORCE, DESCRIPTOR_FLOAT, ratio, good);
+    CHECK(pairs(good) == exact);
+
+    // SIFT elements are integers, 8-bit descriptors give the same matches
+    matchCard(card, image, CARD_MATCH_BRUTE_FORCE, DESCRIPTOR_UINT8, ratio, good);
+    CHECK(pairs(good) == exact);
+
+    // the card index searches the other way: at most one match per card keypoint, nearly all exact ones found;
+    // it also keeps card keypoints seen twice in the image, which fail the ratio test of brute force
+    matchCard(card, image, CARD_MATCH_INDEX, DESCRIPTOR_FLOAT, ratio, good);
+    std::set<int> card_keypoints;
+    size_t agreeing = 0, correct = 0;
+    for (const cv::DMatch& match : good) {
+        CHECK(card_keypoints.insert(match.queryIdx).second);
+        agreeing += exact.count(std::make_pair(match.queryIdx, match.trainIdx));
+        correct += source[match.trainIdx] == match.queryIdx;
+    }
+    CHECK(agreeing >= exact.size() * 9 / 10);
+    CHECK(correct >= good.size() * 95 / 100);
+
+    return testResult();
+}
@@ -0,0 +1,94 @@
+#include "CardMatcher.h"
+#include "CardModel.h"
+#include "TestCheck.h"
+
+#include <string.h>
+#include <opencv2/features2d.hpp>
+#include <opencv2/imgproc.hpp>
+
+
+/**
+ * Textured card-like image, enough corners for both feature algorithms.
+ */
+static cv::Mat syntheticCard() {
+    cv::Mat card(260, 420, CV_8UC3, cv::Scalar(235, 235, 235));
+    cv::RNG rng(42);
+    for (int i = 0; i < 60; i++) {
+        cv::Point corner(rng.uniform(0, card.cols - 40), rng.uniform(0, card.rows - 30));
+        cv::Scalar color(rng.uniform(0, 200), rng.uniform(0, 200), rng.uniform(0, 200));
+        cv::rectangle(card, corner, corner + cv::Point(rng.uniform(8, 40), rng.uniform(6, 30)), color, cv::FILLED);
+    }
+    cv::putText(card, "TREEO 4711", cv::Point(30, 200), cv::FONT_HERSHEY_SIMPLEX, 1.5, cv::Scalar(20, 60, 20), 3);
+    return card;
+}
+
+static bool sameFeatures(const CardFeatures& a, const CardFeatures& b) {
+    if (a.count != b.count || a.descriptors.size() != b.descriptors.size() || a.descriptors.type() != b.descriptors.type()) {
+        return false;
+    }
+    for (int i = 0; i < a.count; i++) {
+        if (a.keypoints[i].pt != b.keypoints[i].pt || a.keypoints[i].size != b.keypoints[i].size
+            || a.keypoints[i].angle != b.keypoints[i].angle || a.keypoints[i].octave != b.keypoints[i].octave) {
+            return false;
+        }
+    }
+    return a.count == 0 || cv::norm(a.descriptors, b.descriptors, cv::NORM_INF) == 0;
+}
+
+
+int main() {
+    const int blur = 3;
+    std::shared_ptr<CardModel> built = CardModel::build(syntheticCard(), blur);
+    CHECK(built != nullptr);
+    if (!built) return testResult();
+    CHECK(built->features(CardModel::SIFT_FEATURES).count > 10);
+    CHECK(built->features(CardModel::ORB_FEATURES).count > 10);
+
+    // round trip through the file format, used in place
+    std::vector<uint8_t> file = built->serialize();
+    std::string error;
+    std::shared_ptr<CardModel> loaded = CardModel::fromBuffer(file.data(), file.size(), blur, nullptr, error);
+    CHECK(loaded != nullptr);
+    if (!loaded) return testResult();
+    CHECK(loaded->isMapped() == false);
+    CHECK(loaded->size() == built->size());
+    CHECK_EQ(loaded->templateBlur(), blur);
+    for (int a = 0; a < CardModel::ALGORITHM_COUNT; a++) {
+        const CardFeatures& original = built->features(CardModel::Algorithm(a));
+        const CardFeatures& mapped = loaded->features(CardModel::Algorithm(a));
+        CHECK(sameFeatures(original, mapped));
+        CHECK(mapped.descriptors.empty() || mapped.descriptors.data >= file.data());
+    }
+    CHECK(loaded->serialize() == file);
+
+    // a misaligned buffer is copied and still loads
+    std::vector<uint8_t> shifted(file.size() + 1);
+    memcpy(shifted.data() + 1, file.data(), file.size());
+    std::shared_ptr<CardModel> copied = CardModel::fromBuffer(shifted.data() + 1, file.size(), blur, nullptr, error);
+    CHECK(copied != nullptr);
+    if (copied) CHECK(sameFeatures(built->features(CardModel::SIFT_FEATURES), copied->features(CardModel::SIFT_FEATURES)));
+
+    // the PCA int8 scale holds for descriptors unlike the card ones, nothing saturates
+    const CardFeatures& sift = built->features(CardModel::SIFT_FEATURES, true);
+    CHECK_EQ(sift.compact[DESCRIPTOR_PCA_INT8].rows, sift.count);
+    cv::Mat noise(600, 800, CV_8U);
+    cv::randu(noise, 0, 256);
+    std::vector<cv::KeyPoint> keypoints;
+    cv::Mat descriptors, compact;
+    cv::SIFT::create()->detectAndCompute(noise, cv::noArray(), keypoints, descriptors);
+    CHECK(descriptors.rows > 10);
+    descriptors.push_back(sift.descriptors);
+    compactDescriptors(sift, descriptors, DESCRIPTOR_PCA_INT8, compact);
+    CHECK(cv::norm(compact, cv::NORM_INF) < 127);
+
+    // stale or damaged files are rejected
+    CHECK(!CardModel::fromBuffer(file.data(), file.size(), blur + 2, nullptr, error));
+    CHECK(!CardModel::fromBuffer(file.data(), file.size() - 1, blur, nullptr, error));
+    CHECK(!CardModel::fromBuffer(file.data(), 16, blur, nullptr, error));
+    std::vector<uint8_t> damaged = file;
+    damaged.back() ^= 1;
+    CHECK(!CardModel::fromBuffer(damaged.data(), damaged.size(), blur, nullptr, error));
+    CHECK_EQ(error, std::string("checksum mismatch"));
+
+    return testResult();
+}
@@ -0,0 +1,48 @@
+#include "DetectorConfig.h"
+#include "TestCheck.h"
+
+#include <string>
+
+
+/**
+ * Config read from a JSON document with one key set.
+ */
+static DetectorConfig loadKey(const std::string& key, const std::string& value) {
+    DetectorConfig config;
+    CHECK(DetectorConfig::loadFromString("{\"" + key + "\": " + value + "}", config));
+    return config;
+}
+
+
+int main() {
+    // valid matchers are kept
+    CHECK_EQ(loadKey("card_matcher", "0").card_matcher, int(CARD_MATCH_FLANN));
+    CHECK_EQ(loadKey("card_matcher", "1").card_matcher, int(CARD_MATCH_INDEX));
+    CHECK_EQ(loadKey("card_matcher", "2").card_matcher, int(CARD_MATCH_BRUTE_FORCE));
+
+    // out of range values fall back to the default matcher
+    CHECK_EQ(DetectorConfig().card_matcher, int(CARD_MATCH_FLANN));
+    CHECK_EQ(loadKey("card_matcher", "-1").card_matcher, int(CARD_MATCH_FLANN));
+    CHECK_EQ(loadKey("card_matcher", "3").card_matcher, int(CARD_MATCH_FLANN));
+    CHECK_EQ(loadKey("card_matcher", "100").card_matcher, int(CARD_MATCH_FLANN));
+
+    // and so do descriptor formats
+    CHECK_EQ(loadKey("descriptor_format", "-1").descriptor_format, int(DESCRIPTOR_FLOAT));
+    CHECK_EQ(loadKey("descriptor_format", std::to_string(DESCRIPTOR_FORMAT_COUNT)).descriptor_format, int(DESCRIPTOR_FLOAT));
+
+    // an invalid value does not make the config custom
+    CHECK_EQ(loadKey("card_matcher", "7").name, DetectorConfig().name);
+
+    // the preset is applied first, the matcher is sanitized after it
+    DetectorConfig config;
+    CHECK(DetectorConfig::loadFromString("{\"preset\": \"fast\", \"card_matcher\": 9}", config));
+    CHECK_EQ(config.name, std::string("fast"));
+    CHECK_EQ(config.card_matcher, int(CARD_MATCH_FLANN));
+
+    // a document that is not a map leaves the config unchanged
+    config.card_matcher = CARD_MATCH_INDEX;
+    CHECK(!DetectorConfig::loadFromString("[1, 2]", config));
+    CHECK_EQ(config.card_matcher, int(CARD_MATCH_INDEX));
+
+    return testResult();
+}
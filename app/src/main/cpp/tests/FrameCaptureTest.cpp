@@ -0,0 +1,176 @@
+#include "FrameCapture.h"
+#include "TestCheck.h"
+
+#include <string.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <opencv2/imgproc.hpp>
+
+
+/**
+ * Frame buffer in the layout of 'format': camera-like gradients with noise, which the packed codec shrinks,
+ * or plain noise, which it does not.
+ */
+static cv::Mat testPixels(int format, cv::Size size, bool noise, cv::RNG& rng) {
+    int rows = format == PIXEL_NV21 || format == PIXEL_I420 ? size.height * 3 / 2 : size.height;
+    int channels = format == PIXEL_BGR ? 3 : format == PIXEL_RGBA ? 4 : 1;
+    cv::Mat pixels(rows, size.width, CV_8UC(channels));
+    if (noise) {
+        rng.fill(pixels, cv::RNG::UNIFORM, 0, 256);
+        return pixels;
+    }
+    for (int y = 0; y < rows; y++) {
+        uchar* row = pixels.ptr<uchar>(y);
+        for (int x = 0; x < size.width * channels; x++) {
+            row[x] = cv::saturate_cast<uchar>(x / channels + y * 2 + x % channels * 30 + rng.uniform(-3, 4));
+        }
+    }
+    return pixels;
+}
+
+static bool sameBytes(const cv::Mat& a, const cv::Mat& b) {
+    return a.size() == b.size() && a.type() == b.type() && a.isContinuous() && b.isContinuous()
+           && memcmp(a.data, b.data, a.total() * a.elemSize()) == 0;
+}
+
+/**
+ * Add frames one at a time, waiting for each to be written, so the recorder drops none.
+ * @return frames written
+ */
+static int64_t record(FrameRecorder& recorder, const std::vector<CapturedFrame>& frames) {
+    for (const CapturedFrame& frame : frames) {
+        int64_t before = recorder.framesWritten();
+        if (!recorder.add(frame.image, frame.rotation, frame.id, frame.timestamp_ns)) break;
+        while (recorder.framesWritten() == before && !recorder.isFull()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    return recorder.framesWritten();
+}
+
+/**
+ * Read all frames of a capture and compare them with the recorded ones.
+ */
+static void checkFrames(CaptureReader& reader, const std::vector<CapturedFrame>& frames, size_t count) {
+    CHECK_EQ(reader.frameCount(), count);
+    std::string error;
+    for (size_t i = 0; i < std::min(reader.frameCount(), frames.size()); i++) {
+        CapturedFrame frame;
+        CHECK(reader.frame(i, frame, error));
+        CHECK_EQ(frame.id, frames[i].id);
+        CHECK_EQ(frame.timestamp_ns, frames[i].timestamp_ns - frames[0].timestamp_ns);
+        CHECK_EQ(frame.rotation, frames[i].rotation);
+        CHECK_EQ(frame.image.format(), frames[i].image.format());
+        CHECK(frame.image.size() == frames[i].image.size());
+        CHECK(sameBytes(frame.image.pixels(), frames[i].image.pixels()));
+    }
+}
+
+static std::vector<char> readBytes(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeBytes(const std::string& path, const std::vector<char>& bytes, size_t length) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), std::streamsize(length));
+}
+
+
+int main() {
+    const std::string path = "frame-capture-test.treecap";
+    const std::string damaged_path = "frame-capture-test-damaged.treecap";
+    cv::RNG rng(3);
+
+    // every pixel format, odd sizes where the format allows them, frames which pack and frames which do not
+    std::vector<CapturedFrame> frames;
+    for (int format = 0; format < PIXEL_FORMAT_COUNT; format++) {
+        bool yuv = format == PIXEL_NV21 || format == PIXEL_I420;
+        for (bool noise : {false, true}) {
+            cv::Size size = yuv ? cv::Size(64, 38) : cv::Size(37, 23);
+            CapturedFrame frame;
+            frame.id = int64_t(frames.size()) * 2 + 5;
+            frame.timestamp_ns = 1000000000 + int64_t(frames.size()) * 33000000;
+            frame.rotation = int(frames.size() % 4) * 90;
+            frame.image = SourceImage::wrap(testPixels(format, size, noise, rng), format);
+            frames.push_back(frame);
+        }
+    }
+
+    CaptureInfo info;
+    info.device = "host test";
+    info.deadline_ms = 150;
+    info.start_time_ms = 1700000000123;
+    info.opencv_version = CV_VERSION;
+
+    // round trip through both codecs, with the same recorder opened twice
+    FrameRecorder recorder;
+    for (int codec : {CAPTURE_PACKED, CAPTURE_RAW}) {
+        CHECK(recorder.open(path, info, codec));
+        CHECK(!recorder.open(path, info, codec));
+        CHECK_EQ(record(recorder, frames), int64_t(frames.size()));
+        CHECK(recorder.close());
+        CHECK_EQ(recorder.framesDropped(), int64_t(0));
+        CHECK(!recorder.add(frames[0].image, 0, 0, 0));
+
+        CaptureReader reader;
+        std::string error;
+        CHECK(reader.open(path, error));
+        CHECK(reader.isComplete());
+        CHECK_EQ(reader.fileSize(), size_t(recorder.bytesWritten()));
+        CHECK_EQ(reader.info().device, info.device);
+        CHECK_EQ(reader.info().deadline_ms, info.deadline_ms);
+        CHECK_EQ(reader.info().start_time_ms, info.start_time_ms);
+        checkFrames(reader, frames, frames.size());
+    }
+
+    // a capture cut short in its last frame keeps the frames before; the raw capture ends with a
+    // frame chunk of 3712 bytes, an index chunk of 128 and the footer of 16
+    std::vector<char> file = readBytes(path);
+    {
+        writeBytes(damaged_path, file, file.size() - 300);
+        CaptureReader reader;
+        std::string error;
+        CHECK(reader.open(damaged_path, error));
+        CHECK(!reader.isComplete());
+        checkFrames(reader, frames, frames.size() - 1);
+    }
+
+    // a footer pointing past the end of the file, also by an overflowing offset, falls back to the chunks
+    for (uint64_t index_offset : {uint64_t(file.size()), ~uint64_t(0) - 8}) {
+        std::vector<char> damaged = file;
+        memcpy(damaged.data() + damaged.size() - 16, &index_offset, sizeof(index_offset));
+        writeBytes(damaged_path, damaged, damaged.size());
+        CaptureReader reader;
+        std::string error;
+        CHECK(reader.open(damaged_path, error));
+        CHECK(!reader.isComplete());
+        checkFrames(reader, frames, frames.size());
+    }
+
+    // the size limit stops the recording, the capture stays complete; the first two frames take 2624 bytes each
+    CHECK(recorder.open(path, info, CAPTURE_RAW));
+    uint64_t start_bytes = recorder.bytesWritten();
+    CHECK(recorder.close());
+    uint64_t max_bytes = start_bytes + 2 * 2624 + 100;
+    CHECK(recorder.open(path, info, CAPTURE_RAW, max_bytes));
+    CHECK_EQ(record(recorder, frames), int64_t(2));
+    CHECK(recorder.isFull());
+    CHECK(!recorder.add(frames[0].image, 0, 0, 0));
+    CHECK(recorder.close());
+    CHECK(recorder.bytesWritten() <= max_bytes + 64 + 16);
+    {
+        CaptureReader reader;
+        std::string error;
+        CHECK(reader.open(path, error));
+        CHECK(reader.isComplete());
+        checkFrames(reader, frames, 2);
+    }
+
+    std::remove(path.c_str());
+    std::remove(damaged_path.c_str());
+    return testResult();
+}
@@ -0,0 +1,91 @@
+#include "GrayResizeBlur.h"
+#include "TestCheck.h"
+
+#include <opencv2/imgproc.hpp>
+
+
+/**
+ * Photo-like test image: smooth gradients with texture and sharp edges, random noise otherwise.
+ */
+static cv::Mat testImage(cv::Size size, int channels, bool noise, cv::RNG& rng) {
+    cv::Mat image(size, CV_8UC(channels));
+    if (noise) {
+        rng.fill(image, cv::RNG::UNIFORM, 0, 256);
+        return image;
+    }
+    for (int y = 0; y < size.height; y++) {
+        uchar* row = image.ptr<uchar>(y);
+        for (int x = 0; x < size.width; x++) {
+            for (int c = 0; c < channels; c++) {
+                row[x * channels + c] = cv::saturate_cast<uchar>(x * 255 / size.width + (c * 40 + y) % 64 + rng.uniform(-8, 8));
+            }
+        }
+    }
+    for (int i = 0; i < 30; i++) {
+        cv::Point corner(rng.uniform(0, size.width), rng.uniform(0, size.height));
+        cv::rectangle(image, corner, corner + cv::Point(rng.uniform(5, size.width / 4), rng.uniform(5, size.height / 4)),
+                      cv::Scalar::all(rng.uniform(0, 256)), cv::FILLED);
+    }
+    return image;
+}
+
+/**
+ * The cvtColor + resize + GaussianBlur chain grayResizeBlur replaces.
+ */
+static cv::Mat chain(const cv::Mat& src, cv::Size dsize, int blur, bool rgb_order) {
+    cv::Mat gray, dst;
+    if (src.channels() == 1) gray = src;
+    else if (src.channels() == 3) cv::cvtColor(src, gray, rgb_order ? cv::COLOR_RGB2GRAY : cv::COLOR_BGR2GRAY);
+    else cv::cvtColor(src, gray, rgb_order ? cv::COLOR_RGBA2GRAY : cv::COLOR_BGRA2GRAY);
+    cv::resize(gray, dst, dsize, 0, 0, cv::INTER_LINEAR);
+    if (blur > 1) cv::GaussianBlur(dst, dst, cv::Size(blur, blur), 0);
+    return dst;
+}
+
+
+int main() {
+    cv::RNG rng(7);
+    const cv::Size sizes[] = {cv::Size(1200, 1600), cv::Size(3025, 4033), cv::Size(1001, 757), cv::Size(640, 480)};
+    const int widths[] = {1000, 640, 333, 320};
+    const int blurs[] = {1, 3, 5, 7};
+
+    for (cv::Size size : sizes) {
+        for (int channels : {1, 3, 4}) {
+            for (bool noise : {false, true}) {
+                cv::Mat src = testImage(size, channels, noise, rng);
+                for (int width : widths) {
+                    if (width > size.width) continue;
+                    cv::Size dsize(width, cvRound(double(width) / size.width * size.height));
+                    for (int blur : blurs) {
+                        for (bool rgb_order : {false, true}) {
+                            cv::Mat fused;
+                            grayResizeBlur(src, fused, dsize, blur, rgb_order);
+                            cv::Mat expected = chain(src, dsize, blur, rgb_order);
+                            CHECK(fused.size() == dsize && fused.type() == CV_8U);
+                            if (fused.size() != expected.size() || fused.type() != expected.type()) continue;
+
+                            double max_diff = cv::norm(fused, expected, cv::NORM_INF);
+                            if (max_diff > 1) {
+                                std::cerr << size << " x" << channels << (noise ? " noise" : " photo") << " -> " << dsize
+                                          << " blur " << blur << (rgb_order ? " rgb" : " bgr") << ": max diff " << max_diff << std::endl;
+                            }
+                            CHECK(max_diff <= 1);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // the stripes are independent, the result does not depend on the thread count
+    cv::Mat src = testImage(cv::Size(2000, 1500), 3, false, rng);
+    cv::Mat parallel, serial;
+    grayResizeBlur(src, parallel, cv::Size(1000 - 7, 743), 5);
+    int threads = cv::getNumThreads();
+    cv::setNumThreads(1);
+    grayResizeBlur(src, serial, cv::Size(1000 - 7, 743), 5);
+    cv::setNumThreads(threads);
+    CHECK(cv::norm(parallel, serial, cv::NORM_INF) == 0);
+
+    return testResult();
+}
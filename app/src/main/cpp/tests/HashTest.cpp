@@ -0,0 +1,47 @@
+#include "Hash.h"
+#include "TestCheck.h"
+
+#include <string.h>
+#include <vector>
+
+
+/**
+ * Buffer of the reference vectors: bytes of the successive squares of PRIME32_1, like xxHash's sanity check.
+ */
+static std::vector<uint8_t> sanityBuffer(size_t length) {
+    std::vector<uint8_t> buffer(length);
+    uint64_t generator = 2654435761ULL;
+    for (size_t i = 0; i < length; i++) {
+        buffer[i] = uint8_t(generator >> 24);
+        generator *= generator;
+    }
+    return buffer;
+}
+
+
+int main() {
+    // reference values of the xxHash library
+    CHECK_EQ(xxh64("", 0), 0xEF46DB3751D8E999ULL);
+    CHECK_EQ(xxh64("a", 1), 0xD24EC4F1A98C6E5BULL);
+    CHECK_EQ(xxh64("abc", 3), 0x44BC2CF5AD770999ULL);
+    const char* text = "Nobody inspects the spammish repetition";
+    CHECK_EQ(xxh64(text, strlen(text)), 0xFBCEA83C8A378BF1ULL);
+
+    // lengths below and above the 32 byte stripe, with and without seed
+    std::vector<uint8_t> buffer = sanityBuffer(222);
+    const uint64_t seed = 2654435761ULL;
+    CHECK_EQ(xxh64(buffer.data(), 0, seed), 0xAC75FDA2929B17EFULL);
+    CHECK_EQ(xxh64(buffer.data(), 1), 0x4FCE394CC88952D8ULL);
+    CHECK_EQ(xxh64(buffer.data(), 1, seed), 0x739840CB819FA723ULL);
+    CHECK_EQ(xxh64(buffer.data(), 14), 0xCFFA8DB881BC3A3DULL);
+    CHECK_EQ(xxh64(buffer.data(), 14, seed), 0x5B9611585EFCC9CBULL);
+    CHECK_EQ(xxh64(buffer.data(), 222), 0x9DD507880DEBB03DULL);
+    CHECK_EQ(xxh64(buffer.data(), 222, seed), 0xDC515172B8EE0600ULL);
+
+    // unaligned input
+    std::vector<uint8_t> shifted(buffer.size() + 1);
+    memcpy(shifted.data() + 1, buffer.data(), buffer.size());
+    CHECK_EQ(xxh64(shifted.data() + 1, 222), 0x9DD507880DEBB03DULL);
+
+    return testResult();
+}
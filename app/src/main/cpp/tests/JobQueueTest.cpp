@@ -0,0 +1,96 @@
+#include "tools/JobQueue.h"
+#include "TestCheck.h"
+
+#include <stdio.h>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+static std::vector<std::string> readLines(const std::string& path) {
+    std::ifstream in(path);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(in, line)) lines.push_back(line);
+    return lines;
+}
+
+static std::vector<std::string> drain(JobQueue& queue, size_t count) {
+    std::vector<std::string> jobs;
+    std::string job;
+    for (size_t i = 0; i < count && queue.pop(job); i++) jobs.push_back(job);
+    return jobs;
+}
+
+
+int main() {
+    const std::string journal = "job-queue-test.journal";
+    std::remove(journal.c_str());
+
+    // first run: a finished, b failed, c taken but not finished, d and e queued, then killed
+    {
+        std::unique_ptr<JobQueue> queue(new JobQueue());
+        CHECK(queue->open(journal));
+        for (const char* job : {"a", "b", "c", "d", "e"}) CHECK(queue->push(job));
+        CHECK(!queue->push("c"));
+        CHECK(!queue->push(""));
+        CHECK(!queue->push("x\ny"));
+        std::vector<std::string> taken = drain(*queue, 3);
+        CHECK(taken == std::vector<std::string>({"a", "b", "c"}));
+        queue->finish("a", 0);
+        queue->finish("b", 3);
+        JobQueueStats stats = queue->snapshot();
+        CHECK_EQ(stats.queued, size_t(2));
+        CHECK_EQ(stats.running, size_t(1));
+        CHECK_EQ(stats.done, size_t(2));
+        CHECK_EQ(stats.failed, size_t(1));
+        // no close() and no checkpoint, like a killed daemon
+    }
+
+    // a record torn by the kill is ignored
+    {
+        FILE* out = fopen(journal.c_str(), "a");
+        fputs("Q torn", out);
+        fclose(out);
+    }
+
+    // second run: the unfinished jobs come back, the one being measured first
+    {
+        JobQueue queue;
+        CHECK(queue.open(journal));
+        JobQueueStats stats = queue.snapshot();
+        CHECK_EQ(stats.recovered, size_t(3));
+        CHECK_EQ(stats.queued, size_t(3));
+        CHECK_EQ(stats.done, size_t(2));
+        CHECK_EQ(stats.failed, size_t(1));
+        CHECK(queue.isKnown("a"));
+        CHECK(!queue.isKnown("torn"));
+        CHECK(!queue.push("a"));
+        CHECK(!queue.push("d"));
+        CHECK(drain(queue, 3) == std::vector<std::string>({"c", "d", "e"}));
+        queue.finish("c", 0);
+        queue.finish("unknown", 0);
+        CHECK_EQ(queue.snapshot().done, size_t(3));
+
+        // the open rewrote the journal to one record per path, a checkpoint keeps it that way
+        CHECK(queue.checkpoint(true));
+        CHECK_EQ(readLines(journal).size(), size_t(5));
+        queue.close();
+        std::string job;
+        CHECK(!queue.pop(job));
+    }
+
+    // third run: d and e were taken but not finished
+    {
+        JobQueue queue;
+        CHECK(queue.open(journal));
+        CHECK_EQ(queue.snapshot().recovered, size_t(2));
+        CHECK_EQ(queue.snapshot().done, size_t(3));
+        CHECK(drain(queue, 2) == std::vector<std::string>({"d", "e"}));
+    }
+
+    std::remove(journal.c_str());
+    return testResult();
+}
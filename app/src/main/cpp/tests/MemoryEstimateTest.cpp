@@ -0,0 +1,120 @@
+#include "ObjectDetector.h"
+#include "ResolutionScheduler.h"
+#include "MemoryUsage.h"
+#include "TestCheck.h"
+
+#include <malloc.h>
+#include <thread>
+#include <opencv2/imgproc.hpp>
+
+static const double MAX_UNDERESTIMATE = 1.25;   // measured peak may exceed the prediction by this factor
+static const double MIN_PEAK_FRACTION = 0.5;    // and has to reach this fraction of it, SIFT dominates both
+
+
+/**
+ * Textured card-like image.
+ */
+static cv::Mat syntheticCard() {
+    cv::Mat card(260, 420, CV_8UC3, cv::Scalar(235, 235, 235));
+    cv::RNG rng(42);
+    for (int i = 0; i < 60; i++) {
+        cv::Point corner(rng.uniform(0, card.cols - 40), rng.uniform(0, card.rows - 30));
+        cv::Scalar color(rng.uniform(0, 200), rng.uniform(0, 200), rng.uniform(0, 200));
+        cv::rectangle(card, corner, corner + cv::Point(rng.uniform(8, 40), rng.uniform(6, 30)), color, cv::FILLED);
+    }
+    cv::putText(card, "TREEO 4711", cv::Point(30, 200), cv::FONT_HERSHEY_SIMPLEX, 1.5, cv::Scalar(20, 60, 20), 3);
+    return card;
+}
+
+/**
+ * Photo of the card on a trunk in front of foliage, at the size of a decoded phone photo.
+ */
+static cv::Mat syntheticPhoto(const cv::Mat& card, cv::Size size) {
+    cv::Mat photo(size, CV_8UC3, cv::Scalar(40, 140, 60));
+    cv::RNG rng(7);
+    for (int i = 0; i < 200; i++) {
+        cv::Point corner(rng.uniform(0, size.width), rng.uniform(0, size.height));
+        cv::rectangle(photo, corner, corner + cv::Point(rng.uniform(10, 60), rng.uniform(10, 60)),
+                      cv::Scalar(rng.uniform(20, 90), rng.uniform(60, 180), rng.uniform(40, 120)), cv::FILLED);
+    }
+    cv::rectangle(photo, cv::Point(size.width * 3 / 8, 0), cv::Point(size.width * 5 / 8, size.height),
+                  cv::Scalar(50, 70, 110), cv::FILLED);
+    cv::Mat scaled;
+    cv::resize(card, scaled, cv::Size(size.width / 5, size.width / 5 * card.rows / card.cols));
+    scaled.copyTo(photo(cv::Rect((size.width - scaled.cols) / 2, size.height / 2, scaled.cols, scaled.rows)));
+    return photo;
+}
+
+/**
+ * Peak resident memory of one measurement above the resident size before it. It runs on a new thread, so it
+ * starts with an empty ScratchPool like the first photo of the app. Memory freed earlier is returned to the
+ * system first, the allocator would reuse it without raising the peak. VmHWM is per process, nothing else
+ * may run meanwhile.
+ * @return bytes
+ */
+static size_t measuredBytes(const ObjectDetector& detector, const cv::Mat& photo, const MeasureOptions& options,
+                            MeasureResult& result) {
+    size_t used = 0;
+    std::thread thread([&]() {
+        malloc_trim(0);
+        resetPeakResident();
+        size_t before = residentBytes();
+        detector.measureTree(SourceImage::wrap(photo, PIXEL_BGR), options, result);
+        size_t peak = peakResidentBytes();
+        used = peak > before ? peak - before : 0;
+    });
+    thread.join();
+    return used;
+}
+
+/**
+ * Compare the prediction for the widths the measurement runs at with its measured peak.
+ */
+static void checkEstimate(const DetectorConfig& config, std::shared_ptr<const CardModel> model, const cv::Mat& photo,
+                          size_t budget) {
+    const ObjectDetector detector(model, std::make_shared<const DetectorConfig>(config));
+    MeasureOptions options;
+    options.memory_budget_bytes = budget;
+    DetectorConfig frame_config = config;
+    if (budget != NO_MEMORY_BUDGET) ResolutionScheduler::fitMemory(photo.size(), budget, frame_config);
+    size_t predicted = ResolutionScheduler::predictBytes(photo.size(), frame_config);
+
+    MeasureResult result;
+    size_t used = measuredBytes(detector, photo, options, result);
+    std::cout << config.name << ", card " << frame_config.card_resize_width << " px, tree " << frame_config.tree_resize_width
+              << " px, budget " << budget / 1024 << " kB: predicted " << predicted / 1024 << " kB, peak " << used / 1024
+              << " kB, code " << result.code << std::endl;
+    CHECK(used <= predicted * MAX_UNDERESTIMATE);
+    CHECK(used >= predicted * MIN_PEAK_FRACTION);
+    if (budget != NO_MEMORY_BUDGET) {
+        CHECK(result.degradations & DEGRADE_CARD_RESOLUTION);
+        CHECK(used <= budget * MAX_UNDERESTIMATE);
+    }
+}
+
+
+int main() {
+    if (!resetPeakResident()) {
+        std::cerr << "/proc/self/clear_refs is not supported, nothing to compare" << std::endl;
+        return testResult();
+    }
+    // the per-pixel model is single-threaded, parallel workers add buffers of their own
+    cv::setNumThreads(1);
+
+    cv::Mat card = syntheticCard();
+    cv::Mat photo = syntheticPhoto(card, cv::Size(1512, 2016));
+    std::shared_ptr<const CardModel> model = CardModel::build(card, DetectorConfig().card_template_blur);
+    CHECK(model != nullptr);
+    if (!model) return testResult();
+
+    // the configured widths of the presets
+    for (const char* preset : {"fast", "balanced"}) {
+        checkEstimate(DetectorConfig::preset(preset), model, photo, NO_MEMORY_BUDGET);
+    }
+
+    // a budget of a third of the balanced peak lowers both widths
+    DetectorConfig config;
+    checkEstimate(config, model, photo, ResolutionScheduler::predictBytes(photo.size(), config) / 3);
+
+    return testResult();
+}
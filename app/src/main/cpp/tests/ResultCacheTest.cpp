@@ -0,0 +1,104 @@
+#include "ResultCache.h"
+#include "TestCheck.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+
+static CachedResult makeResult(int i) {
+    CachedResult result;
+    result.code = i;
+    result.diameter = 10.5 + i;
+    for (int k = 0; k < 4; k++) {
+        result.card.push_back(cv::Point2f(float(i + k), float(2 * k)));
+        if (i % 2 == 0) result.tree.push_back(cv::Point2f(float(k), float(i - k)));
+    }
+    return result;
+}
+
+static bool sameResult(const CachedResult& a, const CachedResult& b) {
+    if (a.code != b.code || a.diameter != b.diameter || a.card.size() != b.card.size() || a.tree.size() != b.tree.size()) {
+        return false;
+    }
+    for (size_t k = 0; k < a.card.size(); k++) {
+        if (a.card[k] != b.card[k]) return false;
+    }
+    for (size_t k = 0; k < a.tree.size(); k++) {
+        if (a.tree[k] != b.tree[k]) return false;
+    }
+    return true;
+}
+
+static std::vector<char> readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::vector<char>& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), std::streamsize(data.size()));
+}
+
+
+int main() {
+    const std::string path = "result-cache-test.bin";
+    CachedResult result;
+
+    // LRU eviction
+    ResultCache cache(3);
+    for (int i = 0; i < 4; i++) cache.store(i, 7, makeResult(i));
+    CHECK_EQ(cache.size(), size_t(3));
+    CHECK(!cache.lookup(0, 7, result));
+    CHECK(cache.lookup(1, 7, result));     // 1 becomes the most recent
+    CHECK(!cache.lookup(1, 8, result));    // other config version
+    cache.store(4, 7, makeResult(4));
+    CHECK(!cache.lookup(2, 7, result));
+    CHECK_EQ(cache.hits(), size_t(1));
+    CHECK_EQ(cache.misses(), size_t(3));
+
+    // round trip keeps results and recency order
+    CHECK(cache.save(path));
+    ResultCache loaded(3);
+    CHECK(loaded.load(path));
+    CHECK_EQ(loaded.size(), size_t(3));
+    for (int i : {1, 3, 4}) {
+        CHECK(loaded.lookup(i, 7, result));
+        CHECK(sameResult(result, makeResult(i)));
+    }
+    ResultCache ordered(3);
+    CHECK(ordered.load(path));
+    ordered.store(5, 7, makeResult(5));    // evicts 3, the least recently used before saving
+    CHECK(!ordered.lookup(3, 7, result));
+    CHECK(ordered.lookup(1, 7, result));
+
+    // a smaller cache keeps the most recent records
+    ResultCache small(1);
+    CHECK(small.load(path));
+    CHECK_EQ(small.size(), size_t(1));
+    CHECK(small.lookup(4, 7, result));
+
+    // a corrupt count or a truncated file is rejected before allocating and leaves the cache unchanged
+    std::vector<char> data = readFile(path);
+    std::vector<char> corrupt = data;
+    uint32_t huge = 0x7fffffff;
+    memcpy(corrupt.data() + 8, &huge, sizeof(huge));
+    writeFile(path, corrupt);
+    ResultCache rejected(3);
+    rejected.store(9, 7, makeResult(9));
+    CHECK(!rejected.load(path));
+    CHECK_EQ(rejected.size(), size_t(1));
+
+    writeFile(path, std::vector<char>(data.begin(), data.end() - 1));
+    CHECK(!rejected.load(path));
+    writeFile(path, std::vector<char>(data.begin(), data.begin() + 4));
+    CHECK(!rejected.load(path));
+    CHECK_EQ(rejected.size(), size_t(1));
+
+    CHECK(!rejected.load("result-cache-test-missing.bin"));
+    std::remove(path.c_str());
+    return testResult();
+}
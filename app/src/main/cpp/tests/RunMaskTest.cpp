@@ -0,0 +1,154 @@
+#include "RunMask.h"
+#include "TreeDetection.h"
+#include "TestCheck.h"
+
+#include <set>
+#include <utility>
+#include <opencv2/imgproc.hpp>
+
+
+/**
+ * Grabcut labels: random ones, or smooth blobs of GC_PR_FGD.
+ */
+static cv::Mat randomLabels(int rows, int cols, bool smooth, cv::RNG& rng) {
+    cv::Mat labels(rows, cols, CV_8U);
+    if (smooth) {
+        cv::Mat noise(rows, cols, CV_32F);
+        rng.fill(noise, cv::RNG::UNIFORM, 0, 1);
+        cv::GaussianBlur(noise, noise, cv::Size(0, 0), 4);
+        cv::Mat blobs = noise > 0.5;
+        labels.setTo(cv::Scalar::all(cv::GC_BGD));
+        labels.setTo(cv::Scalar::all(cv::GC_PR_FGD), blobs);
+        return labels;
+    }
+    static const int LABELS[] = {cv::GC_BGD, cv::GC_BGD, cv::GC_BGD, cv::GC_FGD, cv::GC_FGD,
+                                 cv::GC_PR_BGD, cv::GC_PR_BGD, cv::GC_PR_FGD, cv::GC_PR_FGD, cv::GC_PR_FGD};
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) labels.at<uchar>(r, c) = uchar(LABELS[rng.uniform(0, 10)]);
+    }
+    return labels;
+}
+
+/**
+ * Trunk-like labels: a slanted band with ragged edges and some flipped pixels.
+ */
+static cv::Mat trunkLabels(int rows, int cols, cv::RNG& rng) {
+    cv::Mat labels = cv::Mat::zeros(rows, cols, CV_8U);
+    int left = rng.uniform(100, 300);
+    int width = rng.uniform(40, 200);
+    double slope = rng.uniform(-0.2, 0.2);
+    for (int y = 0; y < rows; y++) {
+        int start = std::max(0, int(left + slope * y + rng.gaussian(1.5)));
+        int end = std::min(cols, int(left + width + slope * y + rng.gaussian(1.5)));
+        if (end > start) labels.row(y).colRange(start, end).setTo(cv::Scalar::all(cv::GC_PR_FGD));
+    }
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < cols; x++) {
+            if (rng.uniform(0, 50) == 0) labels.at<uchar>(y, x) ^= cv::GC_PR_FGD;
+        }
+    }
+    return labels;
+}
+
+/**
+ * The dense mask RunMask::fromLabels stands for.
+ */
+static cv::Mat denseMask(const cv::Mat& labels, int col_offset, int cols) {
+    cv::Mat mask = cv::Mat::zeros(labels.rows, cols, CV_8U);
+    cv::Mat foreground;
+    cv::bitwise_and(labels, cv::Scalar::all(1), foreground);
+    foreground *= 255;
+    foreground.copyTo(mask.colRange(col_offset, col_offset + labels.cols));
+    return mask;
+}
+
+static bool sameMask(const RunMask& mask, const cv::Mat& expected) {
+    cv::Mat dense;
+    mask.toMat(dense);
+    return dense.size() == expected.size() && cv::countNonZero(dense != expected) == 0;
+}
+
+static std::set<std::pair<int, int>> pointSet(const std::vector<cv::Point>& points) {
+    std::set<std::pair<int, int>> result;
+    for (const cv::Point& p : points) result.insert(std::make_pair(p.x, p.y));
+    return result;
+}
+
+
+int main() {
+    cv::RNG rng(11);
+    RunMaskScratch scratch;
+
+    // morphology and boundary against OpenCV on random masks, with the band offset of a cropped grabcut
+    for (int t = 0; t < 300; t++) {
+        int rows = rng.uniform(5, 60), cols = rng.uniform(5, 60);
+        cv::Size kernel(rng.uniform(1, 8), rng.uniform(1, 8));
+        int offset = rng.uniform(0, cols / 2 + 1);
+        int band = rng.uniform(1, cols - offset + 1);
+        cv::Mat labels = randomLabels(rows, band, t % 2 == 1, rng);
+        cv::Mat dense = denseMask(labels, offset, cols);
+        cv::Mat element = cv::getStructuringElement(cv::MORPH_RECT, kernel);
+
+        RunMask mask;
+        mask.fromLabels(labels, offset, cols);
+        CHECK(sameMask(mask, dense));
+
+        cv::Mat expected;
+        RunMask opened = mask, closed = mask, dilated = mask, eroded = mask;
+        opened.open(kernel, scratch);
+        cv::morphologyEx(dense, expected, cv::MORPH_OPEN, element);
+        CHECK(sameMask(opened, expected));
+        closed.close(kernel, scratch);
+        cv::morphologyEx(dense, expected, cv::MORPH_CLOSE, element);
+        CHECK(sameMask(closed, expected));
+        dilated.dilate(kernel, scratch);
+        cv::dilate(dense, expected, element);
+        CHECK(sameMask(dilated, expected));
+        eroded.erode(kernel, scratch);
+        cv::erode(dense, expected, element);
+        CHECK(sameMask(eroded, expected));
+
+        // the pipeline extracts the boundary after open and close
+        opened.close(kernel, scratch);
+        cv::morphologyEx(dense, expected, cv::MORPH_OPEN, element);
+        cv::morphologyEx(expected, expected, cv::MORPH_CLOSE, element);
+        double low = rng.uniform(20, 400);
+        double high = rng.uniform(low, 1100.);
+        std::vector<cv::Point> boundary, edges;
+        opened.boundary(low, high, boundary, scratch);
+        cv::Mat canny;
+        cv::Canny(expected, canny, low, high, 3);
+        cv::findNonZero(canny, edges);
+        CHECK(pointSet(boundary) == pointSet(edges));
+    }
+
+    // the two strongest Hough lines of trunk masks, as findLines uses them
+    const cv::Size kernel(3, 7);
+    const cv::Mat element = cv::getStructuringElement(cv::MORPH_RECT, kernel);
+    for (int t = 0; t < 50; t++) {
+        int rows = rng.uniform(80, 250), cols = 600;
+        cv::Mat labels = trunkLabels(rows, cols, rng);
+        RunMask mask;
+        mask.fromLabels(labels, 0, cols);
+        mask.open(kernel, scratch);
+        mask.close(kernel, scratch);
+        std::vector<cv::Point> boundary;
+        mask.boundary(50, 200, boundary, scratch);
+        std::vector<cv::Vec2f> lines;
+        houghLines(boundary, cv::Size(cols, rows), 50, -1, 1, lines);
+
+        cv::Mat dense = denseMask(labels, 0, cols), canny;
+        cv::morphologyEx(dense, dense, cv::MORPH_OPEN, element);
+        cv::morphologyEx(dense, dense, cv::MORPH_CLOSE, element);
+        cv::Canny(dense, canny, 50, 200, 3);
+        std::vector<cv::Vec2f> expected;
+        cv::HoughLines(canny, expected, 1, CV_PI / 180, 50, 0, 0, -1, 1);
+
+        CHECK_EQ(std::min(lines.size(), size_t(2)), std::min(expected.size(), size_t(2)));
+        for (size_t i = 0; i < std::min(std::min(lines.size(), expected.size()), size_t(2)); i++) {
+            CHECK(fabsf(lines[i][0] - expected[i][0]) < 1e-4f && fabsf(lines[i][1] - expected[i][1]) < 1e-4f);
+        }
+    }
+
+    return testResult();
+}
@@ -0,0 +1,46 @@
+#ifndef TESTCHECK_H
+#define TESTCHECK_H
+
+#include <stdio.h>
+#include <iostream>
+
+
+/**
+ * Minimal checks of the host unit tests (tests/), each test is an executable run by ctest.
+ * A failed check is reported and counted, the test keeps running and main returns testResult().
+ */
+static int test_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        auto actual_value = (actual); \
+        auto expected_value = (expected); \
+        if (!(actual_value == expected_value)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #actual " == " #expected \
+                      << " (" << actual_value << " vs " << expected_value << ")" << std::endl; \
+            test_failures++; \
+        } \
+    } while (0)
+
+/**
+ * Report the failures.
+ * @return process exit code, 0 if all checks passed
+ */
+static inline int testResult() {
+    if (test_failures > 0) {
+        std::cerr << test_failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+#endif //TESTCHECK_H
@@ -0,0 +1,63 @@
+#include "Trace.h"
+#include "TestCheck.h"
+
+#include <set>
+#include <string>
+#include <thread>
+
+
+static size_t countOf(const std::string& text, const std::string& pattern) {
+    size_t count = 0;
+    for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1)) count++;
+    return count;
+}
+
+/**
+ * Trace thread ids of the spans in a dump.
+ */
+static std::set<int> tids(const std::string& json) {
+    std::set<int> result;
+    const std::string key = "\"tid\":";
+    for (size_t at = json.find(key); at != std::string::npos; at = json.find(key, at + 1)) {
+        result.insert(std::stoi(json.substr(at + key.size())));
+    }
+    return result;
+}
+
+static void spans(const char* name, int count) {
+    for (int i = 0; i < count; i++) {
+        trace::Span span(name);
+        span.counter("i", i);
+    }
+}
+
+
+int main() {
+    trace::setEnabled(true);
+
+    // threads running one after another may get the same buffer, their spans keep apart
+    std::thread first(spans, "first", 3);
+    first.join();
+    std::thread second(spans, "second", 2);
+    second.join();
+    std::string json = trace::dumpChromeJson();
+    CHECK_EQ(countOf(json, "\"name\":\"first\""), size_t(3));
+    CHECK_EQ(countOf(json, "\"name\":\"second\""), size_t(2));
+    CHECK_EQ(tids(json).size(), size_t(2));
+
+    // a dump only has the spans since the previous one
+    CHECK_EQ(countOf(trace::dumpChromeJson(), "\"ph\":\"X\""), size_t(0));
+    spans("third", 4);
+    json = trace::dumpChromeJson();
+    CHECK_EQ(countOf(json, "\"ph\":\"X\""), size_t(4));
+    CHECK_EQ(countOf(json, "\"name\":\"third\""), size_t(4));
+
+    // a wrapped ring keeps its newest events
+    spans("wrapped", trace::RING_SIZE + 10);
+    CHECK_EQ(countOf(trace::dumpChromeJson(), "\"name\":\"wrapped\""), size_t(trace::RING_SIZE));
+
+    trace::setEnabled(false);
+    spans("disabled", 2);
+    CHECK_EQ(countOf(trace::dumpChromeJson(), "\"ph\":\"X\""), size_t(0));
+    return testResult();
+}
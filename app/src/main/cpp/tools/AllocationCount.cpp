@@ -0,0 +1,98 @@
+//heap allocations per measurement (host build)
+#include "AllocationCounter.h"
+#include "CardModel.h"
+#include "DetectorConfig.h"
+#include "ObjectDetector.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <stdlib.h>
+#include <opencv2/imgcodecs.hpp>
+
+using namespace std;
+
+// ./alloc-count card.png [--config config.json] [--repeat N] [--threads N] photo.jpg...
+//
+// Counts the heap allocations of every measureTree call through malloc hooks (tools/AllocationCounter.h),
+// which also see operator new and OpenCV's own buffers. The first call of a photo fills the scratch pool,
+// later ones show the steady state of a stream of frames. 'large' are allocations of 64 KB or more,
+// i.e. image buffers and copies. For a before/after comparison build the tool at both commits.
+// Not with TREE_SANITIZER.
+
+static AllocationCount median(std::vector<AllocationCount> counts) {
+    std::sort(counts.begin(), counts.end(), [](const AllocationCount& a, const AllocationCount& b) { return a.count < b.count; });
+    return counts[counts.size() / 2];
+}
+
+int main(int argc, char const* argv[]) {
+
+    if (argc < 3) {
+        std::cerr << "Usage: ./alloc-count card.png [--config config.json] [--repeat N] [--threads N] photo.jpg..." << std::endl;
+        return 2;
+    }
+    std::string card_path = argv[1];
+    std::string config_path;
+    int repeat = 5;
+    int threads = -1;
+    std::vector<std::string> paths;
+
+    // parse args
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--config" || arg == "--repeat" || arg == "--threads") && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (arg == "--config") config_path = value;
+            else if (arg == "--threads") threads = atoi(value.c_str());
+            else repeat = std::max(2, atoi(value.c_str()));
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty()) {
+        std::cerr << "No photos given" << std::endl;
+        return 2;
+    }
+    if (threads > 0) cv::setNumThreads(threads);
+
+    DetectorConfig config;
+    if (!config_path.empty() && !DetectorConfig::load(config_path, config)) return 2;
+    // the same widths for every call, so the calls of a photo are comparable
+    config.adaptive_resolution = false;
+
+    std::shared_ptr<const CardModel> card_model = CardModel::build(cv::imread(card_path), config.card_template_blur);
+    if (!card_model) {
+        std::cerr << "Error: Unable to read card image file" << std::endl;
+        return 2;
+    }
+    const ObjectDetector detector(card_model, std::make_shared<const DetectorConfig>(config));
+
+    bool failed = false;
+    cout << "threads: " << cv::getNumThreads() << endl;
+    cout << "image,size,code,first_allocations,first_kb,first_large,allocations,kb,large" << endl;
+    for (const std::string& path : paths) {
+        cv::Mat image = cv::imread(path);
+        if (!image.data) {
+            std::cerr << "Error: Unable to read " << path << std::endl;
+            failed = true;
+            continue;
+        }
+
+        AllocationCount first;
+        std::vector<AllocationCount> steady;
+        MeasureResult result;
+        for (int r = 0; r < repeat; r++) {
+            result = MeasureResult();
+            AllocationCount before = allocationCount();
+            detector.measureTree(SourceImage::wrap(image, PIXEL_BGR), MeasureOptions(), result);
+            AllocationCount used = allocationCount() - before;
+            if (r == 0) first = used;
+            else steady.push_back(used);
+        }
+        AllocationCount typical = median(steady);
+        cout << path << "," << image.cols << "x" << image.rows << "," << result.code << ","
+             << first.count << "," << first.bytes / 1024 << "," << first.large << ","
+             << typical.count << "," << typical.bytes / 1024 << "," << typical.large << endl;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+
+/**
+ * Counting heap hooks of the host tools (glibc). Replaces malloc, calloc, realloc and the aligned
+ * allocators of the executable; operator new and cv::fastMalloc go through them, so allocations
+ * inside OpenCV and its worker threads are counted too. Include in exactly one translation unit.
+ * Not together with TREE_SANITIZER, the sanitizers replace the same functions.
+ */
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+/**
+ * Allocations since the process started.
+ */
+struct AllocationCount {
+    uint64_t count = 0;         /**< Allocations, a growing realloc counts as one */
+    uint64_t bytes = 0;         /**< Requested bytes */
+    uint64_t large = 0;         /**< Allocations of at least LARGE_ALLOCATION bytes, image buffers */
+};
+
+static const size_t LARGE_ALLOCATION = 64 * 1024;
+
+namespace allocation_counter {
+    static std::atomic<uint64_t> count(0);
+    static std::atomic<uint64_t> bytes(0);
+    static std::atomic<uint64_t> large(0);
+
+    static inline void add(size_t size) {
+        count.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+        if (size >= LARGE_ALLOCATION) large.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Current counters, subtract two of them for the allocations in between.
+ */
+static inline AllocationCount allocationCount() {
+    AllocationCount result;
+    result.count = allocation_counter::count.load(std::memory_order_relaxed);
+    result.bytes = allocation_counter::bytes.load(std::memory_order_relaxed);
+    result.large = allocation_counter::large.load(std::memory_order_relaxed);
+    return result;
+}
+
+static inline AllocationCount operator-(const AllocationCount& a, const AllocationCount& b) {
+    AllocationCount result;
+    result.count = a.count - b.count;
+    result.bytes = a.bytes - b.bytes;
+    result.large = a.large - b.large;
+    return result;
+}
+
+extern "C" {
+
+void* malloc(size_t size) {
+    allocation_counter::add(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    allocation_counter::add(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (size > 0) allocation_counter::add(size);
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    allocation_counter::add(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) return EINVAL;
+    void* p = memalign(alignment, size);
+    if (!p) return ENOMEM;
+    *ptr = p;
+    return 0;
+}
+
+}
+
+
+#endif //ALLOCATIONCOUNTER_H
@@ -0,0 +1,196 @@
+//search of detector parameters for the latency/accuracy Pareto front over the golden dataset (host build)
+#include "GoldenSet.h"
+#include "ObjectDetector.h"
+#include "DetectorConfig.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <stdlib.h>
+#include <math.h>
+#include <opencv2/imgcodecs.hpp>
+
+using namespace std;
+
+// ./auto-tuner --card card.png --set manifest.json [--trials N] [--seed S] [--repeat N]
+//              [--penalty mm] [--base config.json] [--out dir]
+
+
+/**
+ * One evaluated configuration.
+ */
+struct Candidate {
+    DetectorConfig config;
+    GoldenReport report;
+    double error = 0;           /**< MAE plus penalty for failed samples */
+    bool pareto = false;
+};
+
+
+static void usage() {
+    std::cerr << "Usage: ./auto-tuner --card card.png --set manifest.json [--trials N] [--seed S] [--repeat N]" << std::endl
+              << "       [--penalty mm] [--base config.json] [--out dir]" << std::endl;
+}
+
+
+/**
+ * Random configuration around the base one. Every parameter is drawn from the range the pipeline still works in.
+ * @param base parameters which are not searched (HSV range)
+ * @param rng random generator
+ * @return configuration named "custom"
+ */
+static DetectorConfig randomConfig(const DetectorConfig& base, std::mt19937& rng) {
+    auto pick = [&rng](std::initializer_list<int> values) {
+        std::uniform_int_distribution<size_t> dist(0, values.size() - 1);
+        return *(values.begin() + dist(rng));
+    };
+    std::uniform_real_distribution<float> ratio(0.4f, 0.75f);
+    std::uniform_real_distribution<float> seed_width(0.06f, 0.16f);
+    std::uniform_real_distribution<double> hough_scale(0.7, 1.3);
+
+    DetectorConfig config = base;
+    config.name = "custom";
+    config.card_resize_width = pick({600, 800, 1000, 1200, 1400});
+    config.card_image_blur = pick({3, 5, 7});
+    config.card_template_blur = pick({1, 3, 5});
+    config.ratio_thresh = ratio(rng);
+    config.min_good_matches = pick({4, 5, 6, 8});
+    config.tree_resize_width = pick({300, 400, 500, 600, 700, 800});
+    config.tree_blur = pick({1, 3, 5});
+    config.grabcut_iterations = pick({2, 3, 4, 5, 6, 8});
+    config.seed_line_width = seed_width(rng);
+    config.canny_low = pick({30, 50, 80});
+    config.canny_high = config.canny_low * pick({3, 4});
+    // Hough votes grow with the image size, so the balanced threshold is scaled with the width
+    config.hough_threshold = std::max(10, int(round(50.0 * config.tree_resize_width / 600 * hough_scale(rng))));
+    return config;
+}
+
+
+/**
+ * Mark candidates which are not dominated in (latency p50, error).
+ * @param candidates evaluated configurations
+ */
+static void markPareto(std::vector<Candidate>& candidates) {
+    for (Candidate& c : candidates) {
+        c.pareto = true;
+        for (const Candidate& o : candidates) {
+            bool not_worse = o.report.latency_p50 <= c.report.latency_p50 && o.error <= c.error;
+            bool better = o.report.latency_p50 < c.report.latency_p50 || o.error < c.error;
+            if (not_worse && better) {
+                c.pareto = false;
+                break;
+            }
+        }
+    }
+}
+
+
+int main(int argc, char const* argv[]) {
+
+    std::string card_path, set_path, base_path, out_dir = ".";
+    int trials = 30;
+    int repeat = 1;
+    unsigned seed = 1;
+    double penalty = 50;
+
+    // parse args
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--card") card_path = value;
+        else if (arg == "--set") set_path = value;
+        else if (arg == "--trials") trials = atoi(value.c_str());
+        else if (arg == "--seed") seed = unsigned(atoi(value.c_str()));
+        else if (arg == "--repeat") repeat = atoi(value.c_str());
+        else if (arg == "--penalty") penalty = atof(value.c_str());
+        else if (arg == "--base") base_path = value;
+        else if (arg == "--out") out_dir = value;
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (card_path.empty() || set_path.empty()) {
+        usage();
+        return 2;
+    }
+
+    std::vector<GoldenSample> samples = loadGoldenSet(set_path);
+    if (samples.empty()) {
+        std::cerr << "Error: Golden set is empty" << std::endl;
+        return 2;
+    }
+    cv::Mat card = cv::imread(card_path);
+    if (card.empty()) {
+        std::cerr << "Error: Unable to read card image file" << std::endl;
+        return 2;
+    }
+    DetectorConfig base;
+    if (!base_path.empty() && !DetectorConfig::load(base_path, base)) return 2;
+
+    // presets first, so the random search is compared against them
+    std::vector<DetectorConfig> configs = {
+            DetectorConfig::preset("fast"), DetectorConfig::preset("balanced"), DetectorConfig::preset("accurate")};
+    if (!base_path.empty()) configs.push_back(base);
+    std::mt19937 rng(seed);
+    for (int t = 0; t < trials; t++) {
+        configs.push_back(randomConfig(base, rng));
+    }
+
+    std::vector<Candidate> candidates;
+    for (size_t i = 0; i < configs.size(); i++) {
+        ObjectDetector detector(card, configs[i]);
+        GoldenRunner runner = [&detector](const cv::Mat& image) {
+            SampleRun run;
+            std::vector<cv::Point2f> tree;
+            run.code = detector.measureTree(SourceImage::wrap(image, PIXEL_BGR), run.card, tree, run.diameter);
+            return run;
+        };
+
+        Candidate candidate;
+        candidate.config = configs[i];
+        GoldenSampleStart sample_start = [&detector]() { detector.resetScheduler(); };
+        candidate.report = evaluateGoldenSet(samples, runner, repeat, nullptr, sample_start);
+        if (candidate.report.unreadable > 0) {
+            std::cerr << "Error: " << candidate.report.unreadable << " images of the golden set could not be read" << std::endl;
+            return 1;
+        }
+        candidate.error = candidate.report.mae + candidate.report.failure_rate * penalty;
+        candidates.push_back(candidate);
+
+        std::clog << "[" << i + 1 << "/" << configs.size() << "] " << configs[i].name << std::fixed << std::setprecision(2)
+                  << ": p50 " << candidate.report.latency_p50 << " ms, error " << candidate.error << " mm" << std::endl;
+    }
+
+    markPareto(candidates);
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b) { return a.report.latency_p50 < b.report.latency_p50; });
+
+    // summary of all candidates, Pareto ones saved as loadable configs
+    std::ofstream csv(out_dir + "/tuning.csv");
+    csv << "name,version,pareto,latency_p50,latency_p99,mae,failure_rate,error,config" << std::endl;
+    int pareto_index = 0;
+    std::cout << "Pareto front (p50 latency vs. MAE + " << penalty << " mm x failure rate):" << std::endl;
+    for (const Candidate& c : candidates) {
+        csv << c.config.name << "," << std::hex << c.config.version() << std::dec << "," << c.pareto << ","
+            << c.report.latency_p50 << "," << c.report.latency_p99 << "," << c.report.mae << ","
+            << c.report.failure_rate << "," << c.error << ",\"" << c.config << "\"" << std::endl;
+        if (!c.pareto) continue;
+
+        std::string path = out_dir + "/pareto_" + std::to_string(pareto_index++) + ".json";
+        if (!c.config.save(path)) {
+            std::cerr << "Error: Unable to write " << path << std::endl;
+            return 2;
+        }
+        std::cout << std::fixed << std::setprecision(2) << "  " << std::setw(8) << c.report.latency_p50 << " ms  "
+                  << std::setw(8) << c.error << " mm  " << path << "  (" << c.config << ")" << std::endl;
+    }
+
+    return 0;
+}
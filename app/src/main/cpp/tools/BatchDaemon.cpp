@@ -0,0 +1,407 @@
+//long-running batch measurement of uploaded photos with a durable job queue (host build)
+#include "JobQueue.h"
+#include "CardModel.h"
+#include "DetectorConfig.h"
+#include "ImageDecode.h"
+#include "ObjectDetector.h"
+
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <iomanip>
+#include <memory>
+#include <signal.h>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <opencv2/imgcodecs.hpp>
+
+using namespace std;
+
+// ./batch-daemon card.png [--inbox dir] [--socket path] [--journal path] [--config config.json]
+//                [--workers N] [--poll ms] [--stats s] [--once]
+//
+// Measures photos dropped into the inbox directory, or sent as paths over a Unix socket that stands
+// in for the upload server, with a pool of workers sharing one card model and detector.
+// Each result is written as one JSON line to <photo>.jsonl next to the photo. Queued and finished
+// photos are journaled (default <inbox>/.batch-journal), a restarted daemon resumes where it stopped.
+// Socket protocol, one line per request: a photo path is answered with "queued" or "known",
+// "stats" with the counters as one JSON line. The counters are also logged every --stats seconds.
+// --once measures what is in the inbox and exits.
+// OpenCV runs single-threaded, every worker is one core, so images per CPU second is the per-core throughput.
+
+static const char* const IMAGE_EXTENSIONS[] = {".jpg", ".jpeg", ".png"};
+static const int INBOX_SETTLE_S = 2;            // files modified more recently may still be uploading
+static const int SOCKET_BACKLOG = 8;
+static const int SOCKET_POLL_MS = 200;          // how often the socket thread checks for shutdown
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<bool> stopping(false);
+
+static void onSignal(int) {
+    stopping.store(true);
+}
+
+
+/**
+ * Throughput counters of the whole run, shared by the workers.
+ */
+struct BatchCounters {
+    Clock::time_point start = Clock::now();
+    std::atomic<int64_t> measured{0};           /**< Photos finished in this run */
+    std::atomic<int64_t> decode_us{0};
+    std::atomic<int64_t> measure_us{0};
+};
+
+
+static bool isImage(const std::string& name) {
+    std::string lower = name;
+    for (char& c : lower) c = char(tolower((unsigned char) c));
+    for (const char* extension : IMAGE_EXTENSIONS) {
+        size_t length = strlen(extension);
+        if (lower.size() > length && lower.compare(lower.size() - length, length, extension) == 0) return true;
+    }
+    return false;
+}
+
+
+static double cpuSeconds() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+
+static std::string jsonString(const std::string& text) {
+    std::ostringstream out;
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if ((unsigned char) c < 0x20) out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+        else out << c;
+    }
+    out << '"';
+    return out.str();
+}
+
+
+static std::string jsonPoints(const std::vector<cv::Point2f>& points, int factor) {
+    std::ostringstream out;
+    out << '[';
+    for (size_t i = 0; i < points.size(); i++) {
+        out << (i ? "," : "") << '[' << points[i].x * factor << ',' << points[i].y * factor << ']';
+    }
+    out << ']';
+    return out.str();
+}
+
+
+/**
+ * Counters as one JSON line.
+ */
+static std::string statsJson(JobQueue& queue, const BatchCounters& counters, int workers) {
+    JobQueueStats stats = queue.snapshot();
+    double uptime_s = std::chrono::duration<double>(Clock::now() - counters.start).count();
+    double cpu_s = cpuSeconds();
+    int64_t measured = counters.measured.load();
+    std::ostringstream out;
+    out << "{\"queued\":" << stats.queued << ",\"running\":" << stats.running << ",\"done\":" << stats.done
+        << ",\"failed\":" << stats.failed << ",\"recovered\":" << stats.recovered << ",\"measured\":" << measured
+        << ",\"workers\":" << workers << ",\"uptime_s\":" << uptime_s
+        << ",\"images_per_s\":" << (uptime_s > 0 ? measured / uptime_s : 0)
+        << ",\"images_per_cpu_s\":" << (cpu_s > 0 ? measured / cpu_s : 0)
+        << ",\"decode_ms\":" << (measured > 0 ? counters.decode_us.load() / 1000.0 / measured : 0)
+        << ",\"measure_ms\":" << (measured > 0 ? counters.measure_us.load() / 1000.0 / measured : 0) << "}";
+    return out.str();
+}
+
+
+/**
+ * Write the result line of a photo to <photo>.jsonl, through a temporary file so readers never see half a line.
+ * The file and the rename are synced before the journal records the photo as finished, so a crash
+ * never leaves a finished photo without its result.
+ * @return false if the file cannot be written
+ */
+static bool writeResult(const std::string& path, const std::string& line) {
+    std::string result_path = path + ".jsonl";
+    std::string temporary = result_path + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "w");
+    if (!out) return false;
+    bool ok = fprintf(out, "%s\n", line.c_str()) >= 0 && fflush(out) == 0 && fsync(fileno(out)) == 0;
+    ok = fclose(out) == 0 && ok;
+    return ok && rename(temporary.c_str(), result_path.c_str()) == 0 && syncDirectoryOf(result_path);
+}
+
+
+/**
+ * Measure one photo and write its result.
+ * @return measureTree error code, -1 if the photo cannot be read
+ */
+static int measurePhoto(const ObjectDetector& detector, const std::string& path, BatchCounters& counters) {
+    auto start = Clock::now();
+    int factor = 1;
+    cv::Mat input;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        input = decodeFileDescriptor(fd, ResolutionScheduler::maxWorkingWidth(detector.getConfig()), factor);
+        close(fd);
+    }
+    auto decoded = Clock::now();
+
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    std::ostringstream line;
+    int code = -1;
+    if (input.empty()) {
+        std::cerr << "Error: Unable to read " << path << std::endl;
+        line << "{\"image\":" << jsonString(name) << ",\"code\":-1,\"error\":\"unreadable\"}";
+    } else {
+        MeasureResult result;
+        code = detector.measureTree(SourceImage::wrap(input, PIXEL_BGR), MeasureOptions(), result);
+        // geometry in the pixels of the original photo
+        line << "{\"image\":" << jsonString(name) << ",\"code\":" << code << ",\"diameter_mm\":" << result.diameter
+             << ",\"card\":" << jsonPoints(result.card, factor) << ",\"tree\":" << jsonPoints(result.tree, factor)
+             << ",\"decode_factor\":" << factor << ",\"degradations\":" << result.degradations
+             << ",\"measure_ms\":" << result.elapsed_ms << "}";
+    }
+    if (!writeResult(path, line.str())) std::cerr << "Error: Unable to write result of " << path << std::endl;
+
+    counters.decode_us += std::chrono::duration_cast<std::chrono::microseconds>(decoded - start).count();
+    counters.measure_us += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - decoded).count();
+    counters.measured++;
+    return code;
+}
+
+
+/**
+ * Queue the settled photos of the inbox that are neither known to the queue nor have a result file.
+ * @param settle_s photos modified more recently are left for a later scan
+ * @return number of newly queued photos
+ */
+static int scanInbox(const std::string& inbox, JobQueue& queue, int settle_s) {
+    DIR* dir = opendir(inbox.c_str());
+    if (!dir) {
+        std::cerr << "Error: Unable to read inbox " << inbox << std::endl;
+        return 0;
+    }
+    int queued = 0;
+    time_t now = time(nullptr);
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name[0] == '.' || !isImage(name)) continue;
+        std::string path = inbox + "/" + name;
+        if (queue.isKnown(path)) continue;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || now - st.st_mtime < settle_s) continue;
+        // measured by a run whose journal was lost
+        if (stat((path + ".jsonl").c_str(), &st) == 0) continue;
+        if (queue.push(path)) queued++;
+    }
+    closedir(dir);
+    return queued;
+}
+
+
+/**
+ * Serve one socket client until it disconnects or the daemon stops.
+ */
+static void serveClient(int client, JobQueue& queue, const BatchCounters& counters, int workers) {
+    std::string buffer;
+    char chunk[4096];
+    while (!stopping.load()) {
+        struct pollfd pfd = {client, POLLIN, 0};
+        int ready = poll(&pfd, 1, SOCKET_POLL_MS);
+        if (ready < 0) break;
+        if (ready == 0) continue;
+        ssize_t n = read(client, chunk, sizeof(chunk));
+        if (n <= 0) break;
+        buffer.append(chunk, size_t(n));
+
+        size_t newline;
+        while ((newline = buffer.find('\n')) != std::string::npos) {
+            std::string request = buffer.substr(0, newline);
+            buffer.erase(0, newline + 1);
+            if (!request.empty() && request.back() == '\r') request.pop_back();
+            if (request.empty()) continue;
+            std::string reply;
+            if (request == "stats") reply = statsJson(queue, counters, workers);
+            else if (access(request.c_str(), R_OK) != 0) reply = "error unreadable";
+            else reply = queue.push(request) ? "queued" : "known";
+            reply += "\n";
+            if (write(client, reply.data(), reply.size()) < 0) return;
+        }
+    }
+}
+
+
+/**
+ * Accept socket clients one after another until the daemon stops.
+ */
+static void serveSocket(int listener, JobQueue& queue, const BatchCounters& counters, int workers) {
+    while (!stopping.load()) {
+        struct pollfd pfd = {listener, POLLIN, 0};
+        if (poll(&pfd, 1, SOCKET_POLL_MS) <= 0) continue;
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) continue;
+        serveClient(client, queue, counters, workers);
+        close(client);
+    }
+}
+
+
+static int openSocket(const std::string& path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: Socket path too long " << path << std::endl;
+        return -1;
+    }
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) return -1;
+    unlink(path.c_str());
+    if (bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(listener, SOCKET_BACKLOG) != 0) {
+        std::cerr << "Error: Unable to listen on " << path << ": " << strerror(errno) << std::endl;
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+
+int main(int argc, char const* argv[]) {
+
+    if (argc < 3) {
+        std::cerr << "Usage: ./batch-daemon card.png [--inbox dir] [--socket path] [--journal path] [--config config.json]" << std::endl
+                  << "       [--workers N] [--poll ms] [--stats s] [--once]" << std::endl;
+        return 2;
+    }
+    std::string card_path = argv[1];
+    std::string inbox, socket_path, journal_path, config_path;
+    int workers = std::max(1, int(std::thread::hardware_concurrency()));
+    int poll_ms = 1000;
+    int stats_s = 10;
+    bool once = false;
+
+    // parse args
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--once") {
+            once = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value of " << arg << std::endl;
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--inbox") inbox = value;
+        else if (arg == "--socket") socket_path = value;
+        else if (arg == "--journal") journal_path = value;
+        else if (arg == "--config") config_path = value;
+        else if (arg == "--workers") workers = std::max(1, atoi(value.c_str()));
+        else if (arg == "--poll") poll_ms = std::max(10, atoi(value.c_str()));
+        else if (arg == "--stats") stats_s = std::max(0, atoi(value.c_str()));
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 2;
+        }
+    }
+    if (inbox.empty() && (socket_path.empty() || once)) {
+        std::cerr << "Error: --inbox is required without --socket and with --once" << std::endl;
+        return 2;
+    }
+    if (journal_path.empty()) {
+        if (inbox.empty()) {
+            std::cerr << "Error: --journal is required without --inbox" << std::endl;
+            return 2;
+        }
+        journal_path = inbox + "/.batch-journal";
+    }
+
+    DetectorConfig config;
+    if (!config_path.empty() && !DetectorConfig::load(config_path, config)) return 2;
+
+    // one read-only card model and detector for all workers
+    std::shared_ptr<const CardModel> card_model = CardModel::build(cv::imread(card_path), config.card_template_blur);
+    if (!card_model) {
+        std::cerr << "Error: Unable to read card image file" << std::endl;
+        return 2;
+    }
+    const ObjectDetector detector(card_model, std::make_shared<const DetectorConfig>(config));
+    // parallelism comes from the workers, a photo is measured on one core
+    cv::setNumThreads(1);
+
+    JobQueue queue;
+    if (!queue.open(journal_path)) return 2;
+    JobQueueStats recovered = queue.snapshot();
+    std::clog << "Journal " << journal_path << ": " << recovered.done << " done, " << recovered.recovered << " resumed" << std::endl;
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    BatchCounters counters;
+    std::vector<std::thread> pool;
+    for (int w = 0; w < workers; w++) {
+        pool.emplace_back([&] {
+            std::string path;
+            while (queue.pop(path)) queue.finish(path, measurePhoto(detector, path, counters));
+        });
+    }
+
+    int listener = -1;
+    std::thread socket_thread;
+    if (!socket_path.empty()) {
+        listener = openSocket(socket_path);
+        if (listener < 0) {
+            stopping.store(true);
+        } else {
+            socket_thread = std::thread([&] { serveSocket(listener, queue, counters, workers); });
+        }
+    }
+
+    auto last_stats = Clock::now();
+    while (!stopping.load()) {
+        // a single pass does not wait for uploads to settle
+        if (!inbox.empty()) scanInbox(inbox, queue, once ? 0 : INBOX_SETTLE_S);
+        queue.checkpoint();
+
+        if (stats_s > 0 && Clock::now() - last_stats >= std::chrono::seconds(stats_s)) {
+            std::clog << statsJson(queue, counters, workers) << std::endl;
+            last_stats = Clock::now();
+        }
+        if (once) {
+            JobQueueStats stats = queue.snapshot();
+            if (stats.queued == 0 && stats.running == 0) break;
+        }
+        // sleep in short steps to react to signals
+        for (int slept = 0; slept < poll_ms && !stopping.load(); slept += SOCKET_POLL_MS) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::min(SOCKET_POLL_MS, poll_ms - slept)));
+        }
+    }
+
+    // running photos are finished, queued ones stay in the journal for the next run
+    stopping.store(true);
+    queue.close();
+    for (std::thread& worker : pool) worker.join();
+    if (socket_thread.joinable()) socket_thread.join();
+    if (listener >= 0) {
+        close(listener);
+        unlink(socket_path.c_str());
+    }
+    queue.checkpoint(true);
+    std::clog << statsJson(queue, counters, workers) << std::endl;
+    return 0;
+}
@@ -0,0 +1,77 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <stdio.h>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+
+
+/**
+ * FIFO queue between two pipeline stages. A full queue blocks the producer, so a fast stage
+ * cannot run ahead of a slow one by more than 'capacity' items. Unlike LatestSlot nothing is dropped.
+ */
+template <typename T>
+class BoundedQueue {
+private:
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1) {}
+
+    /**
+     * Append an item, wait while the queue is full.
+     * @param item moved into the queue
+     * @param wait_ms output, time spent waiting for space
+     * @return false if the queue was closed
+     */
+    bool push(T&& item, double* wait_ms = nullptr) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto start = std::chrono::steady_clock::now();
+        not_full.wait(lock, [this] { return items.size() < capacity || closed; });
+        if (wait_ms) *wait_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (closed) return false;
+        items.push_back(std::move(item));
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+    /**
+     * Take the oldest item, wait while the queue is empty.
+     * @param item output
+     * @return false if the queue was closed and is drained
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return !items.empty() || closed; });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        not_full.notify_one();
+        return true;
+    }
+
+    /**
+     * No more items will be pushed. The consumer still gets the queued ones.
+     */
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+};
+
+
+#endif //BOUNDEDQUEUE_H
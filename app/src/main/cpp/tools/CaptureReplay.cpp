@@ -0,0 +1,354 @@
+//replay of frame captures recorded in live mode (host build)
+#include "CardModel.h"
+#include "DetectorConfig.h"
+#include "FrameCapture.h"
+#include "Hash.h"
+#include "LiveMeasurement.h"
+#include "ObjectDetector.h"
+#include "TreeTracker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdlib.h>
+#include <thread>
+#include <opencv2/imgcodecs.hpp>
+
+using namespace std;
+
+// ./capture-replay capture.treecap card.png [--config config.json] [--deadline ms] [--mode single|tracked|live]
+//                  [--speed X] [--repeat N] [--csv frames.csv] [--info]
+//
+// Feeds the frames of a capture to the pipeline exactly as they were recorded on the device.
+// single: every frame measured on its own, tracked: frames in order with the trunk tracker, as the live
+// worker does, live: through LiveMeasurement with its latest-frame-wins slot, so frames are dropped as on the device.
+// --speed 1 paces the frames at their recorded timestamps, 2 twice as fast, 0 as fast as the pipeline goes.
+// Config and deadline default to the ones recorded in the capture. The results hash covers codes and diameters,
+// two builds replaying the same capture with --deadline 0 in single or tracked mode must print the same hash.
+
+typedef std::chrono::steady_clock Clock;
+
+static const double DIAMETER_RESOLUTION = 0.01;    // mm, diameters are rounded to this before hashing
+
+
+/**
+ * Result of one replayed frame.
+ */
+struct ReplayResult {
+    int64_t frame = 0;              /**< Index in the capture */
+    int64_t id = 0;                 /**< Frame id recorded on the device */
+    int code = -1;                  /**< measureTree error code, -1 if the frame was dropped */
+    double diameter = 0;
+    double latency_ms = 0;          /**< From the paced arrival to the result */
+    int degradations = 0;
+    bool tracked = false;
+};
+
+
+static double msBetween(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+/**
+ * Sorted-sample percentile.
+ * @param sorted ascending values
+ * @param p percentile, 0 - 100
+ */
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = std::min(sorted.size() - 1, size_t(p / 100.0 * (sorted.size() - 1) + 0.5));
+    return sorted[index];
+}
+
+
+/**
+ * Hash of the codes and rounded diameters, identical for identical measurements.
+ */
+static uint64_t resultsHash(const std::vector<ReplayResult>& results) {
+    std::vector<int64_t> values;
+    values.reserve(results.size() * 3);
+    for (const ReplayResult& result : results) {
+        values.push_back(result.frame);
+        values.push_back(result.code);
+        values.push_back(int64_t(result.diameter / DIAMETER_RESOLUTION + 0.5));
+    }
+    return xxh64(values.data(), values.size() * sizeof(int64_t));
+}
+
+
+/**
+ * Print the recording session and check every frame chunk.
+ * @return false if a frame is damaged
+ */
+static bool printInfo(CaptureReader& reader) {
+    const CaptureInfo& info = reader.info();
+    cout << "Device: " << info.device << endl;
+    cout << "OpenCV: " << info.opencv_version << endl;
+    cout << "Started: " << info.start_time_ms << " ms since the epoch" << endl;
+    cout << "Deadline: " << info.deadline_ms << " ms" << endl;
+    cout << "Frames: " << reader.frameCount() << (reader.isComplete() ? "" : " (no index, capture was cut short)") << endl;
+
+    CapturedFrame frame;
+    std::string error;
+    uint64_t raw_bytes = 0;
+    std::map<int, int64_t> rotations;
+    for (size_t i = 0; i < reader.frameCount(); i++) {
+        if (!reader.frame(i, frame, error)) {
+            std::cerr << "Error: Frame " << i << ": " << error << std::endl;
+            return false;
+        }
+        raw_bytes += frame.image.pixels().total() * frame.image.pixels().elemSize();
+        rotations[frame.rotation]++;
+        if (i == 0) cout << "Size: " << frame.image.cols() << "x" << frame.image.rows() << ", format " << frame.image.format() << endl;
+        if (i + 1 == reader.frameCount() && i > 0) {
+            cout << "Duration: " << frame.timestamp_ns / 1e9 << " s, " << i * 1e9 / std::max<int64_t>(1, frame.timestamp_ns) << " fps" << endl;
+        }
+    }
+    for (const auto& rotation : rotations) cout << "Rotation " << rotation.first << ": " << rotation.second << " frames" << endl;
+    if (raw_bytes > 0) {
+        cout << "File: " << reader.fileSize() / 1024 << " kB, raw frames " << raw_bytes / 1024 << " kB, ratio "
+             << double(reader.fileSize()) / raw_bytes << endl;
+    }
+    return true;
+}
+
+
+/**
+ * Replay on the calling thread, one measurement per frame in capture order.
+ * @param tracked keep a TreeTracker across frames
+ * @param speed pacing factor of the recorded timestamps, 0 for no pacing
+ */
+static bool replaySequential(CaptureReader& reader, const ObjectDetector& detector, double deadline_ms, bool tracked,
+                             double speed, std::vector<ReplayResult>& results) {
+    TreeTracker tracker;
+    MeasureOptions options;
+    options.deadline_ms = deadline_ms;
+    options.tracker = tracked ? &tracker : nullptr;
+
+    CapturedFrame frame;
+    cv::Mat rotated;
+    std::string error;
+    auto start = Clock::now();
+    for (size_t i = 0; i < reader.frameCount(); i++) {
+        // decoding is not part of the pipeline, it happens before the frame is due
+        if (!reader.frame(i, frame, error)) {
+            std::cerr << "Error: Frame " << i << ": " << error << std::endl;
+            return false;
+        }
+        Clock::time_point arrival = Clock::now();
+        if (speed > 0) {
+            Clock::time_point due = start + std::chrono::nanoseconds(int64_t(frame.timestamp_ns / speed));
+            std::this_thread::sleep_until(due);
+            arrival = due;
+        }
+        SourceImage source = frame.image.rotated(frame.rotation, rotated);
+        MeasureResult result;
+        detector.measureTree(source, options, result);
+
+        ReplayResult replay;
+        replay.frame = int64_t(i);
+        replay.id = frame.id;
+        replay.code = result.code;
+        replay.diameter = result.code == 0 ? result.diameter : 0;
+        replay.latency_ms = msBetween(arrival, Clock::now());
+        replay.degradations = result.degradations;
+        replay.tracked = result.tree_tracked;
+        results.push_back(replay);
+    }
+    return true;
+}
+
+
+/**
+ * Replay through LiveMeasurement. Frames are submitted at their paced time from this thread while its
+ * worker measures the newest one, the overlay is polled to collect the results of the processed frames.
+ */
+static bool replayLive(CaptureReader& reader, std::shared_ptr<const CardModel> card_model, const DetectorConfig& config,
+                       double deadline_ms, double speed, std::vector<ReplayResult>& results) {
+    LiveMeasurement live(card_model, config, deadline_ms);
+    live.start();
+
+    // LiveMeasurement numbers the submitted frames from 0, so its ids are capture indices
+    std::vector<Clock::time_point> arrivals(reader.frameCount());
+    std::vector<int64_t> ids(reader.frameCount());
+    int64_t last_seen = -1;
+    auto collect = [&]() {
+        LiveOverlay overlay = live.latestOverlay();
+        if (overlay.frame_id <= last_seen) return;
+        last_seen = overlay.frame_id;
+        ReplayResult replay;
+        replay.frame = overlay.frame_id;
+        replay.id = ids[overlay.frame_id];
+        replay.code = overlay.code;
+        replay.diameter = overlay.code == 0 ? overlay.diameter : 0;
+        replay.latency_ms = msBetween(arrivals[overlay.frame_id], Clock::now());
+        replay.degradations = overlay.degradations;
+        results.push_back(replay);
+    };
+
+    CapturedFrame frame;
+    std::string error;
+    auto start = Clock::now();
+    for (size_t i = 0; i < reader.frameCount(); i++) {
+        if (!reader.frame(i, frame, error)) {
+            std::cerr << "Error: Frame " << i << ": " << error << std::endl;
+            return false;
+        }
+        if (frame.image.format() != PIXEL_I420) {
+            std::cerr << "Error: Live mode replays I420 frames only, frame " << i << " has format " << frame.image.format() << std::endl;
+            return false;
+        }
+        Clock::time_point due = start + std::chrono::nanoseconds(speed > 0 ? int64_t(frame.timestamp_ns / speed) : 0);
+        while (Clock::now() < due) {
+            collect();
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        int width = frame.image.cols(), height = frame.image.rows();
+        const uint8_t* y = frame.image.pixels().data;
+        const uint8_t* u = y + width * height;
+        const uint8_t* v = u + width * height / 4;
+        arrivals[i] = Clock::now();
+        ids[i] = frame.id;
+        live.submitYuv420(y, width, u, v, width / 2, 1, width, height, frame.rotation);
+        collect();
+    }
+    // the last submitted frame is always processed
+    int64_t last = int64_t(reader.frameCount()) - 1;
+    while (last_seen < last) {
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        collect();
+    }
+    live.stop();
+    return true;
+}
+
+
+int main(int argc, char const* argv[]) {
+
+    if (argc < 3) {
+        std::cerr << "Usage: ./capture-replay capture.treecap card.png [--config config.json] [--deadline ms] "
+                     "[--mode single|tracked|live] [--speed X] [--repeat N] [--csv frames.csv] [--info]" << std::endl;
+        return 2;
+    }
+    std::string capture_path = argv[1];
+    std::string card_path = argv[2];
+    std::string config_path, csv_path;
+    std::string mode = "tracked";
+    double deadline_ms = -1;
+    double speed = 0;
+    int repeat = 1;
+    bool info_only = false;
+
+    // parse args
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--info") {
+            info_only = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value of " << arg << std::endl;
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--config") config_path = value;
+        else if (arg == "--deadline") deadline_ms = atof(value.c_str());
+        else if (arg == "--mode") mode = value;
+        else if (arg == "--speed") speed = std::max(0.0, atof(value.c_str()));
+        else if (arg == "--repeat") repeat = std::max(1, atoi(value.c_str()));
+        else if (arg == "--csv") csv_path = value;
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 2;
+        }
+    }
+    if (mode != "single" && mode != "tracked" && mode != "live") {
+        std::cerr << "Unknown mode " << mode << std::endl;
+        return 2;
+    }
+
+    try {
+        CaptureReader reader;
+        std::string error;
+        if (!reader.open(capture_path, error)) {
+            std::cerr << "Error: " << capture_path << ": " << error << std::endl;
+            return 2;
+        }
+        if (info_only) return printInfo(reader) ? 0 : 1;
+
+        DetectorConfig config = reader.info().config;
+        if (!config_path.empty() && !DetectorConfig::load(config_path, config)) return 2;
+        if (deadline_ms < 0) deadline_ms = reader.info().deadline_ms;
+
+        std::shared_ptr<const CardModel> card_model = CardModel::build(cv::imread(card_path), config.card_template_blur);
+        if (!card_model) {
+            std::cerr << "Error: Unable to read card image file" << std::endl;
+            return 2;
+        }
+
+        std::ofstream csv;
+        if (!csv_path.empty()) {
+            csv.open(csv_path);
+            csv << "pass,frame,id,code,diameter,latency_ms,degradations,tracked" << std::endl;
+        }
+
+        cout << "Replaying " << reader.frameCount() << " frames, mode " << mode << ", deadline " << deadline_ms
+             << " ms, speed " << (speed > 0 ? std::to_string(speed) : std::string("max")) << endl;
+        uint64_t first_hash = 0;
+        bool stable = true;
+        for (int pass = 0; pass < repeat; pass++) {
+            std::vector<ReplayResult> results;
+            results.reserve(reader.frameCount());
+            auto start = Clock::now();
+            bool replayed;
+            if (mode == "live") {
+                replayed = replayLive(reader, card_model, config, deadline_ms, speed, results);
+            } else {
+                // a new detector per pass, the resolution scheduler must not carry over what it learned
+                ObjectDetector detector(card_model, config);
+                replayed = replaySequential(reader, detector, deadline_ms, mode == "tracked", speed, results);
+            }
+            if (!replayed) return 1;
+            double wall_ms = msBetween(start, Clock::now());
+
+            std::vector<double> latencies;
+            std::map<int, int64_t> codes;
+            int64_t tracked = 0;
+            for (const ReplayResult& result : results) {
+                latencies.push_back(result.latency_ms);
+                codes[result.code]++;
+                if (result.tracked) tracked++;
+                if (csv.is_open()) {
+                    csv << pass << "," << result.frame << "," << result.id << "," << result.code << "," << result.diameter << ","
+                        << result.latency_ms << "," << result.degradations << "," << result.tracked << std::endl;
+                }
+            }
+            std::sort(latencies.begin(), latencies.end());
+            double mean = 0;
+            for (double latency : latencies) mean += latency;
+            if (!latencies.empty()) mean /= latencies.size();
+
+            uint64_t hash = resultsHash(results);
+            if (pass == 0) first_hash = hash;
+            else if (hash != first_hash) stable = false;
+
+            cout << "Pass " << pass << ": " << results.size() << " of " << reader.frameCount() << " frames processed in "
+                 << wall_ms / 1000 << " s, " << (wall_ms > 0 ? results.size() * 1000.0 / wall_ms : 0) << " fps" << endl;
+            cout << "  Latency ms: mean " << mean << ", p50 " << percentile(latencies, 50) << ", p95 "
+                 << percentile(latencies, 95) << ", max " << (latencies.empty() ? 0 : latencies.back()) << endl;
+            cout << "  Codes:";
+            for (const auto& code : codes) cout << " " << code.first << "=" << code.second;
+            if (mode == "tracked") cout << ", tracked " << tracked;
+            cout << endl;
+            cout << "  Results hash: " << std::hex << hash << std::dec << endl;
+        }
+        if (repeat > 1) cout << (stable ? "All passes gave the same results" : "Results differ between passes") << endl;
+    } catch (const cv::Exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+//treeo card-feature asset builder (host build)
+#include "CardModel.h"
+#include "DetectorConfig.h"
+
+#include <iostream>
+#include <opencv2/imgcodecs.hpp>
+
+using namespace std;
+
+// ./card-features path/to/card.png path/to/treeo_card.cardfeat [--config detector_config.json]
+//
+// Writes the card features loaded in place by the app. Rebuild the asset whenever the OpenCV version,
+// the feature code or card_template_blur of the shipped config changes, the app otherwise falls back
+// to computing the features from the card image at startup.
+
+int main(int argc, char const* argv[]){
+
+    if (argc != 3 && !(argc == 5 && string(argv[3]) == "--config")) {
+        std::cerr << "Usage: ./card-features path/to/card.png path/to/out.cardfeat [--config detector_config.json]" << std::endl;
+        return -1;
+    }
+
+    DetectorConfig config;
+    if (argc == 5 && !DetectorConfig::load(argv[4], config)) {
+        std::cerr << "Error: Unable to read config " << argv[4] << std::endl;
+        return -1;
+    }
+
+    cv::Mat card_image = cv::imread(argv[1]);
+    std::shared_ptr<CardModel> model = CardModel::build(card_image, config.card_template_blur);
+    if (!model) {
+        std::cerr << "Error: Unable to read card image file" << std::endl;
+        return -1;
+    }
+
+    if (!model->save(argv[2])) {
+        std::cerr << "Error: Unable to write " << argv[2] << std::endl;
+        return -1;
+    }
+
+    // round trip, the app rejects files that do not load
+    std::vector<uint8_t> file = model->serialize();
+    std::string error;
+    if (!CardModel::fromBuffer(file.data(), file.size(), config.card_template_blur, nullptr, error)) {
+        std::cerr << "Error: written file does not load: " << error << std::endl;
+        return -1;
+    }
+
+    cout << "SIFT keypoints: " << model->features(CardModel::SIFT_FEATURES).count << endl;
+    cout << "ORB keypoints: " << model->features(CardModel::ORB_FEATURES).count << endl;
+    cout << "Template blur: " << config.card_template_blur << ", bytes: " << file.size() << endl;
+    return 0;
+}
@@ -0,0 +1,109 @@
+//concurrent measurement against one shared detector (host build), run it under ThreadSanitizer
+#include "CardModel.h"
+#include "DetectorConfig.h"
+#include "ObjectDetector.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdlib.h>
+#include <thread>
+#include <opencv2/imgcodecs.hpp>
+
+using namespace std;
+
+// ./concurrent-measure card.png [--config config.json] [--threads N] [--repeat N] photo.jpg...
+//
+// Measures every photo once on one thread, then 'repeat' times on each of 'threads' threads that all
+// share one ObjectDetector, CardModel and DetectorConfig. Fails if any concurrent result differs from
+// the serial one. Configure with -DTREE_SANITIZER=thread to let ThreadSanitizer check the shared state.
+
+int main(int argc, char const* argv[]) {
+
+    if (argc < 3) {
+        std::cerr << "Usage: ./concurrent-measure card.png [--config config.json] [--threads N] [--repeat N] photo.jpg..." << std::endl;
+        return 2;
+    }
+    std::string card_path = argv[1];
+    std::string config_path;
+    int threads = 4;
+    int repeat = 2;
+    std::vector<std::string> paths;
+
+    // parse args
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--config" || arg == "--threads" || arg == "--repeat") && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (arg == "--config") config_path = value;
+            else if (arg == "--threads") threads = std::max(1, atoi(value.c_str()));
+            else repeat = std::max(1, atoi(value.c_str()));
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    DetectorConfig config;
+    if (!config_path.empty() && !DetectorConfig::load(config_path, config)) return 2;
+    // adaptive widths depend on the order the threads finish in, results would not be comparable
+    config.adaptive_resolution = false;
+
+    std::shared_ptr<const CardModel> card_model = CardModel::build(cv::imread(card_path), config.card_template_blur);
+    if (!card_model) {
+        std::cerr << "Error: Unable to read card image file" << std::endl;
+        return 2;
+    }
+    const ObjectDetector detector(card_model, std::make_shared<const DetectorConfig>(config));
+
+    std::vector<cv::Mat> images;
+    for (const std::string& path : paths) {
+        cv::Mat image = cv::imread(path);
+        if (!image.data) {
+            std::cerr << "Error: Unable to read " << path << std::endl;
+            return 2;
+        }
+        images.push_back(image);
+    }
+    if (images.empty()) {
+        std::cerr << "No photos given" << std::endl;
+        return 2;
+    }
+
+    // reference results
+    std::vector<MeasureResult> expected(images.size());
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < images.size(); i++) {
+        detector.measureTree(SourceImage::wrap(images[i], PIXEL_BGR), MeasureOptions(), expected[i]);
+    }
+    double serial_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // every thread measures all photos, starting at a different one so the same photo runs on several threads at once
+    std::atomic<int> mismatches(0);
+    std::vector<std::thread> workers;
+    start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            for (int r = 0; r < repeat; r++) {
+                for (size_t n = 0; n < images.size(); n++) {
+                    size_t i = (n + t) % images.size();
+                    MeasureResult result;
+                    detector.measureTree(SourceImage::wrap(images[i], PIXEL_BGR), MeasureOptions(), result);
+                    if (result.code != expected[i].code || result.diameter != expected[i].diameter) {
+                        std::cerr << "Mismatch on " << paths[i] << ": code " << result.code << " diameter " << result.diameter
+                                  << ", serial code " << expected[i].code << " diameter " << expected[i].diameter << std::endl;
+                        mismatches++;
+                    }
+                }
+            }
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+    double parallel_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t runs = images.size() * threads * repeat;
+    cout << "Serial: " << images.size() << " measurements in " << serial_ms << " ms" << endl;
+    cout << "Concurrent: " << runs << " measurements on " << threads << " threads in " << parallel_ms << " ms, "
+         << (parallel_ms > 0 ? runs * 1000.0 / parallel_ms : 0) << " per s" << endl;
+    cout << "Mismatches: " << mismatches.load() << endl;
+    return mismatches.load() > 0 ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+//card detection front end benchmark (host build)
+#include "GrayResizeBlur.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+using namespace std;
+
+// ./front-end-bench [--width px] [--blur size] [--repeat N] [--threads N] photo.jpg...
+//
+// Times grayResizeBlur against the cvtColor + resize + GaussianBlur chain it replaces and reports how
+// much the results differ, the +-1 tolerance itself is checked by tests/GrayResizeBlurTest.cpp.
+// Both sides run on OpenCV's thread pool (grayResizeBlur stripes with parallel_for_), --threads 1
+// gives single-threaded times.
+
+static double medianMs(std::vector<double>& times) {
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+int main(int argc, char const* argv[]) {
+
+    int width = 1000;
+    int blur = 5;
+    int repeat = 10;
+    int threads = -1;
+    std::vector<std::string> paths;
+
+    // parse args
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--width" || arg == "--blur" || arg == "--repeat" || arg == "--threads") && i + 1 < argc) {
+            int value = atoi(argv[++i]);
+            if (arg == "--width") width = value;
+            else if (arg == "--blur") blur = value;
+            else if (arg == "--threads") threads = value;
+            else repeat = std::max(1, value);
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty()) {
+        std::cerr << "Usage: ./front-end-bench [--width px] [--blur size] [--repeat N] [--threads N] photo.jpg..." << std::endl;
+        return 2;
+    }
+    if (threads > 0) cv::setNumThreads(threads);
+
+    bool failed = false;
+    cout << "threads: " << cv::getNumThreads() << endl;
+    cout << "image,size,chain_ms,fused_ms,speedup,max_diff,differing" << endl;
+    for (const std::string& path : paths) {
+        cv::Mat image = cv::imread(path);
+        if (!image.data) {
+            std::cerr << "Error: Unable to read " << path << std::endl;
+            failed = true;
+            continue;
+        }
+        cv::Size dsize(width, int(round(float(width) / image.cols * image.rows)));
+
+        cv::Mat gray, chain, fused;
+        std::vector<double> chain_times, fused_times;
+        for (int r = 0; r < repeat; r++) {
+            auto start = std::chrono::steady_clock::now();
+            cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+            cv::resize(gray, chain, dsize, 0, 0, cv::INTER_LINEAR);
+            cv::GaussianBlur(chain, chain, cv::Size(blur, blur), 0);
+            auto middle = std::chrono::steady_clock::now();
+            grayResizeBlur(image, fused, dsize, blur);
+            auto end = std::chrono::steady_clock::now();
+            chain_times.push_back(std::chrono::duration<double, std::milli>(middle - start).count());
+            fused_times.push_back(std::chrono::duration<double, std::milli>(end - middle).count());
+        }
+
+        cv::Mat diff;
+        cv::absdiff(chain, fused, diff);
+        double max_diff = 0;
+        cv::minMaxLoc(diff, nullptr, &max_diff);
+        double differing = double(cv::countNonZero(diff)) / diff.total();
+
+        double chain_ms = medianMs(chain_times);
+        double fused_ms = medianMs(fused_times);
+        cout << path << "," << image.cols << "x" << image.rows << "," << chain_ms << "," << fused_ms << ","
+             << chain_ms / fused_ms << "," << max_diff << "," << differing << endl;
+    }
+    return failed ? 1 : 0;
+}
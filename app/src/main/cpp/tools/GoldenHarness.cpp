@@ -0,0 +1,168 @@
+//golden dataset accuracy and latency regression harness (host build)
+#include "GoldenSet.h"
+#include "ObjectDetector.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdlib.h>
+
+using namespace std;
+
+// ./golden-harness --card card.png --set manifest.json [--config config.json] [--deadline ms] [--repeat N] [--baseline report.json]
+//                  [--write-baseline report.json] [--csv runs.csv] [--frames-csv frames.csv]
+//                  [--mae-tol mm] [--fail-tol rate] [--card-tol px] [--latency-tol ratio]
+//
+// With --deadline the measureTree time of every run is compared with the deadline: p50, p99 and the runs
+// over it are printed, and the harness fails if p99 is over the deadline. --frames-csv writes the time of
+// every run.
+
+static void usage() {
+    std::cerr << "Usage: ./golden-harness --card card.png --set manifest.json [--config config.json] [--deadline ms] [--repeat N]" << std::endl
+              << "       [--baseline report.json] [--write-baseline report.json] [--csv runs.csv] [--frames-csv frames.csv]" << std::endl
+              << "       [--mae-tol mm] [--fail-tol rate] [--card-tol px] [--latency-tol ratio]" << std::endl;
+}
+
+int main(int argc, char const* argv[]) {
+
+    std::string card_path, set_path, config_path, baseline_path, write_baseline_path, csv_path, frames_csv_path;
+    int repeat = 3;
+    MeasureOptions options;
+    GoldenTolerance tolerance;
+
+    // parse args
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--card") card_path = value;
+        else if (arg == "--set") set_path = value;
+        else if (arg == "--config") config_path = value;
+        else if (arg == "--deadline") options.deadline_ms = atof(value.c_str());
+        else if (arg == "--repeat") repeat = atoi(value.c_str());
+        else if (arg == "--baseline") baseline_path = value;
+        else if (arg == "--write-baseline") write_baseline_path = value;
+        else if (arg == "--csv") csv_path = value;
+        else if (arg == "--frames-csv") frames_csv_path = value;
+        else if (arg == "--mae-tol") tolerance.mae = atof(value.c_str());
+        else if (arg == "--fail-tol") tolerance.failure_rate = atof(value.c_str());
+        else if (arg == "--card-tol") tolerance.card_error = atof(value.c_str());
+        else if (arg == "--latency-tol") tolerance.latency = atof(value.c_str());
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (card_path.empty() || set_path.empty()) {
+        usage();
+        return 2;
+    }
+
+    std::vector<GoldenSample> samples = loadGoldenSet(set_path);
+    if (samples.empty()) {
+        std::cerr << "Error: Golden set is empty" << std::endl;
+        return 2;
+    }
+
+    DetectorConfig config;
+    if (!config_path.empty() && !DetectorConfig::load(config_path, config)) return 2;
+
+    ObjectDetector detector(card_path, config);
+    int degraded_runs = 0;
+    // measureTree's own time of every run, which the deadline applies to, and the sample of the run
+    std::vector<double> run_ms;
+    std::vector<int> run_sample;
+    int sample_index = -1;
+    GoldenRunner runner = [&](const cv::Mat& image) {
+        SampleRun run;
+        MeasureResult result;
+        run.code = detector.measureTree(SourceImage::wrap(image, PIXEL_BGR), options, result);
+        run_ms.push_back(result.elapsed_ms);
+        run_sample.push_back(sample_index);
+        run.card = result.card;
+        run.diameter = result.diameter;
+        if (result.degradations != DEGRADE_NONE) degraded_runs++;
+        return run;
+    };
+
+    // samples are unrelated photos, the card size learned from one must not plan the resolution of the next;
+    // the repeats of a sample keep the history, like consecutive photos of the same tree
+    // the warm-up run before the first sample is not counted
+    GoldenSampleStart sample_start = [&]() {
+        if (sample_index++ < 0) {
+            run_ms.clear();
+            run_sample.clear();
+        }
+        detector.resetScheduler();
+    };
+
+    std::vector<SampleRun> runs;
+    GoldenReport report = evaluateGoldenSet(samples, runner, repeat, &runs, sample_start);
+    printGoldenReport(std::cout, report);
+    bool deadline_missed = false;
+    if (options.deadline_ms > 0 && !run_ms.empty()) {
+        double p50 = percentile(run_ms, 50);
+        double p99 = percentile(run_ms, 99);
+        size_t over = size_t(std::count_if(run_ms.begin(), run_ms.end(), [&](double ms) { return ms > options.deadline_ms; }));
+        std::cout << "Deadline:       " << options.deadline_ms << " ms, p50 " << p50 << " ms, p99 " << p99 << " ms, "
+                  << over << " of " << run_ms.size() << " runs over" << std::endl;
+        std::cout << "Degraded runs:  " << degraded_runs << std::endl;
+        if (p99 > options.deadline_ms) {
+            std::cout << "DEADLINE MISSED: p99 " << p99 << " ms, deadline " << options.deadline_ms << " ms" << std::endl;
+            deadline_missed = true;
+        }
+    }
+
+    if (!csv_path.empty()) {
+        std::ofstream csv(csv_path);
+        csv << "image,code,diameter,expected,latency_ms" << std::endl;
+        for (size_t i = 0; i < runs.size() && i < samples.size(); i++) {
+            csv << samples[i].image_path << "," << runs[i].code << "," << runs[i].diameter << ","
+                << samples[i].diameter << "," << runs[i].latency_ms << std::endl;
+        }
+    }
+
+    if (!frames_csv_path.empty()) {
+        std::ofstream csv(frames_csv_path);
+        // sample_index counts the readable samples only
+        std::vector<size_t> readable;
+        for (size_t i = 0; i < runs.size(); i++) {
+            if (runs[i].code != -1) readable.push_back(i);
+        }
+        csv << "run,image,elapsed_ms,deadline_ms" << std::endl;
+        for (size_t i = 0; i < run_ms.size(); i++) {
+            int sample = run_sample[i];
+            bool known = sample >= 0 && size_t(sample) < readable.size() && readable[sample] < samples.size();
+            csv << i << "," << (known ? samples[readable[sample]].image_path : "") << ","
+                << run_ms[i] << "," << options.deadline_ms << std::endl;
+        }
+    }
+
+    // a baseline with missing images would hide them in every later comparison
+    if (report.unreadable > 0) {
+        std::cerr << "Error: " << report.unreadable << " images of the golden set could not be read" << std::endl;
+        if (!write_baseline_path.empty()) std::cerr << "Baseline not written" << std::endl;
+        return 1;
+    }
+
+    if (!write_baseline_path.empty() && !saveGoldenReport(write_baseline_path, report)) {
+        std::cerr << "Error: Unable to write " << write_baseline_path << std::endl;
+        return 2;
+    }
+
+    if (!baseline_path.empty()) {
+        GoldenReport baseline;
+        if (!loadGoldenReport(baseline_path, baseline)) {
+            std::cerr << "Error: Unable to read baseline " << baseline_path << std::endl;
+            return 2;
+        }
+        if (!compareGoldenReports(baseline, report, tolerance, std::cout)) {
+            return 1;
+        }
+        std::cout << "No regression against " << baseline_path << std::endl;
+    }
+
+    return deadline_missed ? 1 : 0;
+}
@@ -0,0 +1,278 @@
+#include "GoldenSet.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <math.h>
+#include <opencv2/imgcodecs.hpp>
+
+
+/**
+ * Load dataset manifest. JSON (or YAML) readable by cv::FileStorage:
+ * { "samples": [ { "image": "plot1/001.jpg", "diameter": 312.5, "card": [x0, y0, x1, y1, x2, y2, x3, y3] }, ... ] }
+ * Image paths are relative to the manifest directory, "card" is optional.
+ * @param manifest_path path to manifest
+ * @return samples, empty if manifest could not be read
+ */
+std::vector<GoldenSample> loadGoldenSet(const std::string& manifest_path) {
+    std::vector<GoldenSample> samples;
+
+    cv::FileStorage fs(manifest_path, cv::FileStorage::READ);
+    if (!fs.isOpened()) {
+        std::cerr << "Error: Unable to read golden set manifest " << manifest_path << std::endl;
+        return samples;
+    }
+
+    std::string dir;
+    size_t slash = manifest_path.find_last_of('/');
+    if (slash != std::string::npos) dir = manifest_path.substr(0, slash + 1);
+
+    cv::FileNode nodes = fs["samples"];
+    for (cv::FileNodeIterator it = nodes.begin(); it != nodes.end(); ++it) {
+        cv::FileNode node = *it;
+        GoldenSample sample;
+
+        std::string image = (std::string) node["image"];
+        sample.image_path = (!image.empty() && image[0] == '/') ? image : dir + image;
+        sample.diameter = (double) node["diameter"];
+
+        std::vector<float> card;
+        if (!node["card"].empty()) node["card"] >> card;
+        for (size_t i = 0; i + 1 < card.size(); i += 2) {
+            sample.card.push_back(cv::Point2f(card[i], card[i + 1]));
+        }
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+
+/**
+ * Percentile with linear interpolation between closest ranks.
+ * @param values values, copied because they are sorted
+ * @param p percentile in interval <0,100>
+ * @return percentile or 0 for empty input
+ */
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+
+    double rank = p / 100.0 * (values.size() - 1);
+    size_t low = size_t(floor(rank));
+    size_t high = std::min(low + 1, values.size() - 1);
+    return values[low] + (values[high] - values[low]) * (rank - low);
+}
+
+
+/**
+ * Mean distance of each labelled card corner to the closest detected corner.
+ * @param labelled card corners from the manifest
+ * @param detected card corners from the pipeline
+ * @return mean distance in pixels
+ */
+static double cardError(const std::vector<cv::Point2f>& labelled, const std::vector<cv::Point2f>& detected) {
+    double sum = 0;
+    for (const cv::Point2f& l : labelled) {
+        double best = INFINITY;
+        for (const cv::Point2f& d : detected) {
+            best = std::min(best, double(cv::norm(l - d)));
+        }
+        sum += best;
+    }
+    return sum / labelled.size();
+}
+
+
+/**
+ * Run the pipeline over all samples and summarize accuracy and latency.
+ * The first sample is run once more before measuring, so lazy initialization does not count.
+ * @param samples dataset
+ * @param run pipeline under test
+ * @param repeat runs per sample, all of them count into latency, the last one into accuracy
+ * @param sample_runs optional output, last run of every sample (code -1 if the image could not be read)
+ * @param sample_start optional, called before the runs of every sample, e.g. to reset state learned from the previous one
+ * @return report
+ */
+GoldenReport evaluateGoldenSet(const std::vector<GoldenSample>& samples, const GoldenRunner& run, int repeat,
+                               std::vector<SampleRun>* sample_runs, const GoldenSampleStart& sample_start) {
+    GoldenReport report;
+    std::vector<double> abs_errors, card_errors, latencies;
+    bool warmed_up = false;
+
+    for (const GoldenSample& sample : samples) {
+        cv::Mat image = cv::imread(sample.image_path);
+        if (image.empty()) {
+            std::cerr << "Error: Unable to read " << sample.image_path << ", counted as a failure" << std::endl;
+            report.samples++;
+            report.unreadable++;
+            if (sample_runs) {
+                SampleRun skipped;
+                skipped.code = -1;
+                sample_runs->push_back(skipped);
+            }
+            continue;
+        }
+        if (!warmed_up) {
+            run(image);
+            warmed_up = true;
+        }
+        if (sample_start) sample_start();
+
+        SampleRun result;
+        for (int r = 0; r < std::max(repeat, 1); r++) {
+            auto start = std::chrono::steady_clock::now();
+            result = run(image);
+            auto end = std::chrono::steady_clock::now();
+            result.latency_ms = std::chrono::duration<double, std::milli>(end - start).count();
+            latencies.push_back(result.latency_ms);
+        }
+        if (sample_runs) sample_runs->push_back(result);
+
+        report.samples++;
+        if (result.code > 0 && result.code < 4) {
+            report.failures[result.code]++;
+            continue;
+        }
+        abs_errors.push_back(fabs(result.diameter - sample.diameter));
+        if (!sample.card.empty() && result.card.size() == 4) {
+            card_errors.push_back(cardError(sample.card, result.card));
+        }
+    }
+
+    if (report.samples == 0) return report;
+
+    report.failure_rate = double(report.failures[1] + report.failures[2] + report.failures[3] + report.unreadable) / report.samples;
+    for (double e : abs_errors) report.mae += e;
+    if (!abs_errors.empty()) report.mae /= abs_errors.size();
+    report.abs_error_p50 = percentile(abs_errors, 50);
+    report.abs_error_p90 = percentile(abs_errors, 90);
+    report.abs_error_max = percentile(abs_errors, 100);
+    for (double e : card_errors) report.card_error += e;
+    if (!card_errors.empty()) report.card_error /= card_errors.size();
+
+    if (latencies.empty()) return report;
+    for (double l : latencies) report.latency_mean += l;
+    report.latency_mean /= latencies.size();
+    report.latency_p50 = percentile(latencies, 50);
+    report.latency_p90 = percentile(latencies, 90);
+    report.latency_p99 = percentile(latencies, 99);
+
+    return report;
+}
+
+
+/**
+ * Print human readable report.
+ * @param out output stream
+ * @param report report to print
+ */
+void printGoldenReport(std::ostream& out, const GoldenReport& report) {
+    out << std::fixed << std::setprecision(2);
+    out << "Samples:        " << report.samples << std::endl;
+    out << "Failures:       card " << report.failures[1] << ", tree " << report.failures[2]
+        << ", diameter " << report.failures[3] << ", unreadable " << report.unreadable
+        << " (rate " << report.failure_rate * 100 << " %)" << std::endl;
+    out << "Diameter error: MAE " << report.mae << " mm, p50 " << report.abs_error_p50 << " mm, p90 "
+        << report.abs_error_p90 << " mm, max " << report.abs_error_max << " mm" << std::endl;
+    out << "Card error:     " << report.card_error << " px" << std::endl;
+    out << "Latency:        mean " << report.latency_mean << " ms, p50 " << report.latency_p50 << " ms, p90 "
+        << report.latency_p90 << " ms, p99 " << report.latency_p99 << " ms" << std::endl;
+}
+
+
+/**
+ * Save report as JSON, to be used as a baseline later.
+ * @param path output file (.json)
+ * @param report report to save
+ * @return true on success
+ */
+bool saveGoldenReport(const std::string& path, const GoldenReport& report) {
+    cv::FileStorage fs(path, cv::FileStorage::WRITE | cv::FileStorage::FORMAT_JSON);
+    if (!fs.isOpened()) return false;
+
+    fs << "samples" << report.samples;
+    fs << "card_failures" << report.failures[1];
+    fs << "tree_failures" << report.failures[2];
+    fs << "diameter_failures" << report.failures[3];
+    fs << "unreadable" << report.unreadable;
+    fs << "failure_rate" << report.failure_rate;
+    fs << "mae" << report.mae;
+    fs << "abs_error_p50" << report.abs_error_p50;
+    fs << "abs_error_p90" << report.abs_error_p90;
+    fs << "abs_error_max" << report.abs_error_max;
+    fs << "card_error" << report.card_error;
+    fs << "latency_mean" << report.latency_mean;
+    fs << "latency_p50" << report.latency_p50;
+    fs << "latency_p90" << report.latency_p90;
+    fs << "latency_p99" << report.latency_p99;
+    return true;
+}
+
+
+/**
+ * Load report saved with saveGoldenReport.
+ * @param path report file
+ * @param report output
+ * @return true on success
+ */
+bool loadGoldenReport(const std::string& path, GoldenReport& report) {
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    if (!fs.isOpened()) return false;
+
+    report.samples = (int) fs["samples"];
+    report.failures[1] = (int) fs["card_failures"];
+    report.failures[2] = (int) fs["tree_failures"];
+    report.failures[3] = (int) fs["diameter_failures"];
+    report.unreadable = (int) fs["unreadable"];
+    report.failure_rate = (double) fs["failure_rate"];
+    report.mae = (double) fs["mae"];
+    report.abs_error_p50 = (double) fs["abs_error_p50"];
+    report.abs_error_p90 = (double) fs["abs_error_p90"];
+    report.abs_error_max = (double) fs["abs_error_max"];
+    report.card_error = (double) fs["card_error"];
+    report.latency_mean = (double) fs["latency_mean"];
+    report.latency_p50 = (double) fs["latency_p50"];
+    report.latency_p90 = (double) fs["latency_p90"];
+    report.latency_p99 = (double) fs["latency_p99"];
+    return true;
+}
+
+
+/**
+ * Compare current report against a baseline.
+ * @param baseline accepted report
+ * @param current report of the pipeline under test
+ * @param tolerance allowed regression
+ * @param out every regression is printed here
+ * @return true if nothing regressed beyond tolerance
+ */
+bool compareGoldenReports(const GoldenReport& baseline, const GoldenReport& current, const GoldenTolerance& tolerance,
+                          std::ostream& out) {
+    bool ok = true;
+
+    if (current.unreadable > 0) {
+        out << "REGRESSION: " << current.unreadable << " images could not be read" << std::endl;
+        ok = false;
+    }
+    if (current.mae > baseline.mae + tolerance.mae) {
+        out << "REGRESSION: MAE " << current.mae << " mm, baseline " << baseline.mae << " mm" << std::endl;
+        ok = false;
+    }
+    if (current.failure_rate > baseline.failure_rate + tolerance.failure_rate + 1e-9) {
+        out << "REGRESSION: failure rate " << current.failure_rate << ", baseline " << baseline.failure_rate << std::endl;
+        ok = false;
+    }
+    if (current.card_error > baseline.card_error + tolerance.card_error) {
+        out << "REGRESSION: card error " << current.card_error << " px, baseline " << baseline.card_error << " px" << std::endl;
+        ok = false;
+    }
+    if (current.latency_p50 > baseline.latency_p50 * (1 + tolerance.latency)) {
+        out << "REGRESSION: p50 latency " << current.latency_p50 << " ms, baseline " << baseline.latency_p50 << " ms" << std::endl;
+        ok = false;
+    }
+    if (current.latency_p99 > baseline.latency_p99 * (1 + tolerance.latency)) {
+        out << "REGRESSION: p99 latency " << current.latency_p99 << " ms, baseline " << baseline.latency_p99 << " ms" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
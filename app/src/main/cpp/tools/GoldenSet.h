@@ -0,0 +1,75 @@
+#ifndef GOLDENSET_H
+#define GOLDENSET_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <functional>
+#include <opencv2/core.hpp>
+
+/**
+ * One labelled photo of the golden dataset.
+ */
+struct GoldenSample {
+    std::string image_path;             /**< Absolute path or path relative to the working directory */
+    double diameter = 0;                /**< Measured tree diameter in mm */
+    std::vector<cv::Point2f> card;      /**< Card corners in the original image (tl, tr, br, bl), empty if not labelled */
+};
+
+/**
+ * Output of one pipeline run on a sample.
+ */
+struct SampleRun {
+    int code = 0;                       /**< measureTree return code, 0 OK, 1 card, 2 tree, 3 diameter failed */
+    double diameter = 0;
+    std::vector<cv::Point2f> card;
+    double latency_ms = 0;
+};
+
+/**
+ * Accuracy and latency of the pipeline over the whole dataset.
+ * Errors are computed only from successful runs, latencies from all runs.
+ * Images that cannot be read count as samples and as failures, a damaged corpus must not look better.
+ */
+struct GoldenReport {
+    int samples = 0;                    /**< All samples of the manifest, also the unreadable ones */
+    int failures[4] = {0, 0, 0, 0};     /**< Failed samples per return code, index 0 is unused */
+    int unreadable = 0;                 /**< Samples whose image could not be read */
+    double failure_rate = 0;            /**< Failed and unreadable samples / all samples */
+    double mae = 0;                     /**< Mean absolute diameter error in mm */
+    double abs_error_p50 = 0;
+    double abs_error_p90 = 0;
+    double abs_error_max = 0;
+    double card_error = 0;              /**< Mean distance of card corners to the labelled ones in pixels */
+    double latency_mean = 0;            /**< Milliseconds */
+    double latency_p50 = 0;
+    double latency_p90 = 0;
+    double latency_p99 = 0;
+};
+
+/**
+ * Allowed regression against a baseline report.
+ */
+struct GoldenTolerance {
+    double mae = 0.5;                   /**< mm added to the baseline MAE */
+    double failure_rate = 0.0;          /**< Added to the baseline failure rate */
+    double card_error = 1.0;            /**< Pixels added to the baseline card error */
+    double latency = 0.10;              /**< Relative growth of p50 and p99 latency */
+};
+
+typedef std::function<SampleRun(const cv::Mat&)> GoldenRunner;
+typedef std::function<void()> GoldenSampleStart;
+
+std::vector<GoldenSample> loadGoldenSet(const std::string& manifest_path);
+GoldenReport evaluateGoldenSet(const std::vector<GoldenSample>& samples, const GoldenRunner& run, int repeat,
+                               std::vector<SampleRun>* sample_runs = nullptr,
+                               const GoldenSampleStart& sample_start = GoldenSampleStart());
+void printGoldenReport(std::ostream& out, const GoldenReport& report);
+bool saveGoldenReport(const std::string& path, const GoldenReport& report);
+bool loadGoldenReport(const std::string& path, GoldenReport& report);
+bool compareGoldenReports(const GoldenReport& baseline, const GoldenReport& current, const GoldenTolerance& tolerance,
+                          std::ostream& out);
+double percentile(std::vector<double> values, double p);
+
+
+#endif //GOLDENSET_H
@@ -0,0 +1,232 @@
+#include "JobQueue.h"
+
+#include <fcntl.h>
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+static const size_t CHECKPOINT_RECORDS = 1024;     // superfluous journal records tolerated before a checkpoint
+
+
+/**
+ * Sync the directory of a file, so a rename into it survives a crash.
+ * @param path file in the directory
+ * @return false if the directory cannot be synced
+ */
+bool syncDirectoryOf(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+
+JobQueue::~JobQueue() {
+    if (journal) fclose(journal);
+}
+
+
+/**
+ * Open the journal, replay it and queue the unfinished paths again. A missing journal starts an empty queue.
+ * @param path journal file
+ * @return false if the journal cannot be written
+ */
+bool JobQueue::open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    journal_path = path;
+
+    std::vector<std::string> order;
+    FILE* replay = fopen(path.c_str(), "r");
+    if (replay) {
+        char* line = nullptr;
+        size_t capacity = 0;
+        ssize_t length;
+        while ((length = getline(&line, &capacity, replay)) > 0) {
+            // a torn last record of a killed run has no line break and is skipped
+            if (line[length - 1] != '\n') break;
+            std::string record(line, size_t(length - 1));
+            if (record.size() > 2 && record[0] == 'Q' && record[1] == ' ') {
+                std::string job = record.substr(2);
+                if (!finished.count(job) && queued_or_running.insert(job).second) order.push_back(job);
+            } else if (record.size() > 2 && record[0] == 'D' && record[1] == ' ') {
+                size_t space = record.find(' ', 2);
+                if (space == std::string::npos) continue;
+                int code = atoi(record.c_str() + 2);
+                std::string job = record.substr(space + 1);
+                queued_or_running.erase(job);
+                if (finished.emplace(job, code).second && code != 0) stats.failed++;
+            }
+        }
+        free(line);
+        fclose(replay);
+    }
+    for (const std::string& job : order) {
+        if (queued_or_running.count(job)) pending.push_back(job);
+    }
+    stats.recovered = pending.size();
+    stats.done = finished.size();
+    stats.queued = pending.size();
+    return rewriteJournal();
+}
+
+
+/**
+ * Append one record and sync it. The mutex is held by the caller.
+ * @return false if the record did not reach the disk
+ */
+bool JobQueue::append(char type, int code, const std::string& path) {
+    if (!journal) return false;
+    int written = type == 'D' ? fprintf(journal, "D %d %s\n", code, path.c_str()) : fprintf(journal, "Q %s\n", path.c_str());
+    if (written < 0 || fflush(journal) != 0 || fsync(fileno(journal)) != 0) {
+        std::cerr << "JobQueue: unable to write " << journal_path << std::endl;
+        return false;
+    }
+    journal_records++;
+    return true;
+}
+
+
+/**
+ * Replace the journal with one record per known path: a temporary file is written, synced and renamed
+ * over the journal, then the directory is synced, so a crash leaves either the old or the new one.
+ * The mutex is held by the caller.
+ * @return false if the journal cannot be written
+ */
+bool JobQueue::rewriteJournal() {
+    std::string temporary = journal_path + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "w");
+    if (!out) {
+        std::cerr << "JobQueue: unable to write " << temporary << std::endl;
+        return false;
+    }
+    // finished paths keep their records so the inbox scan does not queue them again
+    size_t records = 0;
+    for (const auto& job : finished) {
+        fprintf(out, "D %d %s\n", job.second, job.first.c_str());
+        records++;
+    }
+    // jobs being measured first, then the queued ones in their order
+    std::set<std::string> waiting(pending.begin(), pending.end());
+    for (const std::string& job : queued_or_running) {
+        if (waiting.count(job)) continue;
+        fprintf(out, "Q %s\n", job.c_str());
+        records++;
+    }
+    for (const std::string& job : pending) {
+        fprintf(out, "Q %s\n", job.c_str());
+        records++;
+    }
+    bool ok = fflush(out) == 0 && fsync(fileno(out)) == 0;
+    ok = fclose(out) == 0 && ok;
+    if (!ok || rename(temporary.c_str(), journal_path.c_str()) != 0 || !syncDirectoryOf(journal_path)) {
+        std::cerr << "JobQueue: unable to replace " << journal_path << std::endl;
+        return false;
+    }
+
+    if (journal) fclose(journal);
+    journal = fopen(journal_path.c_str(), "a");
+    if (!journal) {
+        std::cerr << "JobQueue: unable to open " << journal_path << std::endl;
+        return false;
+    }
+    journal_records = records;
+    return true;
+}
+
+
+/**
+ * Queue an image unless it is already queued, being measured or finished.
+ * @param path image path, without line breaks
+ * @return true if it was queued
+ */
+bool JobQueue::push(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed || path.empty() || path.find('\n') != std::string::npos) return false;
+        if (finished.count(path) || queued_or_running.count(path)) return false;
+        if (!append('Q', 0, path)) return false;
+        queued_or_running.insert(path);
+        pending.push_back(path);
+        stats.queued = pending.size();
+    }
+    not_empty.notify_one();
+    return true;
+}
+
+
+/**
+ * Take the oldest queued image, wait while the queue is empty.
+ * The job stays in the journal until finish() is called for it.
+ * @param path output
+ * @return false once the queue is closed; queued images are left for the next run
+ */
+bool JobQueue::pop(std::string& path) {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_empty.wait(lock, [this] { return !pending.empty() || closed; });
+    if (closed) return false;
+    path = std::move(pending.front());
+    pending.pop_front();
+    stats.queued = pending.size();
+    stats.running++;
+    return true;
+}
+
+
+/**
+ * Record a measured image as finished, the next run skips it.
+ * @param path image taken by pop()
+ * @param code measureTree error code, negative if the image could not be read
+ */
+void JobQueue::finish(const std::string& path, int code) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!queued_or_running.erase(path)) return;
+    finished[path] = code;
+    append('D', code, path);
+    stats.running--;
+    stats.done++;
+    if (code != 0) stats.failed++;
+}
+
+
+/**
+ * Compact the journal when it holds many superfluous records.
+ * @param force compact anyway, e.g. on shutdown
+ * @return false if the journal cannot be written
+ */
+bool JobQueue::checkpoint(bool force) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t known = finished.size() + queued_or_running.size();
+    if (!force && journal_records < known + CHECKPOINT_RECORDS) return true;
+    return rewriteJournal();
+}
+
+
+/**
+ * Stop handing out jobs and wake the waiting workers. Jobs in progress can still be finished.
+ */
+void JobQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    not_empty.notify_all();
+}
+
+
+/**
+ * @return true if the image is queued, being measured or finished
+ */
+bool JobQueue::isKnown(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return finished.count(path) || queued_or_running.count(path);
+}
+
+
+JobQueueStats JobQueue::snapshot() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
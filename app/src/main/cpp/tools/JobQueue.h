@@ -0,0 +1,71 @@
+#ifndef JOBQUEUE_H
+#define JOBQUEUE_H
+
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+
+/**
+ * Counters of a JobQueue, a consistent snapshot.
+ */
+struct JobQueueStats {
+    size_t queued = 0;          /**< Waiting for a worker */
+    size_t running = 0;         /**< Taken by a worker, not finished */
+    size_t done = 0;            /**< Finished, including failed measurements */
+    size_t failed = 0;          /**< Finished with a non-zero measureTree code */
+    size_t recovered = 0;       /**< Unfinished jobs of a previous run put back into the queue on open */
+};
+
+
+/**
+ * FIFO of image paths backed by an append-only journal, so a restarted daemon neither loses
+ * queued images nor measures finished ones again.
+ * Every push and finish appends one record ("Q path" or "D code path") and syncs it to disk before
+ * returning. On open the journal is replayed: finished paths are remembered, every other recorded
+ * path is queued again, including the ones a killed run was measuring. checkpoint() rewrites the
+ * journal to one record per known path, so it does not grow with restarts and duplicates.
+ * All methods are thread-safe.
+ */
+class JobQueue {
+private:
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::deque<std::string> pending;
+    std::set<std::string> queued_or_running;
+    std::map<std::string, int> finished;      /**< measureTree code per finished path */
+    std::string journal_path;
+    FILE* journal = nullptr;
+    size_t journal_records = 0;         /**< Records in the journal file, compared with the known paths to decide on a checkpoint */
+    JobQueueStats stats;
+    bool closed = false;
+
+    bool append(char type, int code, const std::string& path);
+    bool rewriteJournal();
+
+public:
+    JobQueue() {}
+    JobQueue(const JobQueue&) = delete;
+    JobQueue& operator=(const JobQueue&) = delete;
+    ~JobQueue();
+
+    bool open(const std::string& path);
+    bool push(const std::string& path);
+    bool pop(std::string& path);
+    void finish(const std::string& path, int code);
+    bool checkpoint(bool force = false);
+    void close();
+
+    bool isKnown(const std::string& path);
+    JobQueueStats snapshot();
+};
+
+
+bool syncDirectoryOf(const std::string& path);
+
+
+#endif //JOBQUEUE_H
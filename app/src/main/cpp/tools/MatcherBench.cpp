@@ -0,0 +1,149 @@
+//card descriptor matching benchmark and agreement check (host build)
+#include "CardMatcher.h"
+#include "CardModel.h"
+#include "GrayResizeBlur.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+#include <opencv2/features2d.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+using namespace std;
+
+// ./matcher-bench card.png [--width px] [--blur size] [--ratio r] [--repeat N] photo.jpg...
+//
+// Matches the SIFT card descriptors to the descriptors of each photo with FLANN rebuilt per photo,
+// the prebuilt card index and the SIMD brute force on float, uint8 and PCA int8 descriptors,
+// after Lowe's ratio test. Float and uint8 brute force have to give the same good matches as
+// cv::BFMatcher, otherwise the tool fails. FLANN searches are approximate and PCA is lossy,
+// their agreement with the exact matches is reported, with the bytes read per descriptor pair.
+
+static double medianMs(std::vector<double>& times) {
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+static bool sameMatches(const std::vector<cv::DMatch>& a, const std::vector<cv::DMatch>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].queryIdx != b[i].queryIdx || a[i].trainIdx != b[i].trainIdx) return false;
+    }
+    return true;
+}
+
+/**
+ * Fraction of the good matches found by a matcher that are also exact good matches, as card-image keypoint pairs.
+ */
+static double agreement(const std::vector<cv::DMatch>& matches, const std::vector<cv::DMatch>& exact) {
+    if (matches.empty()) return exact.empty() ? 1 : 0;
+    size_t same = 0;
+    for (const cv::DMatch& m : matches) {
+        for (const cv::DMatch& e : exact) {
+            if (m.queryIdx == e.queryIdx && m.trainIdx == e.trainIdx) {
+                same++;
+                break;
+            }
+        }
+    }
+    return double(same) / matches.size();
+}
+
+int main(int argc, char const* argv[]) {
+
+    if (argc < 3) {
+        std::cerr << "Usage: ./matcher-bench card.png [--width px] [--blur size] [--ratio r] [--repeat N] photo.jpg..." << std::endl;
+        return 2;
+    }
+    DetectorConfig config;
+    int repeat = 10;
+    std::vector<std::string> paths;
+
+    // parse args
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--width" || arg == "--blur" || arg == "--ratio" || arg == "--repeat") && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (arg == "--width") config.card_resize_width = atoi(value);
+            else if (arg == "--blur") config.card_image_blur = atoi(value);
+            else if (arg == "--ratio") config.ratio_thresh = float(atof(value));
+            else repeat = std::max(1, atoi(value));
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    std::shared_ptr<const CardModel> card_model = CardModel::build(cv::imread(argv[1]), config.card_template_blur);
+    if (!card_model) {
+        std::cerr << "Error: Unable to read card image file" << std::endl;
+        return 2;
+    }
+    const CardFeatures& card = card_model->features(CardModel::SIFT_FEATURES, true);
+
+    bool failed = false;
+    cv::Ptr<cv::Feature2D> sift = cv::SIFT::create();
+    // matcher, descriptor format, name
+    struct Variant {
+        int matcher;
+        int format;
+        const char* name;
+    };
+    const Variant variants[] = {
+        {CARD_MATCH_FLANN, DESCRIPTOR_FLOAT, "flann"},
+        {CARD_MATCH_INDEX, DESCRIPTOR_FLOAT, "index"},
+        {CARD_MATCH_BRUTE_FORCE, DESCRIPTOR_FLOAT, "brute_force"},
+        {CARD_MATCH_BRUTE_FORCE, DESCRIPTOR_UINT8, "uint8"},
+        {CARD_MATCH_BRUTE_FORCE, DESCRIPTOR_PCA_INT8, "pca_int8"},
+    };
+    cout << "image,card_descriptors,image_descriptors,exact_good";
+    for (const Variant& variant : variants) {
+        cout << "," << variant.name << "_ms," << variant.name << "_good," << variant.name << "_agreement," << variant.name << "_bytes";
+    }
+    cout << endl;
+    for (const std::string& path : paths) {
+        cv::Mat photo = cv::imread(path);
+        if (!photo.data) {
+            std::cerr << "Error: Unable to read " << path << std::endl;
+            failed = true;
+            continue;
+        }
+
+        // the same front end as CardDetection::findCard
+        cv::Size dsize(config.card_resize_width, int(round(float(config.card_resize_width) / photo.cols * photo.rows)));
+        cv::Mat image;
+        grayResizeBlur(photo, image, dsize, config.card_image_blur);
+        std::vector<cv::KeyPoint> keypoints;
+        cv::Mat descriptors;
+        sift->detectAndCompute(image, cv::noArray(), keypoints, descriptors);
+
+        // exact reference
+        std::vector<std::vector<cv::DMatch>> knn_matches;
+        cv::BFMatcher::create(cv::NORM_L2)->knnMatch(card.descriptors, descriptors, knn_matches, 2);
+        std::vector<cv::DMatch> exact;
+        for (const std::vector<cv::DMatch>& knn : knn_matches) {
+            if (knn.size() > 1 && knn[0].distance < config.ratio_thresh * knn[1].distance) exact.push_back(knn[0]);
+        }
+
+        cout << path << "," << card.count << "," << descriptors.rows << "," << exact.size();
+        for (const Variant& variant : variants) {
+            std::vector<cv::DMatch> good;
+            std::vector<double> times;
+            for (int r = 0; r < repeat; r++) {
+                auto start = std::chrono::steady_clock::now();
+                matchCard(card, descriptors, variant.matcher, variant.format, config.ratio_thresh, good);
+                times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+            const cv::Mat& compared = variant.format == DESCRIPTOR_FLOAT ? card.descriptors : card.compact[variant.format];
+            cout << "," << medianMs(times) << "," << good.size() << "," << agreement(good, exact)
+                 << "," << compared.cols * compared.elemSize();
+            bool lossless = variant.matcher == CARD_MATCH_BRUTE_FORCE && variant.format != DESCRIPTOR_PCA_INT8;
+            if (lossless && !sameMatches(good, exact)) {
+                std::cerr << path << ": " << variant.name << " good matches differ from cv::BFMatcher" << std::endl;
+                failed = true;
+            }
+        }
+        cout << endl;
+    }
+    return failed ? 1 : 0;
+}
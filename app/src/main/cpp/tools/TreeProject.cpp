@@ -0,0 +1,47 @@
+//treeo project command line tool (host build)
+#include "ObjectDetector.h"
+#include "DebugCapture.h"
+
+using namespace std;
+
+// ./treeProject path/to/image path/to/card [path/to/debug/dir]
+
+int main(int argc, char const* argv[]){
+
+    std::string path_to_tree;
+    std::string path_to_card;
+    std::string path_to_debug;
+
+    // parse args
+    if (argc == 3 || argc == 4){
+        path_to_tree = argv[1];
+        path_to_card = argv[2];
+        if (argc == 4) path_to_debug = argv[3];
+    }else{
+        std::cerr << "Set path to image and card (./treeProject path/to/image path/to/card [path/to/debug/dir])" << std::endl;
+        return -1;
+    }
+
+    // Load Image of tree
+    //std::clog << "Filename: " + path_to_tree << std::endl;
+    cv::Mat input_image = cv::imread(path_to_tree);
+    if (!input_image.data) {
+        std::cerr << "Error: Unable to read tree image file" << std::endl;
+        return -1;
+    }
+
+    // intermediate images are written to the debug directory
+    capture::setEnabled(!path_to_debug.empty());
+
+    ObjectDetector detector(path_to_card);
+    std::vector<cv::Point2f> card_polygon, tree_polygon;
+    double diameter_value = 0.0;
+    cout << "ObjectDetector::measureTree() returned code: " << detector.measureTree(SourceImage::wrap(input_image, PIXEL_BGR), card_polygon, tree_polygon, diameter_value) << endl;
+    cout << "Diameter: " << diameter_value << endl;
+
+    if (!path_to_debug.empty()) {
+        cout << "Debug images written: " << capture::dump(path_to_debug) << endl;
+    }
+
+    return 0;
+}
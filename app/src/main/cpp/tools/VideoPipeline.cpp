@@ -0,0 +1,238 @@
+//stage-parallel measurement of video files (host build)
+#include "BoundedQueue.h"
+#include "CardDetection.h"
+#include "CardModel.h"
+#include "DetectorConfig.h"
+#include "TreeDetection.h"
+#include "TreeDiameter.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <stdlib.h>
+#include <thread>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
+
+using namespace std;
+
+// ./video-pipeline video.mp4 card.png [--config config.json] [--every N] [--max N] [--queue N] [--serial] [--csv frames.csv]
+//
+// Decode, card detection, tree detection and diameter run as pipeline stages on their own threads,
+// connected by bounded queues, so card detection of frame N+1 overlaps grabcut of frame N.
+// --serial runs the same stages one after another on one thread for comparison.
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+/**
+ * Frame travelling through the stages.
+ */
+struct VideoFrame {
+    int64_t index = 0;              /**< Frame number in the video */
+    cv::Mat image;
+    int code = 0;                   /**< measureTree error codes, 0 OK, 1 card, 2 tree failed */
+    std::vector<cv::Point2f> card;
+    std::vector<cv::Point2f> tree;
+    double diameter = 0;
+    Clock::time_point decoded;
+};
+
+
+/**
+ * Time accounting of one stage.
+ */
+struct StageStats {
+    std::string name;
+    int64_t frames = 0;
+    double busy_ms = 0;             /**< Processing */
+    double blocked_ms = 0;          /**< Waiting for space in the next queue */
+};
+
+
+/**
+ * Stage loop: take frames from 'in', process them, hand them to 'out'. Closes 'out' when 'in' is drained.
+ */
+template <typename Process>
+static void runStage(BoundedQueue<VideoFrame>& in, BoundedQueue<VideoFrame>* out, StageStats& stats, Process process) {
+    VideoFrame frame;
+    while (in.pop(frame)) {
+        auto start = Clock::now();
+        process(frame);
+        stats.busy_ms += msSince(start);
+        stats.frames++;
+        if (out) {
+            double wait_ms = 0;
+            out->push(std::move(frame), &wait_ms);
+            stats.blocked_ms += wait_ms;
+        }
+    }
+    if (out) out->close();
+}
+
+
+int main(int argc, char const* argv[]) {
+
+    if (argc < 3) {
+        std::cerr << "Usage: ./video-pipeline video.mp4 card.png [--config config.json] [--every N] [--max N] [--queue N] [--serial] [--csv frames.csv]" << std::endl;
+        return 2;
+    }
+    std::string video_path = argv[1];
+    std::string card_path = argv[2];
+    std::string config_path, csv_path;
+    int every = 1;
+    int64_t max_frames = -1;
+    int queue_size = 2;
+    bool serial = false;
+
+    // parse args
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--serial") {
+            serial = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value of " << arg << std::endl;
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--config") config_path = value;
+        else if (arg == "--every") every = std::max(1, atoi(value.c_str()));
+        else if (arg == "--max") max_frames = atoll(value.c_str());
+        else if (arg == "--queue") queue_size = std::max(1, atoi(value.c_str()));
+        else if (arg == "--csv") csv_path = value;
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 2;
+        }
+    }
+
+    DetectorConfig config;
+    if (!config_path.empty() && !DetectorConfig::load(config_path, config)) return 2;
+
+    // the card model is read-only, all stage threads share it
+    std::shared_ptr<const CardModel> card_model = CardModel::build(cv::imread(card_path), config.card_template_blur);
+    if (!card_model) {
+        std::cerr << "Error: Unable to read card image file" << std::endl;
+        return 2;
+    }
+
+    cv::VideoCapture video(video_path);
+    if (!video.isOpened()) {
+        std::cerr << "Error: Unable to open video " << video_path << std::endl;
+        return 2;
+    }
+
+    std::ofstream csv;
+    if (!csv_path.empty()) {
+        csv.open(csv_path);
+        csv << "frame,code,diameter,latency_ms" << std::endl;
+    }
+
+    // stage bodies, the same in serial and pipelined mode
+    auto decode = [&video, every](VideoFrame& frame, int64_t& next_index) {
+        for (int skip = 1; skip < every; skip++) {
+            if (!video.grab()) return false;
+            next_index++;
+        }
+        if (!video.read(frame.image) || frame.image.empty()) return false;
+        frame.index = next_index++;
+        frame.decoded = Clock::now();
+        return true;
+    };
+    auto detectCard = [&card_model, &config](VideoFrame& frame) {
+        CardDetection card(SourceImage::wrap(frame.image, PIXEL_BGR), *card_model, config);
+        frame.card = card.getPoints();
+        frame.code = frame.card.empty() ? 1 : 0;
+    };
+    auto detectTree = [&config](VideoFrame& frame) {
+        if (frame.code != 0) return;
+        TreeDetection tree(SourceImage::wrap(frame.image, PIXEL_BGR), frame.card, config);
+        if (tree.findTree(1) < 0 && tree.findTree(2) < 0) {
+            frame.code = 2;
+            return;
+        }
+        frame.tree = tree.getTreeLines();
+    };
+    double latency_sum_ms = 0;
+    auto computeDiameter = [&csv, &latency_sum_ms](VideoFrame& frame) {
+        if (frame.code == 0) frame.diameter = treeDiameterMm(frame.tree, frame.card);
+        double latency_ms = msSince(frame.decoded);
+        latency_sum_ms += latency_ms;
+        if (csv.is_open()) csv << frame.index << "," << frame.code << "," << frame.diameter << "," << latency_ms << std::endl;
+        frame.image.release();
+    };
+
+    StageStats stats[4];
+    stats[0].name = "decode";
+    stats[1].name = "card";
+    stats[2].name = "tree";
+    stats[3].name = "diameter";
+    int64_t next_index = 0;
+    auto start = Clock::now();
+
+    if (serial) {
+        VideoFrame frame;
+        while (max_frames < 0 || stats[0].frames < max_frames) {
+            auto stage_start = Clock::now();
+            if (!decode(frame, next_index)) break;
+            stats[0].busy_ms += msSince(stage_start);
+            stats[0].frames++;
+            stage_start = Clock::now();
+            detectCard(frame);
+            stats[1].busy_ms += msSince(stage_start);
+            stage_start = Clock::now();
+            detectTree(frame);
+            stats[2].busy_ms += msSince(stage_start);
+            stage_start = Clock::now();
+            computeDiameter(frame);
+            stats[3].busy_ms += msSince(stage_start);
+            stats[1].frames = stats[2].frames = stats[3].frames = stats[0].frames;
+        }
+    } else {
+        BoundedQueue<VideoFrame> to_card(queue_size), to_tree(queue_size), to_diameter(queue_size);
+        std::thread card_thread([&] { runStage(to_card, &to_tree, stats[1], detectCard); });
+        std::thread tree_thread([&] { runStage(to_tree, &to_diameter, stats[2], detectTree); });
+        std::thread diameter_thread([&] { runStage(to_diameter, nullptr, stats[3], computeDiameter); });
+
+        // decoding runs on the main thread
+        while (max_frames < 0 || stats[0].frames < max_frames) {
+            VideoFrame frame;
+            auto stage_start = Clock::now();
+            if (!decode(frame, next_index)) break;
+            stats[0].busy_ms += msSince(stage_start);
+            stats[0].frames++;
+            double wait_ms = 0;
+            to_card.push(std::move(frame), &wait_ms);
+            stats[0].blocked_ms += wait_ms;
+        }
+        to_card.close();
+        card_thread.join();
+        tree_thread.join();
+        diameter_thread.join();
+    }
+
+    double wall_ms = msSince(start);
+    int64_t frames = stats[3].frames;
+    double slowest_ms = 0;
+    cout << (serial ? "Serial" : "Pipelined") << ", " << frames << " frames in " << wall_ms / 1000 << " s" << endl;
+    cout << std::left << std::setw(10) << "stage" << std::setw(14) << "ms/frame" << std::setw(14) << "utilization"
+         << "blocked_ms" << endl;
+    for (const StageStats& stage : stats) {
+        double per_frame = stage.frames > 0 ? stage.busy_ms / stage.frames : 0;
+        slowest_ms = std::max(slowest_ms, per_frame);
+        cout << std::setw(10) << stage.name << std::setw(14) << per_frame << std::setw(14) << stage.busy_ms / wall_ms
+             << stage.blocked_ms << endl;
+    }
+    cout << "Throughput: " << (wall_ms > 0 ? frames * 1000.0 / wall_ms : 0) << " fps";
+    if (slowest_ms > 0) cout << " (slowest stage bound " << 1000.0 / slowest_ms << " fps)";
+    cout << endl;
+    if (frames > 0) cout << "Mean latency: " << latency_sum_ms / frames << " ms" << endl;
+    return 0;
+}
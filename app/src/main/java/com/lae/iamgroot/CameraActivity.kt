@@ -1,28 +1,28 @@
 package com.lae.iamgroot
 
 import android.Manifest
+import android.app.ActivityManager
 import android.content.pm.PackageManager
 import android.content.res.AssetManager
-import android.graphics.Bitmap
-import android.graphics.BitmapFactory
 import android.net.Uri
+import android.os.Build
 import android.os.Bundle
 import android.util.Log
 import android.widget.Toast
 import androidx.appcompat.app.AppCompatActivity
 import androidx.camera.core.CameraSelector
+import androidx.camera.core.ImageAnalysis
 import androidx.camera.core.ImageCapture
 import androidx.camera.core.ImageCaptureException
+import androidx.camera.core.ImageProxy
 import androidx.camera.core.Preview
 import androidx.camera.lifecycle.ProcessCameraProvider
 import androidx.core.app.ActivityCompat
 import androidx.core.content.ContextCompat
 import androidx.lifecycle.MutableLiveData
 import kotlinx.android.synthetic.main.activity_camera.*
-import org.opencv.android.Utils
-import org.opencv.core.Mat
-import org.opencv.imgproc.Imgproc
 import java.io.File
+import java.nio.ByteBuffer
 import java.text.SimpleDateFormat
 import java.util.*
 import java.util.concurrent.ExecutorService
@@ -54,16 +54,52 @@ class CameraActivity : AppCompatActivity() {
 
         camera_capture_button.setOnClickListener { takePhoto() }
 
+        live_button.setOnCheckedChangeListener { _, checked ->
+            if (checked) {
+                startLive(LIVE_DEADLINE_MS)
+                if (BuildConfig.DEBUG) startCapture()
+            } else {
+                if (BuildConfig.DEBUG) stopCapture()
+                stopLive()
+                live_overlay.update(null)
+            }
+        }
+
         outputDirectory = getOutputDirectory()
 
         cameraExecutor = Executors.newSingleThreadExecutor()
 
+        setTraceEnabled(BuildConfig.DEBUG)
+        setDebugCaptureEnabled(BuildConfig.DEBUG)
+        loadResultCache(File(filesDir, RESULT_CACHE_FILE_NAME).absolutePath)
+
         diameterData.observe(this, androidx.lifecycle.Observer {
             Toast.makeText(this, "Diameter: $it", Toast.LENGTH_LONG).show()
         })
 
     }
 
+    private fun startCapture() {
+        val captureFile = File(
+            outputDirectory,
+            SimpleDateFormat(
+                FILENAME_FORMAT, Locale.US
+            ).format(System.currentTimeMillis()) + CAPTURE_FILE_EXTENSION
+        )
+        val device = "${Build.MANUFACTURER} ${Build.MODEL}, Android ${Build.VERSION.RELEASE} " +
+                "(API ${Build.VERSION.SDK_INT}), ${Build.SUPPORTED_ABIS.joinToString()}"
+        // debug builds record every live session, the cap keeps them from filling the storage
+        val maxBytes = minOf(CAPTURE_MAX_BYTES, outputDirectory.usableSpace / 4)
+        if (!startFrameCapture(captureFile.absolutePath, device, maxBytes)) {
+            Log.e(TAG, "Frame capture failed to start")
+        }
+    }
+
+    private fun stopCapture() {
+        val frames = stopFrameCapture()
+        if (frames >= 0) Log.d(TAG, "Frame capture: $frames frames")
+    }
+
     private fun takePhoto() {
         // Get a stable reference of the modifiable image capture use case
         val imageCapture = imageCapture ?: return
@@ -118,6 +154,14 @@ class CameraActivity : AppCompatActivity() {
             imageCapture = ImageCapture.Builder()
                 .build()
 
+            // frames for live mode, the native side keeps only the latest one too
+            val imageAnalysis = ImageAnalysis.Builder()
+                .setBackpressureStrategy(ImageAnalysis.STRATEGY_KEEP_ONLY_LATEST)
+                .build()
+                .also {
+                    it.setAnalyzer(cameraExecutor, ImageAnalysis.Analyzer { image -> analyzeLiveFrame(image) })
+                }
+
 
             // Select back camera as a default
             val cameraSelector = CameraSelector.DEFAULT_BACK_CAMERA
@@ -128,7 +172,7 @@ class CameraActivity : AppCompatActivity() {
 
                 // Bind use cases to camera
                 cameraProvider.bindToLifecycle(
-                    this, cameraSelector, preview, imageCapture
+                    this, cameraSelector, preview, imageCapture, imageAnalysis
                 )
 
             } catch (exc: Exception) {
@@ -152,14 +196,43 @@ class CameraActivity : AppCompatActivity() {
             mediaDir else filesDir
     }
 
+    /**
+     * Hand a camera frame to the native live measurement and show the overlay of the last processed frame.
+     * The frame is copied natively, so the image is closed right away and the camera never waits.
+     */
+    private fun analyzeLiveFrame(image: ImageProxy) {
+        try {
+            if (live_button.isChecked) {
+                val planes = image.planes
+                submitLiveFrame(
+                    planes[0].buffer, planes[0].rowStride,
+                    planes[1].buffer, planes[2].buffer, planes[1].rowStride, planes[1].pixelStride,
+                    image.width, image.height, image.imageInfo.rotationDegrees
+                )
+                val overlay = pollLiveOverlay()
+                live_overlay.post { if (live_button.isChecked) live_overlay.update(overlay) }
+            }
+        } finally {
+            image.close()
+        }
+    }
+
     override fun onDestroy() {
         super.onDestroy()
+        stopLive()
         cameraExecutor.shutdown()
     }
 
     companion object {
         private const val TAG = "CameraXBasic"
         private const val FILENAME_FORMAT = "yyyy-MM-dd-HH-mm-ss-SSS"
+        private const val TRACE_FILE_NAME = "trace.json"
+        private const val DEBUG_DIRECTORY_NAME = "debug"
+        private const val RESULT_CACHE_FILE_NAME = "results.cache"
+        private const val CAPTURE_FILE_EXTENSION = ".treecap"
+        private const val CAPTURE_MAX_BYTES = 512L * 1024 * 1024
+        private const val LIVE_DEADLINE_MS = 150.0
+        private const val LOW_RAM_MEMORY_BUDGET = 256L * 1024 * 1024
         private const val REQUEST_CODE_PERMISSIONS = 10
         private val REQUIRED_PERMISSIONS = arrayOf(Manifest.permission.CAMERA)
     }
@@ -184,22 +257,32 @@ class CameraActivity : AppCompatActivity() {
 
     private fun processImage(uri: Uri) {
         try {
-            val imageStream = contentResolver.openInputStream(uri)
-            val selectedImage = BitmapFactory.decodeStream(imageStream)
-            val bitmapImg = selectedImage.copy(Bitmap.Config.ARGB_8888, true)
-
-            val src = Mat()
-
-            Utils.bitmapToMat(bitmapImg, src)
-            Imgproc.cvtColor(src, src, Imgproc.COLOR_RGBA2BGR)
-
+            // decoded natively at the working resolution, no full-size Bitmap
+            // low-RAM devices measure within a fixed native memory budget
+            val activityManager = getSystemService(ACTIVITY_SERVICE) as ActivityManager
+            val memoryBudget = if (activityManager.isLowRamDevice) LOW_RAM_MEMORY_BUDGET else 0L
             val start = System.nanoTime()
-            val diameter: Double = getTreeDiameter(src.nativeObjAddr)
+            val descriptor = contentResolver.openFileDescriptor(uri, "r")
+            if (descriptor == null) {
+                Log.e(TAG, "Unable to open photo $uri")
+                return
+            }
+            val diameter: Double = descriptor.use {
+                getTreeDiameterFromFd(it.fd, memoryBudget)
+            }
             val end = System.nanoTime()
             val intValue = diameter.roundToInt()
 
             val time = (end - start) / 1000000
 
+            saveResultCache(File(filesDir, RESULT_CACHE_FILE_NAME).absolutePath)
+
+            if (BuildConfig.DEBUG) {
+                File(outputDirectory, TRACE_FILE_NAME).writeText(dumpTrace())
+                val debugDirectory = File(outputDirectory, DEBUG_DIRECTORY_NAME).apply { mkdirs() }
+                dumpDebugCapture(debugDirectory.absolutePath)
+            }
+
             diameterData.postValue(intValue)
 
         } catch (e: Exception) {
@@ -211,6 +294,33 @@ class CameraActivity : AppCompatActivity() {
         return assets
     }
 
-    private external fun getTreeDiameter(mat: Long): Double
+    private external fun getTreeDiameterFromFd(fd: Int, memoryBudget: Long): Double
+
+    private external fun setTraceEnabled(enabled: Boolean)
+
+    private external fun dumpTrace(): String
+
+    private external fun setDebugCaptureEnabled(enabled: Boolean)
+
+    private external fun dumpDebugCapture(directory: String): Int
+
+    private external fun loadResultCache(path: String): Boolean
+
+    private external fun saveResultCache(path: String): Boolean
+
+    private external fun startLive(deadlineMs: Double)
+
+    private external fun stopLive()
+
+    private external fun submitLiveFrame(
+        y: ByteBuffer, yRowStride: Int, u: ByteBuffer, v: ByteBuffer, uvRowStride: Int,
+        uvPixelStride: Int, width: Int, height: Int, rotation: Int
+    ): Boolean
+
+    private external fun pollLiveOverlay(): FloatArray?
+
+    private external fun startFrameCapture(path: String, device: String, maxBytes: Long): Boolean
+
+    private external fun stopFrameCapture(): Long
 
 }
@@ -0,0 +1,90 @@
+package com.lae.iamgroot
+
+import android.content.Context
+import android.graphics.Canvas
+import android.graphics.Color
+import android.graphics.Paint
+import android.graphics.Path
+import android.util.AttributeSet
+import android.view.View
+import kotlin.math.max
+
+/**
+ * Draws the live measurement overlay (card quad, trunk lines, provisional diameter and FPS)
+ * over the camera preview. Values come from CameraActivity.pollLiveOverlay.
+ */
+class LiveOverlayView @JvmOverloads constructor(
+    context: Context, attrs: AttributeSet? = null
+) : View(context, attrs) {
+
+    private var values: FloatArray? = null
+
+    private val cardPaint = Paint().apply {
+        color = Color.GREEN
+        style = Paint.Style.STROKE
+        strokeWidth = 4f
+        isAntiAlias = true
+    }
+    private val treePaint = Paint().apply {
+        color = Color.RED
+        strokeWidth = 4f
+        isAntiAlias = true
+    }
+    private val textPaint = Paint().apply {
+        color = Color.WHITE
+        textSize = 42f
+        isAntiAlias = true
+        setShadowLayer(4f, 0f, 0f, Color.BLACK)
+    }
+
+    fun update(overlay: FloatArray?) {
+        values = overlay
+        invalidate()
+    }
+
+    override fun onDraw(canvas: Canvas) {
+        super.onDraw(canvas)
+        val v = values ?: return
+        val code = v[CODE].toInt()
+        val frameWidth = v[WIDTH]
+        val frameHeight = v[HEIGHT]
+        if (frameWidth <= 0 || frameHeight <= 0) return
+
+        // the preview fills the view (center crop), map frame coordinates the same way
+        val scale = max(width / frameWidth, height / frameHeight)
+        val dx = (width - frameWidth * scale) / 2
+        val dy = (height - frameHeight * scale) / 2
+        fun x(i: Int) = v[i] * scale + dx
+        fun y(i: Int) = v[i + 1] * scale + dy
+
+        if (code != 1) {
+            val path = Path()
+            path.moveTo(x(CARD), y(CARD))
+            for (p in 1 until 4) path.lineTo(x(CARD + 2 * p), y(CARD + 2 * p))
+            path.close()
+            canvas.drawPath(path, cardPaint)
+        }
+        if (code == 0) {
+            canvas.drawLine(x(TREE), y(TREE), x(TREE + 2), y(TREE + 2), treePaint)
+            canvas.drawLine(x(TREE + 4), y(TREE + 4), x(TREE + 6), y(TREE + 6), treePaint)
+            canvas.drawText("%.0f mm".format(v[DIAMETER]), 32f, 96f, textPaint)
+        }
+        canvas.drawText(
+            "%.1f fps  %.0f ms  dropped %d".format(v[FPS], v[LATENCY], v[DROPPED].toLong()),
+            32f, 150f, textPaint
+        )
+    }
+
+    companion object {
+        // layout of the overlay array, see pollLiveOverlay in native-lib.cpp
+        private const val CODE = 1
+        private const val WIDTH = 2
+        private const val HEIGHT = 3
+        private const val CARD = 4
+        private const val TREE = 12
+        private const val DIAMETER = 20
+        private const val LATENCY = 22
+        private const val FPS = 23
+        private const val DROPPED = 25
+    }
+}